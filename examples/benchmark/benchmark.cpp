@@ -0,0 +1,451 @@
+/*
+	C++ library for Binance API.
+
+	Latency benchmarks of the library against the local MockServer:
+	REST round trips, signing, decoding, order book updates and
+	websocket delivery. Each benchmark times every single operation
+	and reports the throughput and the p50/p99/p99.9/max latencies.
+
+	Usage: benchmark [-n iterations] [filter]
+
+	Only the benchmarks whose name contains the filter are run. All
+	inputs are generated from a fixed seed, so that the runs with the
+	same iterations are comparable.
+*/
+
+#include "binance.h"
+#include "binance_aggtrades.h"
+#include "binance_logger.h"
+#include "binance_mock.h"
+#include "binance_ratelimit.h"
+#include "binance_simulator.h"
+#include "binance_utils.h"
+#include "binance_websocket.h"
+
+#include <curl/curl.h>
+#include <json/json.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace binance;
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+static long iterations = 10000;
+static const char* filter = "";
+
+static double elapsedNs(const Clock::time_point& begin, const Clock::time_point& end)
+{
+	return chrono::duration<double, nano>(end - begin).count();
+}
+
+// Nearest rank percentile of sorted samples.
+static double percentile(const vector<double>& sorted, double p)
+{
+	if (sorted.empty())
+		return 0;
+
+	size_t rank = (size_t)(p / 100.0 * sorted.size() + 0.5);
+	rank = min(max(rank, (size_t)1), sorted.size());
+	return sorted[rank - 1];
+}
+
+static void report(const char* name, vector<double>& samples, double totalNs)
+{
+	sort(samples.begin(), samples.end());
+	printf("%-26s %9zu %12.0f %10.2f %10.2f %10.2f %10.2f\n", name, samples.size(),
+		samples.size() / (totalNs * 1e-9),
+		percentile(samples, 50) * 1e-3, percentile(samples, 99) * 1e-3,
+		percentile(samples, 99.9) * 1e-3, samples.back() * 1e-3);
+	fflush(stdout);
+}
+
+static bool selected(const char* name)
+{
+	return strstr(name, filter) != NULL;
+}
+
+// Time each call of the operation, after a warm-up of a tenth of the iterations.
+template<typename Operation>
+static void run(const char* name, long count, Operation operation)
+{
+	if (!selected(name))
+		return;
+
+	for (long i = 0; i < count / 10; i++)
+		operation();
+
+	vector<double> samples;
+	samples.reserve(count);
+	const Clock::time_point start = Clock::now();
+	for (long i = 0; i < count; i++)
+	{
+		const Clock::time_point begin = Clock::now();
+		operation();
+		samples.push_back(elapsedNs(begin, Clock::now()));
+	}
+
+	report(name, samples, elapsedNs(start, Clock::now()));
+}
+
+// Same as run(), with the calls spread over concurrent threads.
+template<typename Operation>
+static void runThreads(const char* name, int threads, long count, Operation operation)
+{
+	if (!selected(name))
+		return;
+
+	for (long i = 0; i < count / 10; i++)
+		operation();
+
+	const long perThread = max(count / threads, 1L);
+	vector<vector<double> > threadSamples(threads);
+	vector<thread> workers;
+	const Clock::time_point start = Clock::now();
+	for (int t = 0; t < threads; t++)
+		workers.push_back(thread([&, t]()
+		{
+			vector<double>& samples = threadSamples[t];
+			samples.reserve(perThread);
+			for (long i = 0; i < perThread; i++)
+			{
+				const Clock::time_point begin = Clock::now();
+				operation();
+				samples.push_back(elapsedNs(begin, Clock::now()));
+			}
+		}));
+	for (int t = 0; t < threads; t++)
+		workers[t].join();
+
+	vector<double> samples;
+	for (int t = 0; t < threads; t++)
+		samples.insert(samples.end(), threadSamples[t].begin(), threadSamples[t].end());
+	report(name, samples, elapsedNs(start, Clock::now()));
+}
+
+static size_t discard(char*, size_t size, size_t nmemb, void*)
+{
+	return size * nmemb;
+}
+
+// REST request on a new connection, as if no handle was pooled.
+static void getCold(const string& url)
+{
+	CURL* curl = curl_easy_init();
+	curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, discard);
+	curl_easy_perform(curl);
+	curl_easy_cleanup(curl);
+}
+
+// Query string of a limit order, built the same way as Account::sendOrder.
+static string buildOrder(const char* symbol, double quantity, double price, long clientOrderId)
+{
+	string post_data("symbol=");
+	post_data.append(symbol);
+	post_data.append("&side=BUY&type=LIMIT&timeInForce=GTC");
+	post_data.append("&quantity=");
+	post_data.append(toString(quantity));
+	post_data.append("&price=");
+	post_data.append(toString(price));
+	post_data.append("&newClientOrderId=bench-");
+	post_data.append(to_string(clientOrderId));
+	post_data.append("&newOrderRespType=RESULT");
+	post_data.append("&timestamp=");
+	post_data.append(to_string(get_current_ms_epoch()));
+	return post_data;
+}
+
+static string makeAggTrades(mt19937& random, int count)
+{
+	uniform_real_distribution<double> price(99, 101), qty(0.001, 2);
+	Json::Value trades(Json::arrayValue);
+	for (int i = 0; i < count; i++)
+	{
+		Json::Value trade;
+		trade["a"] = (Json::Int64)(1000000 + i);
+		trade["p"] = toString(price(random));
+		trade["q"] = toString(qty(random));
+		trade["f"] = (Json::Int64)(2000000 + i);
+		trade["l"] = (Json::Int64)(2000000 + i);
+		trade["T"] = (Json::Int64)(1600000000000LL + i);
+		trade["m"] = (i % 2 == 0);
+		trade["M"] = true;
+		trades.append(trade);
+	}
+
+	Json::StreamWriterBuilder builder;
+	builder["indentation"] = "";
+	return Json::writeString(builder, trades);
+}
+
+// Incremental depth update of a few levels around the mid price.
+static Json::Value makeDepthUpdate(mt19937& random, long updateId)
+{
+	uniform_int_distribution<int> ticks(1, 50), levels(1, 5), removed(0, 3);
+	uniform_real_distribution<double> qty(0.001, 10);
+	Json::Value update;
+	update["e"] = "depthUpdate";
+	update["s"] = "BTCUSDT";
+	update["U"] = (Json::Int64)updateId;
+	update["u"] = (Json::Int64)updateId;
+	const char* sides[] = { "b", "a" };
+	for (int side = 0; side < 2; side++)
+	{
+		update[sides[side]] = Json::Value(Json::arrayValue);
+		for (int i = levels(random); i > 0; i--)
+		{
+			Json::Value level(Json::arrayValue);
+			const int tick = ticks(random);
+			level.append(toString(side == 0 ? 100 - 0.01 * tick : 100 + 0.01 * tick, 2));
+			level.append(removed(random) == 0 ? string("0") : toString(qty(random)));
+			update[sides[side]].append(level);
+		}
+	}
+	return update;
+}
+
+static void benchSigning(mt19937& random)
+{
+	const string secret(64, 'k');
+	vector<string> queries;
+	for (int i = 0; i < 1024; i++)
+		queries.push_back(buildOrder("BTCUSDT", 0.001 * (random() % 1000 + 1), 100 + 0.01 * (random() % 100), i));
+
+	size_t i = 0;
+	run("sign/hmac_sha256", iterations, [&]()
+	{
+		hmac_sha256(secret.c_str(), queries[i++ % queries.size()].c_str());
+	});
+
+	long clientOrderId = 0;
+	run("order/build_body", iterations, [&]()
+	{
+		buildOrder("BTCUSDT", 0.001 * (clientOrderId % 1000 + 1), 100 + 0.01 * (clientOrderId % 100), clientOrderId);
+		clientOrderId++;
+	});
+}
+
+static void benchDecoding(mt19937& random)
+{
+	const string body = makeAggTrades(random, 500);
+	unique_ptr<Json::CharReader> reader(Json::CharReaderBuilder().newCharReader());
+
+	run("decode/aggtrades_json", iterations / 10, [&]()
+	{
+		Json::Value json_result;
+		string errors;
+		reader->parse(body.data(), body.data() + body.size(), &json_result, &errors);
+
+		vector<AggTrade> trades;
+		trades.reserve(json_result.size());
+		for (Json::Value::ArrayIndex i = 0; i < json_result.size(); i++)
+		{
+			const Json::Value& value = json_result[i];
+			AggTrade trade;
+			trade.id = value["a"].asInt64();
+			trade.price = atof(value["p"].asString().c_str());
+			trade.qty = atof(value["q"].asString().c_str());
+			trade.time = value["T"].asInt64();
+			trade.isBuyerMaker = value["m"].asBool();
+			trades.push_back(trade);
+		}
+	});
+
+	run("decode/aggtrades_typed", iterations / 10, [&]()
+	{
+		vector<AggTrade> trades;
+		AggTradeCrawler::parse(body.data(), body.size(), trades);
+	});
+}
+
+static void benchBook(mt19937& random)
+{
+	// The books of the simulators are the order books kept by the library.
+	Server server("https://bench.invalid", "/api/v3", true);
+	Simulator::get(server);
+
+	vector<pair<double, double> > bids, asks;
+	for (int i = 1; i <= 50; i++)
+	{
+		bids.push_back(make_pair(100 - 0.01 * i, 1.0));
+		asks.push_back(make_pair(100 + 0.01 * i, 1.0));
+	}
+	Simulator::get(server).setBook("BTCUSDT", bids, asks);
+
+	vector<Json::Value> updates;
+	for (int i = 0; i < 4096; i++)
+		updates.push_back(makeDepthUpdate(random, i + 1));
+
+	size_t i = 0;
+	const string path = "/ws/btcusdt@depth@100ms";
+	run("book/depth_update", iterations * 10, [&]()
+	{
+		Simulator::onMarketData(path, updates[i++ % updates.size()]);
+	});
+}
+
+static void benchRest(MockServer& mock)
+{
+	const string url = mock.getUrl() + "/api/v3/time";
+
+	run("rest/time_cold", iterations / 10, [&]()
+	{
+		getCold(url);
+	});
+
+	run("rest/time_pooled", iterations, [&]()
+	{
+		string result;
+		Server::getCurl(result, url);
+	});
+
+	// Many threads sharing the lanes, the DNS cache and the TLS sessions.
+	runThreads("rest/time_100_threads", 100, iterations, [&]()
+	{
+		string result;
+		Server::getCurl(result, url);
+	});
+
+	Server server(mock.getUrl().c_str());
+	Market market(server);
+	run("rest/depth_decoded", iterations, [&]()
+	{
+		Json::Value json_result;
+		market.getDepth(json_result, "BTCUSDT", 100);
+	});
+
+	Account account(server, "bench", "bench");
+	run("rest/send_order", iterations, [&]()
+	{
+		Json::Value json_result;
+		account.sendOrder(json_result, "BTCUSDT", "BUY", "LIMIT", "GTC", 0.001, 90, "", 0, 0, 0);
+	});
+}
+
+static const char* wsPath = "/ws/btcusdt@bookTicker";
+static vector<double> wsSamples;
+static atomic<long> wsReceived(0);
+
+static int onBookTicker(Json::Value& json_value)
+{
+	const double sent = json_value["sentNs"].asDouble();
+	const double now = chrono::duration<double, nano>(Clock::now().time_since_epoch()).count();
+	const long i = wsReceived.load();
+	if (i < (long)wsSamples.size())
+		wsSamples[i] = now - sent;
+	wsReceived.store(i + 1);
+	return 0;
+}
+
+// Time from publishing a frame on the mock until the callback gets it decoded.
+// The frames are paced, so that the latency does not include queueing.
+static void benchWebsocket(MockServer& mock)
+{
+	const char* name = "ws/frame_to_callback";
+	if (!selected(name))
+		return;
+
+	Websocket::init();
+	Websocket::set_host("127.0.0.1", mock.getPort(), false);
+	Websocket::connect_endpoint(onBookTicker, wsPath);
+	thread loop([]() { Websocket::enter_event_loop(); });
+
+	for (int i = 0; (i < 500) && (mock.getSubscribers(wsPath) == 0); i++)
+		this_thread::sleep_for(chrono::milliseconds(10));
+
+	const long count = iterations;
+	const long warmUp = count / 10;
+	wsSamples.assign(count + warmUp, 0);
+	const Clock::time_point start = Clock::now();
+	for (long i = 0; i < count + warmUp; i++)
+	{
+		char frame[256];
+		snprintf(frame, sizeof(frame),
+			"{\"u\":%ld,\"s\":\"BTCUSDT\",\"b\":\"99.99000000\",\"B\":\"1.00000000\","
+			"\"a\":\"100.01000000\",\"A\":\"1.00000000\",\"sentNs\":%.0f}", i + 1,
+			chrono::duration<double, nano>(Clock::now().time_since_epoch()).count());
+		mock.publish(wsPath, frame);
+
+		const Clock::time_point deadline = Clock::now() + chrono::milliseconds(100);
+		while ((wsReceived.load() <= i) && (Clock::now() < deadline))
+			this_thread::yield();
+	}
+	const double totalNs = elapsedNs(start, Clock::now());
+
+	Websocket::kill_all();
+	loop.join();
+
+	const long received = min(wsReceived.load(), count + warmUp);
+	if (received <= warmUp)
+	{
+		fprintf(stderr, "%s: no frames received\n", name);
+		return;
+	}
+
+	vector<double> samples(wsSamples.begin() + warmUp, wsSamples.begin() + received);
+	report(name, samples, totalNs * (received - warmUp) / (count + warmUp));
+}
+
+// Let the benchmarks hit the mock without being throttled by the client side limits.
+static void unlimit(const string& url)
+{
+	Json::Value rateLimits(Json::arrayValue);
+	const char* types[] = { "REQUEST_WEIGHT", "ORDERS", "RAW_REQUESTS" };
+	for (int i = 0; i < 3; i++)
+	{
+		Json::Value limit;
+		limit["rateLimitType"] = types[i];
+		limit["interval"] = "SECOND";
+		limit["intervalNum"] = 1;
+		limit["limit"] = 1000000000;
+		rateLimits.append(limit);
+	}
+	RateLimiter::get(url).setLimits(rateLimits);
+}
+
+int main(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-n") && (i + 1 < argc))
+			iterations = max(atol(argv[++i]), 10L);
+		else
+			filter = argv[i];
+	}
+
+	Logger::set_debug_level(0);
+	Logger::set_debug_logfp(stderr);
+
+	MockServer mock;
+	if (!mock.start())
+	{
+		fprintf(stderr, "Cannot start the mock server\n");
+		return 1;
+	}
+	unlimit(mock.getUrl());
+
+	printf("%-26s %9s %12s %10s %10s %10s %10s\n", "benchmark", "samples", "ops/s",
+		"p50 us", "p99 us", "p99.9 us", "max us");
+
+	mt19937 random(42);
+	benchSigning(random);
+	benchDecoding(random);
+	benchBook(random);
+	benchRest(mock);
+	benchWebsocket(mock);
+
+	mock.stop();
+	return 0;
+}
@@ -33,49 +33,15 @@
 # endif
 #endif /* HOST_NAME_MAX */
 
+// Return from the calling method with binanceErrorServer, if the
+// server replied with an error object, see binanceGetLastError().
 #define CHECK_SERVER_ERR(result)                                     \
     do {                                                             \
-        using namespace binance;                                     \
-        bool err = false;                                            \
-        if (result.isObject())                                       \
-        {                                                            \
-            const vector<string> keys = result.getMemberNames();     \
-            for (int i = 0, e = keys.size(); i < e; i++)             \
-            {                                                        \
-                const string& ikey = keys[i];                        \
-                if (ikey == "code")                                  \
-                {                                                    \
-                    for (int j = 0, e = keys.size(); j < e; j++)     \
-                    {                                                \
-                        const string& jkey = keys[j];                \
-                        if (jkey == "msg") { err = true; break; }    \
-                    }                                                \
-                }                                                    \
-                                                                     \
-                if (err) break;                                      \
-            }                                                        \
-        }                                                            \
-        if (!err) break;                                             \
-                                                                     \
-        char hostname[HOST_NAME_MAX] = "";                           \
-        gethostname(hostname, HOST_NAME_MAX);                        \
-        fprintf(stderr, "BINANCE error %s \"%s\" on %s at %s:%d\n",  \
-            result["code"].asString().c_str(),                       \
-            result["msg"].asString().c_str(),                        \
-            hostname, __FILE__, __LINE__);                           \
-        if (!getenv("FREEZE_ON_ERROR")) {                            \
-            fprintf(stderr, "You may want to set "                   \
-                "FREEZE_ON_ERROR environment "                       \
-                "variable to debug the case\n");                     \
-            exit(-1);                                                \
-        }                                                            \
-        else {                                                       \
-            fprintf(stderr, "thread 0x%zx of pid %d @ %s "           \
-               "is entering infinite loop\n",                        \
-               (size_t)pthread_self(), (int)getpid(), hostname);     \
-            while (1) usleep(1000000); /* 1 sec */                   \
-        }                                                            \
-    } while (0);
+        binance::binanceError_t server_status =                      \
+            binance::binanceCheckServerError(result);                \
+        if (server_status != binance::binanceSuccess)                \
+            return server_status;                                    \
+    } while (0)
 
 #define BINANCE_ERR_CHECK(x)                                         \
     do {                                                             \
@@ -112,11 +78,54 @@ namespace binance
 		binanceErrorMissingAccountKeys,
 		binanceErrorCurlFailed,
 		binanceErrorCurlOutOfMemory,
+		binanceErrorRateLimited,
+		binanceErrorServer,
 		binanceErrorUnknown,
 	};
 
 	const char* binanceGetErrorString(const binanceError_t err);
 
+	// Outcome of the last REST request of the calling thread, with the
+	// details which do not fit into binanceError_t.
+	struct binanceErrorInfo_t
+	{
+		binanceError_t status;
+
+		// Error code and message of the server, e.g. -2010 for an order
+		// rejected for insufficient balance, if status is binanceErrorServer.
+		int code;
+		std::string msg;
+
+		long httpStatus;
+
+		// Seconds to wait before retrying, from the Retry-After header.
+		int retryAfter;
+
+		binanceErrorInfo_t() : status(binanceSuccess), code(0), httpStatus(0), retryAfter(0) { }
+	};
+
+	const binanceErrorInfo_t& binanceGetLastError();
+
+	// Set the outcome of a request served without the network, e.g. by the Simulator.
+	void binanceSetLastError(const binanceErrorInfo_t& error);
+
+	// binanceErrorServer if the response is an error object {"code":...,"msg":...}.
+	binanceError_t binanceCheckServerError(const Json::Value& result);
+
+	// Scheduling classes of REST requests, highest priority first.
+	// Each class has its own connection lane, so that e.g. a burst of
+	// history downloads never delays a cancel.
+	enum binanceRequestClass_t
+	{
+		binanceRequestOrder = 0,
+		binanceRequestAccount,
+		binanceRequestMarketData,
+		binanceRequestHistory,
+		binanceRequestClassCount,
+	};
+
+	const char* binanceGetRequestClassString(const binanceRequestClass_t requestClass);
+
 	template<typename T> std::string toString(const T& val)
 	{
 		std::ostringstream out;
@@ -126,6 +135,8 @@ namespace binance
 
 	std::string toString(double val, int prec = 8);
 
+	class RateLimiter;
+
 	class Server
 	{
 		const std::string hostname;
@@ -135,17 +146,77 @@ namespace binance
 	public :
 
 		Server(const char* hostname = "https://api.binance.com",const char* prefix = "/api/v3", bool simulation = false);
+
+		// Server of several base urls, e.g. https://api.binance.com, https://api1.binance.com
+		// ... api4 and https://api-gcp.binance.com: the requests are built for the first one,
+		// and sent to the fastest healthy one, see binance_hosts.h.
+		Server(const std::vector<std::string>& hostnames, const char* prefix = "/api/v3", bool simulation = false);
 		
 		const std::string& getHostname() const;
 		bool isSimulator() const;
 		
 		binanceError_t getTime(Json::Value &json_result);
+
+		// Set the exchange clock used for signing, time is in 1/scale seconds.
 		binanceError_t setTime(const time_t time, unsigned int scale = 1);
 
+		// Estimate the exchange clock offset and drift from the fastest of
+		// a few /time round trips. All signed requests use the estimated
+		// clock afterwards, see get_current_ms_epoch().
+		binanceError_t syncTime(int samples = 5);
+
+		// Keep the exchange clock estimate fresh from a background thread.
+		void startTimeSync(unsigned int period_sec = 60, int samples = 5);
+		static void stopTimeSync();
+
+		// Pay the connection setup before the first requests rather than in
+		// them: open all the pooled connections of every request class with
+		// a ping each, which also caches the address of the host and the TLS
+		// session shared by all the handles.
+		binanceError_t warmUp() const;
+
+		// Rate limits accounting of this server, see binance_ratelimit.h.
+		RateLimiter& getRateLimiter() const;
+
 		static binanceError_t getCurl(std::string &result_json, const std::string& url);
 
 		static binanceError_t getCurlWithHeader(std::string& result_json, const std::string& url,
 			const std::vector<std::string>& extra_http_header, const std::string& post_data, const std::string& action);
+
+		// Same as above, with an explicit scheduling class instead of the one guessed from the url.
+		static binanceError_t getCurlWithHeader(std::string& result_json, const std::string& url,
+			const std::vector<std::string>& extra_http_header, const std::string& post_data, const std::string& action,
+			binanceRequestClass_t requestClass);
+
+		// Share of the DNS cache and TLS sessions of all the handles of the
+		// process, may be set as CURLOPT_SHARE on the handles of the user too.
+		static CURLSH* getCurlShare();
+
+		// Trusted CAs of all TLS connections, REST and websocket. The PEM bundle
+		// is read once, from $SSL_CERT_FILE or the bundle of the system by default,
+		// and shared by all the curl handles and websocket contexts.
+		static bool setCaBundle(const std::string& path);
+		static const std::string& getCaBundle();
+
+		// Verify the peer and host name of a handle against the CA bundle,
+		// as for the handles of the library.
+		static bool setupTls(CURL* curl);
+
+		// Maximum number of concurrent connections of a request class.
+		static void setLaneSize(binanceRequestClass_t requestClass, int connections);
+
+		// GET request of a latency critical snapshot, hedged if enabled:
+		// when no response comes within the given percentile of the recent
+		// latencies, the same request is also sent to another healthy host
+		// of the HostPool and the first response is taken. Hedges count
+		// against the rate limits, and are skipped rather than delayed if the
+		// budget is short. Failed requests are repeated as by getCurl().
+		static binanceError_t getCurlHedged(std::string& result_json, const std::string& url);
+
+		// Alternate hosts of the urls not served by a HostPool, by default
+		// https://api1.binance.com, api2 and api3.
+		static void setHedging(bool enabled, double percentile = 0.95,
+			const std::vector<std::string>& alternates = std::vector<std::string>());
 	
 		const std::string prefix;
 
@@ -212,6 +283,8 @@ namespace binance
 
 		bool keysAreSet() const;
 
+		const Server& getServer() const;
+
 		binanceError_t getInfo(Json::Value &json_result, long recvWindow = 0);
 
 		binanceError_t getTrades(Json::Value &json_result, const char *symbol, int limit = 500);
@@ -0,0 +1,73 @@
+/*
+	C++ library for Binance API.
+*/
+
+#ifndef BINANCE_AGGTRADES_H
+#define BINANCE_AGGTRADES_H
+
+#include "binance.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace binance
+{
+	struct AggTrade
+	{
+		long long id;
+		double price;
+		double qty;
+		long long time;
+		bool isBuyerMaker;
+	};
+
+	// Crawls the aggregate trades history forward by id, for many symbols
+	// in parallel, into one file of packed records per symbol:
+	//
+	// <root>/<SYMBOL>.agg        records of recordSize bytes: id (i64), price (f64),
+	//                            qty (f64), time (i64), buyer is maker (u8)
+	// <root>/<SYMBOL>.checkpoint next id and the length of the file it was taken at
+	//
+	// The checkpoint is written after the records are flushed to disk, so
+	// after a crash the records past it are dropped and fetched again.
+	class AggTradeCrawler
+	{
+		const Server& server;
+		std::string root;
+		int threads;
+		int checkpointPages;
+		std::atomic<bool> stopped;
+
+		binanceError_t crawlSymbol(const std::string& symbol, long long fromId, long long endTime);
+
+	public :
+
+		static const size_t recordSize = 33;
+
+		AggTradeCrawler(const Server& server, const std::string& root, int threads = 4, int checkpointPages = 16);
+
+		// Fetch the trades of each symbol from its checkpoint (or from fromId,
+		// if there is none) until the present, or until the first trade past
+		// endTime, if not 0. May be interrupted with stop() from another thread.
+		binanceError_t crawl(const std::vector<std::string>& symbols, long long fromId = 0, long long endTime = 0);
+
+		void stop();
+
+		// Next id to fetch for the symbol, -1 if it has no checkpoint.
+		long long getCheckpoint(const std::string& symbol) const;
+
+		// Read back the stored trades of the symbol.
+		binanceError_t load(const std::string& symbol, std::vector<AggTrade>& trades) const;
+
+		// Parse the getAggTrades() response without building a Json tree,
+		// returns false if it is not a list of trades.
+		static bool parse(const char* data, size_t size, std::vector<AggTrade>& trades);
+
+		static void pack(const AggTrade& trade, char* record);
+		static void unpack(const char* record, AggTrade& trade);
+	};
+}
+
+#endif // BINANCE_AGGTRADES_H
+
@@ -0,0 +1,99 @@
+/*
+	C++ library for Binance API.
+*/
+
+#ifndef BINANCE_HOSTS_H
+#define BINANCE_HOSTS_H
+
+#include "binance.h"
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace binance
+{
+	// Base urls serving the same API, e.g. https://api.binance.com,
+	// https://api1.binance.com ... api4 and https://api-gcp.binance.com.
+	// The requests to the first one are routed to the fastest healthy
+	// host, by the round trip times of periodic pings. A circuit breaker
+	// takes a host out after consecutive failures, and lets a single
+	// request or ping try it again after a while.
+	class HostPool
+	{
+	public :
+
+		struct Host
+		{
+			std::string url;
+
+			// Smoothed ping round trip, negative until measured.
+			double rttMs;
+
+			// Consecutive failed requests and pings.
+			int failures;
+
+			// Taken out by the circuit breaker until openUntilMs.
+			bool open;
+			double openUntilMs;
+
+			// A single request was let through to try the host again, and
+			// has not reported yet. Should it never, another one is let
+			// through after the breaker period.
+			bool trial;
+		};
+
+		// Pool of the given base urls, created on first use and never destroyed.
+		static HostPool& add(const std::vector<std::string>& urls, const std::string& pingPath);
+
+		// Pool routing the requests to the url, NULL if none.
+		static HostPool* find(const std::string& url);
+
+		// The url moved to the fastest healthy host, and that host.
+		std::string route(const std::string& url, std::string& host);
+
+		// The url moved to the fastest healthy host other than the given
+		// one, e.g. for a hedge. False if no other host is in service.
+		bool routeOther(const std::string& url, const std::string& other, std::string& routed, std::string& host);
+
+		// Outcome of a request to the host, for the circuit breaker.
+		void report(const std::string& host, bool success);
+
+		// Take a host out after the number of consecutive failures, 3 by
+		// default, and try it again after the period, 30 s by default.
+		void setBreaker(int failures, unsigned int open_ms);
+
+		void getHosts(std::vector<Host>& hosts);
+
+		// Ping the hosts of all pools every period, from a background thread.
+		// The pings take the spare budget of the lowest request class: at
+		// weight 1 per host and ping, 6 hosts cost 36 of the 1200 request
+		// weight per minute with the default period.
+		static void startProbing(unsigned int period_ms = 10000);
+		static void stopProbing();
+
+	private :
+
+		std::mutex lock;
+		std::vector<Host> hosts;
+		std::string pingPath;
+		int maxFailures;
+		double openMs;
+
+		// Probe connections, only used by the probing thread.
+		std::vector<CURL*> probes;
+
+		HostPool(const std::vector<std::string>& urls, const std::string& pingPath);
+
+		// Index of the host to route to, see route(), with the lock held.
+		int pick(const std::string& other);
+
+		// Whether the probe pings the host, rather than leave it to its breaker.
+		bool isDue(size_t i);
+
+		void probe();
+	};
+}
+
+#endif // BINANCE_HOSTS_H
+
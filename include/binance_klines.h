@@ -0,0 +1,114 @@
+/*
+	C++ library for Binance API.
+*/
+
+#ifndef BINANCE_KLINES_H
+#define BINANCE_KLINES_H
+
+#include "binance.h"
+
+#include <string>
+#include <vector>
+
+namespace binance
+{
+	struct Kline
+	{
+		long long openTime;
+		double open;
+		double high;
+		double low;
+		double close;
+		double volume;
+		long long closeTime;
+		double quoteVolume;
+		long long trades;
+		double takerBuyBaseVolume;
+		double takerBuyQuoteVolume;
+	};
+
+	// Downloads long kline histories by splitting the time range into
+	// pages of at most pageSize candles and fetching them in parallel.
+	// The actual concurrency is bounded by the history connection lane
+	// (see Server::setLaneSize) and by the rate limiter.
+	class KlineDownloader
+	{
+		const Server& server;
+		int threads;
+		int pageSize;
+
+	public :
+
+		KlineDownloader(const Server& server, int threads = 4, int pageSize = 1000);
+
+		// Download the candles opened within [startTime, endTime), in ms,
+		// ordered by open time and without duplicates.
+		binanceError_t download(std::vector<Kline>& klines, const char *symbol, const char *interval,
+			long long startTime, long long endTime);
+
+		// Shortest duration of a candle of the given interval ("1m", "4h", "1M", ...) in ms, 0 if unknown.
+		static long long getIntervalMs(const char *interval);
+
+		// Convert a single row of the getKlines() response.
+		static void parse(const Json::Value& json_kline, Kline& kline);
+	};
+
+	// Local columnar store of klines: one directory per symbol and interval,
+	// holding a file per column of fixed-width native binary values,
+	// appended to in open time order and memory-mapped for reading.
+	//
+	// <root>/<SYMBOL>/<interval>/open_time.i64
+	// <root>/<SYMBOL>/<interval>/{open,high,low,close,volume}.f64
+	class KlineStore
+	{
+		std::string root;
+
+		std::string getPath(const char *symbol, const char *interval) const;
+
+	public :
+
+		// Read-only view of the stored columns, valid for the lifetime of the mapping.
+		class Mapping
+		{
+			void* maps[6];
+			size_t lengths[6];
+
+			Mapping(const Mapping&);
+			Mapping& operator=(const Mapping&);
+
+		public :
+
+			size_t size;
+			const long long *openTime;
+			const double *open;
+			const double *high;
+			const double *low;
+			const double *close;
+			const double *volume;
+
+			Mapping();
+			~Mapping();
+
+			bool load(const std::string& path);
+			void unload();
+		};
+
+		KlineStore(const std::string& root);
+
+		// Append the candles opened after the last stored one, the rest is ignored.
+		binanceError_t append(const char *symbol, const char *interval, const std::vector<Kline>& klines);
+
+		// Number of stored candles and the open time of the last one (-1 if none).
+		size_t size(const char *symbol, const char *interval, long long *lastOpenTime = NULL) const;
+
+		// Download the closed candles missing after the last stored one (or since startTime,
+		// if the store is empty) up to endTime (or up to now, if 0), and append them.
+		binanceError_t sync(KlineDownloader& downloader, const char *symbol, const char *interval,
+			long long startTime, long long endTime = 0);
+
+		bool map(const char *symbol, const char *interval, Mapping& mapping) const;
+	};
+}
+
+#endif // BINANCE_KLINES_H
+
@@ -0,0 +1,106 @@
+/*
+	C++ library for Binance API.
+*/
+
+#ifndef BINANCE_LATENCY_H
+#define BINANCE_LATENCY_H
+
+#include <stdint.h>
+#include <string>
+
+namespace binance
+{
+	// Latency instrumentation of the hot paths of the library. Each point
+	// records into a histogram of the calling thread, so that recording is
+	// a timestamp and a counter update without locks or allocations. The
+	// histograms are log-linear (HDR), with a 1.6% relative precision from
+	// 1 ns to about two minutes, and are merged over all threads when queried.
+	//
+	// Timestamps are read from the TSC on x86, calibrated against the
+	// monotonic clock, and from the monotonic clock elsewhere.
+	class Latency
+	{
+	public :
+
+		enum Point
+		{
+			RequestBuild, // query string and signature of a signed request
+			Sign,         // HMAC-SHA256 of the request
+			DnsLookup,    // name resolution, for new connections
+			Connect,      // TCP connect, for new connections
+			TlsHandshake, // TLS handshake, for new connections
+			FirstByte,    // request sent until the first response byte
+			Transfer,     // first until the last response byte
+			Parse,        // JSON decoding of a response or frame
+			Callback,     // user callback of a websocket frame
+			WsDispatch,   // websocket frame received until its callback
+			PointCount
+		};
+
+		struct Stats
+		{
+			uint64_t count;
+			double min, mean, max; // ns
+			double p50, p90, p99, p999;
+		};
+
+		typedef uint64_t Ticks;
+
+		static inline Ticks now()
+		{
+#if defined(__x86_64__) || defined(__i386__)
+			return __builtin_ia32_rdtsc();
+#else
+			return monotonicNs();
+#endif
+		}
+
+		static const char* getName(Point point);
+
+		// Turn the recording on or off, on by default.
+		static void setEnabled(bool enabled);
+		static bool isEnabled();
+
+		// Record the time elapsed since begin, taken with now().
+		static void record(Point point, Ticks begin);
+
+		// Record a duration measured otherwise, e.g. by curl.
+		static void recordNs(Point point, double ns);
+
+		// Statistics of a point, over all threads since the last reset().
+		static void getStats(Point point, Stats& stats);
+
+		static void reset();
+
+		// One line per point with samples: count and latencies in microseconds.
+		static std::string dump();
+
+		// Write dump() to the log every period, then reset() if requested,
+		// from a background thread.
+		static void startDump(unsigned int period_sec = 60, bool reset = true);
+		static void stopDump();
+
+	private :
+
+		static uint64_t monotonicNs();
+	};
+
+	// Record the time spent in a scope.
+	class LatencyScope
+	{
+		const Latency::Point point;
+		const Latency::Ticks begin;
+
+	public :
+
+		LatencyScope(Latency::Point point_) : point(point_), begin(Latency::now()) { }
+
+		~LatencyScope()
+		{
+			Latency::record(point, begin);
+		}
+	};
+}
+
+#endif // BINANCE_LATENCY_H
+
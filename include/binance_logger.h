@@ -1,7 +1,7 @@
 /*
 	Author: tensaix2j
 	Date  : 2017/10/15
-	
+
 	C++ library for Binance API.
 */
 
@@ -11,21 +11,150 @@
 #include <cstdio>
 #include <string>
 
+// Most verbose level compiled in, see binanceLogLevel_t: the log macros
+// of the levels above it expand to nothing, arguments included.
+#ifndef BINANCE_LOG_LEVEL
+#define BINANCE_LOG_LEVEL 4
+#endif
+
+#define BINANCE_LOG(level, category, ...)                             \
+    do {                                                             \
+        if (binance::Logger::is_enabled(level, category))            \
+            binance::Logger::write_log(__VA_ARGS__);                 \
+    } while (0)
+
+#if BINANCE_LOG_LEVEL >= 1
+#define BINANCE_LOG_ERROR(category, ...) BINANCE_LOG(binance::binanceLogError, category, __VA_ARGS__)
+#else
+#define BINANCE_LOG_ERROR(category, ...) do { } while (0)
+#endif
+
+#if BINANCE_LOG_LEVEL >= 2
+#define BINANCE_LOG_INFO(category, ...) BINANCE_LOG(binance::binanceLogInfo, category, __VA_ARGS__)
+#else
+#define BINANCE_LOG_INFO(category, ...) do { } while (0)
+#endif
+
+#if BINANCE_LOG_LEVEL >= 3
+#define BINANCE_LOG_DEBUG(category, ...) BINANCE_LOG(binance::binanceLogDebug, category, __VA_ARGS__)
+#else
+#define BINANCE_LOG_DEBUG(category, ...) do { } while (0)
+#endif
+
+#if BINANCE_LOG_LEVEL >= 4
+#define BINANCE_LOG_TRACE(category, ...) BINANCE_LOG(binance::binanceLogTrace, category, __VA_ARGS__)
+#else
+#define BINANCE_LOG_TRACE(category, ...) do { } while (0)
+#endif
+
 namespace binance
 {
+	enum binanceLogLevel_t
+	{
+		binanceLogError = 1,
+		binanceLogInfo,  // state changes, e.g. clock sync and rate limit backoff
+		binanceLogDebug, // entry and exit of the calls
+		binanceLogTrace, // requests and transfers in full
+	};
+
+	enum binanceLogCategory_t
+	{
+		binanceLogGeneral = 0,
+		binanceLogHttp,
+		binanceLogWs,
+		binanceLogAccount,
+		binanceLogMarket,
+		binanceLogCategoryCount,
+	};
+
+	// Argument of a log line, captured as is: the strings are copied
+	// with the record, all the rest is formatted by the writer thread.
+	struct LogArg
+	{
+		enum Type
+		{
+			Int, UInt, Long, ULong, LongLong, ULongLong, Double, Pointer, String,
+		};
+
+		Type type;
+		union
+		{
+			int i;
+			unsigned int u;
+			long l;
+			unsigned long ul;
+			long long ll;
+			unsigned long long ull;
+			double d;
+			const void* p;
+			const char* s;
+		};
+
+		LogArg(int value) : type(Int), i(value) { }
+		LogArg(unsigned int value) : type(UInt), u(value) { }
+		LogArg(long value) : type(Long), l(value) { }
+		LogArg(unsigned long value) : type(ULong), ul(value) { }
+		LogArg(long long value) : type(LongLong), ll(value) { }
+		LogArg(unsigned long long value) : type(ULongLong), ull(value) { }
+		LogArg(double value) : type(Double), d(value) { }
+		LogArg(const char* value) : type(String), s(value) { }
+		LogArg(char* value) : type(String), s(value) { }
+		template<typename T> LogArg(T* value) : type(Pointer), p(value) { }
+	};
+
+	// Log lines are captured into a lock-free ring of the calling thread:
+	// the format string pointer, the time and the raw arguments. A writer
+	// thread formats and writes them in batches, in time order.
 	class Logger
 	{
 		static int debug_level;
 		static std::string debug_log_file;
 		static int debug_log_file_enable ;
 		static FILE *log_fp;
+		static int category_levels[binanceLogCategoryCount];
 
 		static void open_logfp_if_not_opened();
 
+		static void write_record( bool clean, const char *fmt, const LogArg *args, int count );
+
 	public :
 
-		static void write_log( const char *fmt, ... );
-		static void write_log_clean( const char *fmt, ... ); 
+		// The format is kept by pointer, so it must be a string literal.
+		template<typename... Args>
+		static void write_log( const char *fmt, const Args&... args )
+		{
+			if ( debug_level == 0 )
+				return;
+
+			const LogArg argv[] = { LogArg(args)..., LogArg(0) };
+			write_record( false, fmt, argv, sizeof...(args) );
+		}
+
+		// Write log to channel without any timestamp nor new line
+		template<typename... Args>
+		static void write_log_clean( const char *fmt, const Args&... args )
+		{
+			if ( debug_level == 0 )
+				return;
+
+			const LogArg argv[] = { LogArg(args)..., LogArg(0) };
+			write_record( true, fmt, argv, sizeof...(args) );
+		}
+
+		// Write out all the lines logged so far.
+		static void flush();
+
+		// Whether the lines of the level and category are written, checked
+		// by the log macros before the arguments are evaluated.
+		static bool is_enabled( binanceLogLevel_t level, binanceLogCategory_t category )
+		{
+			return debug_level != 0 && level <= category_levels[category];
+		}
+
+		// Most verbose level written, of all categories or of one, binanceLogTrace by default.
+		static void set_log_level( binanceLogLevel_t level );
+		static void set_log_level( binanceLogCategory_t category, binanceLogLevel_t level );
+
 		static void set_debug_level( int level );
 		static void set_debug_logfile( std::string &pDebug_log_file );
 		static void set_debug_logfp( FILE* log_fp );
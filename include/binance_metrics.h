@@ -0,0 +1,87 @@
+/*
+	C++ library for Binance API.
+*/
+
+#ifndef BINANCE_METRICS_H
+#define BINANCE_METRICS_H
+
+#include "binance.h"
+
+#include <functional>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace binance
+{
+	// Registry of the health metrics of the library: connections, streams,
+	// errors, rate limits and queues. The counters are kept per thread, so
+	// that incrementing one costs a few ns without locks or contention, and
+	// are summed over the threads on scrape. They are exposed in the
+	// Prometheus text format, over HTTP for pull, or pushed to StatsD.
+	class Metrics
+	{
+	public :
+
+		typedef std::vector<std::pair<std::string, std::string> > Labels;
+
+		// Monotonic counter, cheap to copy and to increment from any thread.
+		class Counter
+		{
+			int id;
+
+		public :
+
+			Counter() : id(-1) { }
+			explicit Counter(int id_) : id(id_) { }
+
+			bool isValid() const { return id >= 0; }
+
+			void add(uint64_t value = 1) const;
+		};
+
+		// Value set from any thread, read on scrape.
+		class Gauge
+		{
+			int id;
+
+		public :
+
+			Gauge() : id(-1) { }
+			explicit Gauge(int id_) : id(id_) { }
+
+			bool isValid() const { return id >= 0; }
+
+			void set(double value) const;
+			void add(double value) const;
+		};
+
+		// The series of the given name and labels, created on first use.
+		// Look them up once and keep the handles for the hot paths.
+		static Counter getCounter(const std::string& name, const std::string& help, const Labels& labels = Labels());
+		static Gauge getGauge(const std::string& name, const std::string& help, const Labels& labels = Labels());
+
+		// Called before each scrape, to update gauges of state owned elsewhere.
+		static void addCollector(const std::function<void()>& collector);
+
+		// Count a failed REST request in binance_rest_errors_total.
+		static void countError(binanceError_t error);
+
+		// All series in the Prometheus text exposition format.
+		static std::string scrape();
+
+		// Serve scrape() to GET requests on the port, from a background thread.
+		static bool startHttp(int port, const std::string& address = "0.0.0.0");
+		static void stopHttp();
+
+		// Push all series to a StatsD agent over UDP every period, counters as
+		// increments since the last push and labels as DogStatsD tags.
+		static bool startStatsd(const std::string& host, int port = 8125, unsigned int period_sec = 10,
+			const std::string& prefix = "");
+		static void stopStatsd();
+	};
+}
+
+#endif // BINANCE_METRICS_H
+
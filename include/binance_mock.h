@@ -0,0 +1,143 @@
+/*
+	C++ library for Binance API.
+*/
+
+#ifndef BINANCE_MOCK_H
+#define BINANCE_MOCK_H
+
+#include <json/json.h>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct lws;
+struct lws_context;
+
+namespace binance
+{
+	// Local mock of the exchange, serving the REST endpoints used by Market and
+	// Account and websocket streams over plain HTTP on localhost, for offline
+	// tests and benchmarks. Point the library at it with:
+	//
+	// MockServer mock;
+	// mock.start();
+	// Server server(mock.getUrl().c_str());
+	// Websocket::set_host("127.0.0.1", mock.getPort(), false);
+	//
+	// The REST responses are synthetic and deterministic: a fixed price per
+	// symbol, a flat book around it, and orders which are accepted and stored
+	// but never matched. Any endpoint may be overridden with setHandler().
+	// Websocket clients subscribe to the stream of their path (e.g.
+	// "/ws/btcusdt@depth"), fed by publish() or by play() of a recorded log.
+	class MockServer
+	{
+	public :
+
+		struct Request
+		{
+			std::string method;
+			std::string path;
+			std::map<std::string, std::string> params; // query and form body
+		};
+
+		// Fill in the response body and return the HTTP status.
+		typedef std::function<int(const Request& request, std::string& body)> Handler;
+
+		MockServer();
+		~MockServer();
+
+		// Listen on the given port of the loopback interface, any free one if 0.
+		bool start(int port = 0);
+		void stop();
+
+		int getPort() const;
+
+		// Base url to pass to Server.
+		std::string getUrl() const;
+
+		// Replace the handler of an endpoint, e.g. ("GET", "/api/v3/depth").
+		void setHandler(const std::string& method, const std::string& path, Handler handler);
+
+		// Serve a fixed response for an endpoint.
+		void setResponse(const std::string& method, const std::string& path, const std::string& body, int status = 200);
+
+		void setPrice(const std::string& symbol, double price);
+		void setBalance(const std::string& asset, double free, double locked = 0);
+
+		// Send a frame to the websocket clients of the given path, from any thread.
+		void publish(const std::string& path, const std::string& frame);
+
+		// Publish the frames of a recorded log to the paths they were recorded from,
+		// paced to the recorded times divided by speed, or as fast as possible if 0.
+		bool play(const std::string& filename, double speed = 1);
+
+		// Number of websocket clients connected to the path.
+		size_t getSubscribers(const std::string& path) const;
+
+		// Called by libwebsockets on the service thread.
+		int onHttp(lws* wsi, int reason, void* in, size_t len);
+		int onWebsocket(lws* wsi, int reason, void* in, size_t len);
+
+	private :
+
+		struct HttpSession
+		{
+			Request request;
+			std::string body;
+			int status;
+			std::string response;
+		};
+
+		struct WsSession
+		{
+			std::string path;
+			std::deque<std::string> queue;
+		};
+
+		struct Order
+		{
+			Json::Value json;
+			bool open;
+		};
+
+		lws_context* context;
+		std::thread service;
+		std::atomic<bool> running;
+		int port;
+
+		mutable std::mutex lock; // guards all below, except the sessions
+		std::map<std::string, Handler> handlers;
+		std::map<std::string, double> prices;
+		std::map<std::string, std::pair<double, double> > balances;
+		std::map<long, Order> orders;
+		long nextOrderId;
+		long nextUpdateId;
+		int nextListenKey;
+		std::vector<std::pair<std::string, std::string> > pending;
+		std::map<std::string, size_t> subscribers;
+
+		// Service thread only.
+		std::unordered_map<lws*, HttpSession> httpSessions;
+		std::unordered_map<lws*, WsSession> wsSessions;
+
+		MockServer(const MockServer&);
+		MockServer& operator=(const MockServer&);
+
+		void serve();
+		void respond(lws* wsi, HttpSession& session);
+		int handle(const Request& request, std::string& body);
+		void addDefaultHandlers();
+		double getPrice(const std::string& symbol);
+		Order* findOrder(const Request& request);
+	};
+}
+
+#endif // BINANCE_MOCK_H
+
@@ -0,0 +1,101 @@
+/*
+	C++ library for Binance API.
+*/
+
+#ifndef BINANCE_ORDER_TRACKER_H
+#define BINANCE_ORDER_TRACKER_H
+
+#include "binance.h"
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace binance
+{
+	// In-memory table of open orders and balances, kept up to date
+	// from the user data stream (executionReport, outboundAccountPosition
+	// and balanceUpdate events). REST is only used by reconcile(),
+	// which is meant to be called once after each (re)connect of the stream.
+	class OrderTracker
+	{
+	public :
+
+		struct Order
+		{
+			std::string symbol;
+			long orderId;
+			std::string clientOrderId;
+			std::string side;
+			std::string type;
+			std::string timeInForce;
+			std::string status;
+			double price;
+			double origQty;
+			double stopPrice;
+			double executedQty;
+			double cummulativeQuoteQty;
+			long long updateTime;
+
+			Order();
+		};
+
+		struct Balance
+		{
+			double free;
+			double locked;
+
+			Balance();
+		};
+
+		OrderTracker();
+
+		// Apply a raw user data stream event. Unknown events are ignored.
+		// Returns 0, so that it could be called straight from a websocket callback.
+		int onUserData(const Json::Value &json_value);
+
+		// Replace the local state with a snapshot of open orders and balances.
+		// The stream events received meanwhile are held back and applied
+		// on top of the snapshot, unless it is already more recent.
+		binanceError_t reconcile(Account &account, long recvWindow = 0);
+
+		bool getOrder(long orderId, Order &order) const;
+		bool getOrder(const std::string &clientOrderId, Order &order) const;
+
+		// Open orders, optionally filtered by symbol.
+		void getOpenOrders(std::vector<Order> &result, const char *symbol = NULL) const;
+
+		bool getBalance(const std::string &asset, Balance &balance) const;
+		void getBalances(std::map<std::string, Balance> &result) const;
+
+		void clear();
+
+	private :
+
+		mutable std::mutex lock;
+
+		std::unordered_map<long, Order> orders;
+		std::unordered_map<std::string, long> clientOrderIds;
+		std::map<std::string, Balance> balances;
+
+		// Time of the account snapshot the balances were taken from.
+		long long balancesTime;
+
+		// Stream events received during reconcile(), applied once it is done.
+		bool reconciling;
+		std::vector<Json::Value> pending;
+
+		void onExecutionReport(const Json::Value &json_value);
+		void onAccountPosition(const Json::Value &json_value);
+		void onBalanceUpdate(const Json::Value &json_value);
+		void apply(const Json::Value &json_value);
+		void endReconcile();
+
+		void eraseOrder(long orderId);
+	};
+}
+
+#endif // BINANCE_ORDER_TRACKER_H
+
@@ -0,0 +1,121 @@
+/*
+	C++ library for Binance API.
+*/
+
+#ifndef BINANCE_RATELIMIT_H
+#define BINANCE_RATELIMIT_H
+
+#include "binance.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace binance
+{
+	// Client side accounting of the exchange rate limits, one per host.
+	// Each limit is a token bucket refilled continuously over its interval,
+	// and corrected down whenever the exchange reports a higher usage in
+	// the X-MBX-USED-WEIGHT-* and X-MBX-ORDER-COUNT-* response headers.
+	class RateLimiter
+	{
+	public :
+
+		enum LimitType
+		{
+			RequestWeight,
+			Orders,
+			RawRequests,
+		};
+
+		// What to do with a request that does not fit into the budget.
+		enum Mode
+		{
+			Queue, // wait until the budget refills
+			Shed,  // fail immediately with binanceErrorRateLimited
+		};
+
+		struct Limit
+		{
+			LimitType type;
+			long intervalMs;
+			double limit;
+			double tokens;
+			double updatedMs;
+		};
+
+		// Usage reported by a single response header.
+		struct Usage
+		{
+			LimitType type;
+			long intervalMs;
+			double used;
+		};
+
+		// Limiter shared by all requests to the host of the given url.
+		static RateLimiter& get(const std::string& url);
+
+		// Weight of a request, by endpoint and parameters.
+		static int getWeight(const std::string& url, const std::string& action);
+
+		// Whether the request places a new order and so counts against ORDERS limits.
+		static bool isOrder(const std::string& url, const std::string& action);
+
+		// Scheduling class of a request, by endpoint and parameters.
+		static binanceRequestClass_t getClass(const std::string& url, const std::string& action);
+
+		// Parse a rate limit related response header, returns false for others.
+		static bool parseUsage(const char* header, size_t size, Usage& usage);
+		static bool parseRetryAfter(const char* header, size_t size, int& retryAfter);
+
+		// Take the budget of one request before sending it. Waiting requests
+		// are served in the order of their class priority, and only order
+		// entry may use the reserved part of the budget. A request short on
+		// an ORDERS limit only holds back the other orders, not the classes
+		// below it, which do not count against those limits.
+		binanceError_t acquire(int weight, bool order, binanceRequestClass_t requestClass = binanceRequestMarketData);
+
+		// Take the budget of an optional request, only if it is available
+		// right away: e.g. of a hedge, which is pointless if delayed.
+		bool tryAcquire(int weight, binanceRequestClass_t requestClass = binanceRequestMarketData);
+
+		// Account the response: the usage reported in headers,
+		// and the ban announced by HTTP 429/418 with Retry-After.
+		void update(const std::vector<Usage>& usage, long httpStatus, int retryAfter);
+
+		// Replace the limits by the "rateLimits" section of exchangeInfo.
+		void setLimits(const Json::Value& rateLimits);
+
+		void setMode(Mode mode);
+
+		// Fraction of the request budget kept for order entry, 0.1 by default.
+		void setOrderReserve(double fraction);
+
+		// Current state of all limits, with tokens refilled to now.
+		void getLimits(std::vector<Limit>& limits);
+
+	private :
+
+		std::mutex lock;
+		std::condition_variable refilled;
+		std::vector<Limit> limits;
+		Mode mode;
+		double bannedUntilMs;
+		double orderReserve;
+		int waiting[binanceRequestClassCount];
+
+		// Of the waiting requests, those short on the request weight
+		// or raw request budget, which all classes share.
+		int waitingShared[binanceRequestClassCount];
+
+		RateLimiter();
+
+		void refill(double nowMs);
+		double waitMs(int weight, bool order, binanceRequestClass_t requestClass, double nowMs, bool* shared = NULL) const;
+		bool hasPriorityWaiters(binanceRequestClass_t requestClass) const;
+	};
+}
+
+#endif // BINANCE_RATELIMIT_H
+
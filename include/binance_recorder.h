@@ -0,0 +1,107 @@
+/*
+	C++ library for Binance API.
+*/
+
+#ifndef BINANCE_RECORDER_H
+#define BINANCE_RECORDER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace binance
+{
+	// Records the raw frames received by all websocket endpoints into a log file.
+	// The receive path only copies the frame into a lock-free ring buffer, while
+	// a dedicated thread drains it to disk. Frames that do not fit into the ring
+	// are dropped and counted rather than blocking the receive path.
+	//
+	// The file starts with the 8 bytes magic "BNCREC1\n", followed by records:
+	//
+	// Name		Type	Description
+	// length	u32	Payload size in bytes.
+	// type		u16	0 - frame, 1 - stream declaration.
+	// stream	u16	Stream id, declared before its first frame.
+	// time		i64	Receive time in ns since the epoch.
+	// payload		The frame as received, or the endpoint path of the stream.
+	//
+	// All values are native endian. If the library is built with zlib, files
+	// named with the ".gz" suffix are gzip-compressed.
+	class Recorder
+	{
+	public :
+
+		enum RecordType
+		{
+			Frame = 0,
+			StreamName = 1,
+		};
+
+		static const char magic[8];
+		static const size_t headerSize = 16;
+
+		// Stream id of an endpoint, cached by the endpoint for the current log.
+		struct Stream
+		{
+			unsigned generation;
+			uint16_t id;
+
+			Stream() : generation(0), id(0) { }
+		};
+
+		// Start recording into the file, replacing the current one.
+		// The ring size is rounded up to a power of two. The user data streams
+		// carry private account events under a path naming the listenKey, so
+		// they are only recorded if userData is set.
+		static bool start(const std::string& filename, size_t ringSize = 64 << 20, bool userData = false);
+
+		// Write out the buffered frames and close the file.
+		static void stop();
+
+		static bool isRecording();
+		static bool isRecordingUserData();
+
+		// Number of frames dropped since the start because the ring was full.
+		static unsigned long long getDropped();
+
+		// Called by the websocket receive path, with the time the frame was received.
+		static void record(Stream& stream, const std::string& path, const char* data, size_t size, int64_t timeNs);
+
+		// Current time in ns since the epoch.
+		static int64_t now();
+	};
+
+	// Sequential reader of the logs written by Recorder.
+	class RecordReader
+	{
+		void* file;
+		bool compressed;
+
+		RecordReader(const RecordReader&);
+		RecordReader& operator=(const RecordReader&);
+
+		bool read(void* data, size_t size);
+
+	public :
+
+		struct Record
+		{
+			Recorder::RecordType type;
+			uint16_t stream;
+			int64_t timeNs;
+			std::vector<char> payload;
+		};
+
+		RecordReader();
+		~RecordReader();
+
+		bool open(const std::string& filename);
+		void close();
+
+		// Read the next record, returns false at the end of the log.
+		bool next(Record& record);
+	};
+}
+
+#endif // BINANCE_RECORDER_H
+
@@ -0,0 +1,66 @@
+/*
+	C++ library for Binance API.
+*/
+
+#ifndef BINANCE_RETRY_H
+#define BINANCE_RETRY_H
+
+#include "binance.h"
+
+#include <string>
+
+namespace binance
+{
+	// When and how soon to repeat a failed REST request. Only transient
+	// failures are repeated: network errors, empty responses, HTTP 5xx,
+	// and HTTP 429/418 once their Retry-After has passed. The delays grow
+	// exponentially with full jitter, so that many clients failing at once
+	// do not retry in lockstep.
+	class RetryPolicy
+	{
+	public :
+
+		enum Kind
+		{
+			// GET requests, repeated as they are by Server::getCurlWithHeader().
+			Safe = 0,
+
+			// New orders, repeated by Account::sendOrder() under the same
+			// newClientOrderId, and only after querying the order shows
+			// that the previous attempt did not reach the exchange. The query
+			// waits for that attempt to expire (recvWindow), beyond maxDelayMs.
+			Order,
+
+			KindCount,
+		};
+
+		struct Rule
+		{
+			// Attempts in total, 1 disables retries.
+			int attempts;
+
+			// Upper bound of the first delay, doubled with each attempt.
+			unsigned int baseDelayMs;
+
+			// Longest delay, including the one asked by Retry-After:
+			// the request fails rather than wait longer.
+			unsigned int maxDelayMs;
+		};
+
+		static Rule getRule(Kind kind);
+		static void setRule(Kind kind, const Rule& rule);
+
+		// Whether the request may have failed for a transient reason.
+		static bool isTransient(const binanceErrorInfo_t& error);
+
+		// Whether to repeat the request after the given failed attempt,
+		// counted from 0, and the delay before the repeat.
+		static bool shouldRetry(Kind kind, int attempt, const binanceErrorInfo_t& error, unsigned int& delayMs);
+
+		// Random id for newClientOrderId, to recognize a new order across attempts.
+		static std::string makeClientOrderId();
+	};
+}
+
+#endif // BINANCE_RETRY_H
+
@@ -0,0 +1,162 @@
+/*
+	C++ library for Binance API.
+*/
+
+#ifndef BINANCE_SIMULATOR_H
+#define BINANCE_SIMULATOR_H
+
+#include "binance.h"
+#include "binance_websocket.h"
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace binance
+{
+	class OrderTracker;
+
+	// Paper trading matching engine, used instead of the exchange by the order
+	// entry calls of Account when the server is a simulator:
+	//
+	// Server server("https://api.binance.com", "/api/v3", true);
+	//
+	// Orders are matched against the book fed by onMarketData(): the depth,
+	// bookTicker and trade streams, live or replayed. This happens automatically
+	// for all frames received by Websocket endpoints. Marketable orders take
+	// liquidity level by level, the rest of the limit orders rests in the book
+	// and is filled as a maker when the market trades or quotes through it.
+	// Each change is reported as a synthetic executionReport (and
+	// outboundAccountPosition) event on the user data stream.
+	class Simulator
+	{
+	public :
+
+		// Simulator of the server, by hostname.
+		static Simulator& get(const Server& server);
+
+		// Update the books of all simulators with a market data event, received on
+		// the given endpoint path (which names the symbol of partial depth streams).
+		static void onMarketData(const std::string& path, const Json::Value& json_value);
+
+		// Round trip of order entry requests, half of it before the order reaches
+		// the book and half for the response to come back, 0 by default.
+		void setLatency(double roundTripMs);
+
+		// Commission rates, charged on the received asset, 0.1% by default.
+		void setFees(double makerRate, double takerRate);
+
+		void setBalance(const std::string& asset, double free);
+
+		// Receive the user data stream events, in place of the websocket connection.
+		// They are delivered one at a time and in the order they happened, so an
+		// order entry call may return before its events are, as on the exchange.
+		void setUserDataStream(CB user_cb, OrderTracker *tracker = nullptr);
+
+		// Drop the book of a symbol in all simulators, e.g. after depth updates
+		// went missing. The depth updates are ignored until a snapshot (partial
+		// depth, or getDepth() passed to onMarketData()) or setBook() replaces it.
+		static void resetBook(const std::string& symbol);
+
+		// Replace the book of a symbol, levels are (price, quantity).
+		void setBook(const std::string& symbol, const std::vector<std::pair<double, double> >& bids,
+			const std::vector<std::pair<double, double> >& asks);
+
+		// Account API of the simulator, same results as the exchange.
+		binanceError_t sendOrder(Json::Value &json_result, const char *symbol, const char *side, const char *type,
+			const char *timeInForce, double quantity, double price, const char *newClientOrderId, double stopPrice);
+		binanceError_t cancelOrder(Json::Value &json_result, const char *symbol,
+			long orderId, const char *origClientOrderId, const char *newClientOrderId);
+		binanceError_t getOrder(Json::Value &json_result, const char *symbol,
+			long orderId, const char *origClientOrderId);
+		binanceError_t getOpenOrders(Json::Value &json_result, const char *symbol = NULL);
+		binanceError_t getAllOrders(Json::Value &json_result, const char *symbol, long orderId = 0, int limit = 0);
+		binanceError_t getInfo(Json::Value &json_result);
+
+	private :
+
+		struct Order
+		{
+			std::string symbol;
+			long orderId;
+			std::string clientOrderId;
+			std::string origClientOrderId;
+			std::string side;
+			std::string type;
+			std::string timeInForce;
+			double price;
+			double stopPrice;
+			double origQty;
+			double executedQty;
+			double cummulativeQuoteQty;
+			std::string status;
+			long long time;
+			long long updateTime;
+		};
+
+		struct Fill
+		{
+			double price;
+			double qty;
+			double commission;
+			std::string commissionAsset;
+			long tradeId;
+		};
+
+		struct Book
+		{
+			std::map<double, double, std::greater<double> > bids;
+			std::map<double, double> asks;
+
+			// Missed some depth updates, waiting for a snapshot.
+			bool stale;
+
+			Book() : stale(false) { }
+		};
+
+		std::mutex lock;
+		std::map<std::string, Book> books;
+		std::map<long, Order> orders;
+		std::map<std::string, double> balances;
+		long nextOrderId;
+		long nextTradeId;
+		double latencyMs;
+		double makerRate;
+		double takerRate;
+		CB user_cb;
+		OrderTracker *tracker;
+
+		// Events not delivered yet, in the order they were created, and
+		// whether a thread is delivering them.
+		std::deque<Json::Value> outbox;
+		bool delivering;
+
+		Simulator();
+		Simulator(const Simulator&);
+		Simulator& operator=(const Simulator&);
+
+		void update(const std::string& symbol, const Json::Value& json_value, std::vector<Json::Value>& events);
+		void take(Order& order, std::vector<Fill>& fills, std::vector<Json::Value>& events);
+		void matchResting(const std::string& symbol, double tradePrice, double tradeQty, std::vector<Json::Value>& events);
+		void fill(Order& order, double price, double qty, bool maker, std::vector<Fill>& fills,
+			std::vector<Json::Value>& events);
+		void report(const Order& order, const char* executionType, const Fill* fill, bool maker,
+			std::vector<Json::Value>& events);
+		Order* findOrder(const char *symbol, long orderId, const char *origClientOrderId);
+		double getLocked(const std::string& asset) const;
+		void post(const std::vector<Json::Value>& events);
+		void deliver();
+		void wait(double ms) const;
+
+		static Json::Value toJson(const Order& order);
+		static Json::Value getError(int code, const char* msg);
+		static std::string getBaseAsset(const std::string& symbol);
+		static std::string getQuoteAsset(const std::string& symbol);
+	};
+}
+
+#endif // BINANCE_SIMULATOR_H
+
@@ -20,13 +20,30 @@ namespace binance
 
 	std::string b2a_hex( char *byte_arr, int n );
 	time_t get_current_epoch();
+
+	// Current time in ms as seen by the exchange: the local monotonic
+	// clock corrected by the offset and drift set with set_server_clock().
+	// Falls back to the local wall clock until the first call of it.
 	unsigned long get_current_ms_epoch();
+	unsigned long get_local_ms_epoch();
+
+	// Monotonic clock, in ms since an arbitrary point.
+	double get_monotonic_ms();
+
+	// Anchor the exchange clock: at monotonic time mono_ms the exchange
+	// time was server_ms, and it runs faster than the local monotonic
+	// clock by drift (e.g. 1e-6 for 1 ppm).
+	void set_server_clock(double mono_ms, double server_ms, double drift = 0);
+	bool get_server_clock(double &offset_ms, double &drift);
 
 	inline bool file_exists (const std::string& name)
 	{
 	 	 return ( access( name.c_str(), F_OK ) != -1 );
 	}
 
+	// Create the directory along with all missing parents, like mkdir -p.
+	bool make_directories( const std::string& path );
+
 	std::string hmac_sha256( const char *key, const char *data);
 	std::string sha256( const char *data );
 	void string_toupper( std::string &src);
@@ -10,22 +10,75 @@
 
 #include <json/json.h>
 #include <chrono>
+#include <string>
 
 #define BINANCE_WS_HOST "stream.binance.com"
 #define BINANCE_WS_PORT 9443
 
 namespace binance
 {
+	class Account;
+	class OrderTracker;
+
 	typedef int (*CB)( Json::Value &json_value );
 
+	// Called with the endpoint path and the symbol of a diff depth stream
+	// that skipped some updates.
+	typedef void (*RESYNC_CB)( const std::string &path, const std::string &symbol );
+
 	class Websocket
 	{	
 	public :
 		static void connect_endpoint(CB user_cb, const std::string &path);
         static void disconnect_endpoint(const std::string &path);
 		static void init();
+
+		// Connect the endpoints to another host than BINANCE_WS_HOST:BINANCE_WS_PORT,
+		// e.g. a MockServer. Must be called before the endpoints are connected.
+		static void set_host(const std::string &host, int port, bool ssl = true);
+
+		// Resolve the host ahead of the first connections, which then connect
+		// to the address without a DNS lookup, until a connection to it fails.
+		// Calling init() early as well sets up the TLS context ahead of them.
+		static bool warm_up();
+
+		// Delays between the reconnections of an endpoint that dropped: the
+		// first one is base_ms, doubled with each failed attempt up to max_ms,
+		// less up to 30 % of jitter; 500 ms and 30 s by default. After max_retries
+		// consecutive failures the endpoint is dropped, 0 retries forever.
+		// Each endpoint reconnects on its own, the others are not affected.
+		static void set_reconnect_backoff(unsigned int base_ms, unsigned int max_ms, unsigned int max_retries = 0);
+
+		// Called from the event loop when the U..u range of a depthUpdate event
+		// does not follow the u of the previous one of the symbol (pu on futures),
+		// e.g. after a reconnection, before the event is passed to the endpoint.
+		// The local book is then stale: fetch a snapshot with Market::getDepth()
+		// from another thread, and apply the updates buffered meanwhile that
+		// have u > lastUpdateId. The callback must not block the event loop.
+		// The book of the Simulator is dropped as well, until the snapshot is
+		// passed to Simulator::onMarketData() (see Simulator::resetBook()).
+		static void set_resync_callback(RESYNC_CB resync_cb);
 		static void enter_event_loop(const std::chrono::hours &hours = std::chrono::hours(24));
         static void kill_all();
+
+		// Start a user data stream for the account and connect it. The listenKey
+		// is kept alive from the event loop timer, and re-created transparently
+		// once it expires. If a tracker is given, it is fed with all stream events
+		// and reconciled over REST each time the stream (re)connects.
+		// The account and the tracker must outlive the event loop.
+		static bool connect_user_data_stream(CB user_cb, Account &account, OrderTracker *tracker = nullptr);
+		static void disconnect_user_data_stream(Account &account);
+
+		// Register a callback for the frames recorded from the given endpoint path
+		// (see Recorder), to be called by replay() instead of a live connection.
+		static void connect_replay_endpoint(CB user_cb, const std::string &path);
+		static void disconnect_replay_endpoint(const std::string &path);
+
+		// Feed the frames of a recorded log to the replay endpoints, through the
+		// same decoding as the live connections. With speed 0 the frames are
+		// replayed as fast as possible, otherwise paced to the recorded receive
+		// times, sped up by the given factor. Blocks until the end of the log.
+		static bool replay(const std::string &filename, double speed = 0);
 	};
 }
 
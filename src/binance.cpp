@@ -44,6 +44,8 @@ const char* binance::binanceGetErrorString(const binanceError_t err)
 	BINANCE_CASE_STR(binanceErrorMissingAccountKeys);
 	BINANCE_CASE_STR(binanceErrorCurlFailed);
 	BINANCE_CASE_STR(binanceErrorCurlOutOfMemory);
+	BINANCE_CASE_STR(binanceErrorRateLimited);
+	BINANCE_CASE_STR(binanceErrorServer);
 	default :
 		// Make compiler happy regarding unhandled enums.
 		break;
@@ -53,6 +55,22 @@ const char* binance::binanceGetErrorString(const binanceError_t err)
 	return str_binanceErrorUnknown.c_str();
 }
 
+const char* binance::binanceGetRequestClassString(const binanceRequestClass_t requestClass)
+{
+	switch (requestClass)
+	{
+	BINANCE_CASE_STR(binanceRequestOrder);
+	BINANCE_CASE_STR(binanceRequestAccount);
+	BINANCE_CASE_STR(binanceRequestMarketData);
+	BINANCE_CASE_STR(binanceRequestHistory);
+	default :
+		break;
+	}
+
+	static const string str_binanceRequestUnknown = "binanceRequestUnknown";
+	return str_binanceRequestUnknown.c_str();
+}
+
 std::string binance::toString(double val, int prec)
 {
 	std::ostringstream out;
@@ -6,10 +6,16 @@
 */
 
 #include "binance.h"
+#include "binance_latency.h"
 #include "binance_logger.h"
+#include "binance_metrics.h"
+#include "binance_retry.h"
+#include "binance_simulator.h"
 #include "binance_utils.h"
 
+#include <chrono>
 #include <fstream>
+#include <thread>
 #ifndef _WIN32
 #include <wordexp.h>
 #endif
@@ -73,6 +79,11 @@ bool binance::Account::keysAreSet() const
 	return ((api_key != "") && (secret_key != ""));
 }
 
+const Server& binance::Account::getServer() const
+{
+	return server;
+}
+
 // Get current account information. (SIGNED)
 //
 // GET /api/v3/account
@@ -86,7 +97,10 @@ binanceError_t binance::Account::getInfo(Json::Value &json_result, long recvWind
 {
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<get_account>");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<get_account>");
+
+	if (server.isSimulator())
+		return Simulator::get(server).getInfo(json_result);
 
 	if (api_key.size() == 0 || secret_key.size() == 0)
 		status = binanceErrorMissingAccountKeys;
@@ -115,12 +129,14 @@ binanceError_t binance::Account::getInfo(Json::Value &json_result, long recvWind
 		header_chunk.append(api_key);
 		extra_http_header.push_back(header_chunk);
 
-		Logger::write_log("<get_account> url = |%s|", url.c_str());
+		BINANCE_LOG_TRACE(binanceLogAccount, "<get_account> url = |%s|", url.c_str());
 	
 		string post_data = "";
 	
 		string str_result;
-		Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		status = Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		if (status != binanceSuccess)
+			return status;
 
 		if (str_result.size() == 0)
 			status = binanceErrorEmptyServerResponse;
@@ -132,23 +148,26 @@ binanceError_t binance::Account::getInfo(Json::Value &json_result, long recvWind
 				JSONCPP_STRING err;
 				Json::CharReaderBuilder builder;
 				const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+				LatencyScope parse_scope(Latency::Parse);
 				if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 								   &err)) {
-					Logger::write_log("<get_account> Error ! %s", err.c_str());
+					BINANCE_LOG_ERROR(binanceLogAccount, "<get_account> Error ! %s", err.c_str());
 					status = binanceErrorParsingServerResponse;
+					Metrics::countError(status);
 					return status;
 				}
 				CHECK_SERVER_ERR(json_result);
 			}
 			catch (exception &e)
 			{
-			 	Logger::write_log("<get_account> Error ! %s", e.what()); 
+			 	BINANCE_LOG_ERROR(binanceLogAccount, "<get_account> Error ! %s", e.what()); 
 				status = binanceErrorParsingServerResponse;
+				Metrics::countError(status);
 			}   
 		}
 	}
 
-	Logger::write_log("<get_account> Done.\n");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<get_account> Done.\n");
 	
 	return status;
 }
@@ -166,7 +185,7 @@ binanceError_t binance::Account::getBalance_f(Json::Value& json_result, long rec
 {
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<get_balance>");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<get_balance>");
 
 	if (api_key.size() == 0 || secret_key.size() == 0)
 		status = binanceErrorMissingAccountKeys;
@@ -195,12 +214,14 @@ binanceError_t binance::Account::getBalance_f(Json::Value& json_result, long rec
 		header_chunk.append(api_key);
 		extra_http_header.push_back(header_chunk);
 
-		Logger::write_log("<get_balance> url = |%s|", url.c_str());
+		BINANCE_LOG_TRACE(binanceLogAccount, "<get_balance> url = |%s|", url.c_str());
 
 		string post_data = "";
 
 		string str_result;
-		Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		status = Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		if (status != binanceSuccess)
+			return status;
 
 		if (str_result.size() == 0)
 			status = binanceErrorEmptyServerResponse;
@@ -212,23 +233,26 @@ binanceError_t binance::Account::getBalance_f(Json::Value& json_result, long rec
 				JSONCPP_STRING err;
 				Json::CharReaderBuilder builder;
 				const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+				LatencyScope parse_scope(Latency::Parse);
 				if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 								   &err)) {
-					Logger::write_log("<get_balance> Error ! %s", err.c_str());
+					BINANCE_LOG_ERROR(binanceLogAccount, "<get_balance> Error ! %s", err.c_str());
 					status = binanceErrorParsingServerResponse;
+					Metrics::countError(status);
 					return status;
 				}
 				CHECK_SERVER_ERR(json_result);
 			}
 			catch (exception& e)
 			{
-				Logger::write_log("<get_balance> Error ! %s", e.what());
+				BINANCE_LOG_ERROR(binanceLogAccount, "<get_balance> Error ! %s", e.what());
 				status = binanceErrorParsingServerResponse;
+				Metrics::countError(status);
 			}
 		}
 	}
 
-	Logger::write_log("<get_balance> Done.\n");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<get_balance> Done.\n");
 
 	return status;
 }
@@ -247,7 +271,7 @@ binanceError_t binance::Account::getTrades(Json::Value &json_result, const char
 {
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<get_trades>");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<get_trades>");
 
 	if (api_key.size() == 0 || secret_key.size() == 0)
 		status = binanceErrorMissingAccountKeys;
@@ -268,13 +292,15 @@ binanceError_t binance::Account::getTrades(Json::Value &json_result, const char
 		header_chunk.append(api_key);
 		extra_http_header.push_back(header_chunk);
 
-		Logger::write_log("<get_trades> url = |%s|", url.c_str());
+		BINANCE_LOG_TRACE(binanceLogAccount, "<get_trades> url = |%s|", url.c_str());
 
 		string action = "GET";
 		string post_data = "";
 
 		string str_result;
-		Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		status = Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		if (status != binanceSuccess)
+			return status;
 
 		if (str_result.size() == 0)
 			status = binanceErrorEmptyServerResponse;
@@ -286,22 +312,25 @@ binanceError_t binance::Account::getTrades(Json::Value &json_result, const char
 				JSONCPP_STRING err;
 				Json::CharReaderBuilder builder;
 				const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+				LatencyScope parse_scope(Latency::Parse);
 				if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 								   &err)) {
-					Logger::write_log("<get_trades> Error ! %s", err.c_str());
+					BINANCE_LOG_ERROR(binanceLogAccount, "<get_trades> Error ! %s", err.c_str());
 					status = binanceErrorParsingServerResponse;
+					Metrics::countError(status);
 					return status;
 				}
 				CHECK_SERVER_ERR(json_result);
 			}
 			catch (exception &e)
 			{
-			 	Logger::write_log("<get_trades> Error ! %s", e.what());
+			 	BINANCE_LOG_ERROR(binanceLogAccount, "<get_trades> Error ! %s", e.what());
 				status = binanceErrorParsingServerResponse;
+				Metrics::countError(status);
 			}
 		}
 
-		Logger::write_log("<get_trades> Done.");
+		BINANCE_LOG_DEBUG(binanceLogAccount, "<get_trades> Done.");
 	}
 
 	return status;
@@ -321,7 +350,7 @@ binanceError_t binance::Account::getTradesSigned(Json::Value &json_result, const
 {	
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<get_myTrades>");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<get_myTrades>");
 
 	if (api_key.size() == 0 || secret_key.size() == 0)
 		status = binanceErrorMissingAccountKeys;
@@ -361,13 +390,15 @@ binanceError_t binance::Account::getTradesSigned(Json::Value &json_result, const
 		header_chunk.append(api_key);
 		extra_http_header.push_back(header_chunk);
 
-		Logger::write_log("<get_myTrades> url = |%s|", url.c_str());
+		BINANCE_LOG_TRACE(binanceLogAccount, "<get_myTrades> url = |%s|", url.c_str());
 	
 		string action = "GET";
 		string post_data = "";
 
 		string str_result;
-		Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		status = Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		if (status != binanceSuccess)
+			return status;
 
 		if (str_result.size() == 0)
 			status = binanceErrorEmptyServerResponse;
@@ -379,22 +410,24 @@ binanceError_t binance::Account::getTradesSigned(Json::Value &json_result, const
 				JSONCPP_STRING err;
 				Json::CharReaderBuilder builder;
 				const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+				LatencyScope parse_scope(Latency::Parse);
 				if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 								   &err)) {
-					Logger::write_log("<get_myTrades> Error ! %s", err.c_str());
+					BINANCE_LOG_ERROR(binanceLogAccount, "<get_myTrades> Error ! %s", err.c_str());
 					status = binanceErrorParsingServerResponse;
+					Metrics::countError(status);
 					return status;
 				}
 				CHECK_SERVER_ERR(json_result);
 			}
 			catch (exception &e)
 			{
-			 	Logger::write_log("<get_myTrades> Error ! %s", e.what()); 
+			 	BINANCE_LOG_ERROR(binanceLogAccount, "<get_myTrades> Error ! %s", e.what()); 
 			}   
 		}
 	}
 
-	Logger::write_log("<get_myTrades> Done.\n");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<get_myTrades> Done.\n");
 
 	return status;
 }
@@ -412,7 +445,7 @@ binanceError_t binance::Account::getHistoricalTrades(Json::Value &json_result, c
 {
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<get_historicalTrades>");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<get_historicalTrades>");
 
 	if (api_key.size() == 0 || secret_key.size() == 0)
 		status = binanceErrorMissingAccountKeys;
@@ -439,13 +472,15 @@ binanceError_t binance::Account::getHistoricalTrades(Json::Value &json_result, c
 		header_chunk.append(api_key);
 		extra_http_header.push_back(header_chunk);
 
-		Logger::write_log("<get_historicalTrades> url = |%s|", url.c_str());
+		BINANCE_LOG_TRACE(binanceLogAccount, "<get_historicalTrades> url = |%s|", url.c_str());
 
 		string action = "GET";
 		string post_data = "";
 
 		string str_result;
-		Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		status = Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		if (status != binanceSuccess)
+			return status;
 
 		if (str_result.size() == 0)
 			status = binanceErrorEmptyServerResponse;
@@ -457,22 +492,25 @@ binanceError_t binance::Account::getHistoricalTrades(Json::Value &json_result, c
 				JSONCPP_STRING err;
 				Json::CharReaderBuilder builder;
 				const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+				LatencyScope parse_scope(Latency::Parse);
 				if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 								   &err)) {
-					Logger::write_log("<get_historicalTrades> Error ! %s", err.c_str());
+					BINANCE_LOG_ERROR(binanceLogAccount, "<get_historicalTrades> Error ! %s", err.c_str());
 					status = binanceErrorParsingServerResponse;
+					Metrics::countError(status);
 					return status;
 				}
 				CHECK_SERVER_ERR(json_result);
 			}
 			catch (exception &e)
 			{
-			 	Logger::write_log("<get_historicalTrades> Error ! %s", e.what());
+			 	BINANCE_LOG_ERROR(binanceLogAccount, "<get_historicalTrades> Error ! %s", e.what());
 				status = binanceErrorParsingServerResponse;
+				Metrics::countError(status);
 			}
 		}
 
-		Logger::write_log("<get_historicalTrades> Done.");
+		BINANCE_LOG_DEBUG(binanceLogAccount, "<get_historicalTrades> Done.");
 	}
 
 	return status;
@@ -491,7 +529,10 @@ binanceError_t binance::Account::getOpenOrders(Json::Value &json_result, long re
 {
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<get_openOrders>");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<get_openOrders>");
+
+	if (server.isSimulator())
+		return Simulator::get(server).getOpenOrders(json_result);
 
 	if (api_key.size() == 0 || secret_key.size() == 0)
 		status = binanceErrorMissingAccountKeys;
@@ -523,10 +564,12 @@ binanceError_t binance::Account::getOpenOrders(Json::Value &json_result, long re
 		string action = "GET";
 		string post_data ="";
 		
-		Logger::write_log("<get_openOrders> url = |%s|", url.c_str());
+		BINANCE_LOG_TRACE(binanceLogAccount, "<get_openOrders> url = |%s|", url.c_str());
 	
 		string str_result;
-		Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		status = Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		if (status != binanceSuccess)
+			return status;
 
 		if (str_result.size() == 0)
 			status = binanceErrorEmptyServerResponse;
@@ -538,22 +581,24 @@ binanceError_t binance::Account::getOpenOrders(Json::Value &json_result, long re
 				JSONCPP_STRING err;
 				Json::CharReaderBuilder builder;
 				const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+				LatencyScope parse_scope(Latency::Parse);
 				if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 								   &err)) {
-					Logger::write_log("<get_openOrders> Error ! %s", err.c_str());
+					BINANCE_LOG_ERROR(binanceLogAccount, "<get_openOrders> Error ! %s", err.c_str());
 					status = binanceErrorParsingServerResponse;
+					Metrics::countError(status);
 					return status;
 				}
 				CHECK_SERVER_ERR(json_result);
 			}
 			catch (exception &e)
 			{
-			 	Logger::write_log("<get_openOrders> Error ! %s", e.what()); 
+			 	BINANCE_LOG_ERROR(binanceLogAccount, "<get_openOrders> Error ! %s", e.what()); 
 			}   
 		}
 	}
 	
-	Logger::write_log("<get_openOrders> Done.\n");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<get_openOrders> Done.\n");
 
 	return status;
 }
@@ -571,7 +616,10 @@ binanceError_t binance::Account::getOpenOrders(Json::Value &json_result, const c
 {
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<get_openOrders>");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<get_openOrders>");
+
+	if (server.isSimulator())
+		return Simulator::get(server).getOpenOrders(json_result, symbol);
 
 	if (api_key.size() == 0 || secret_key.size() == 0)
 		status = binanceErrorMissingAccountKeys;
@@ -605,10 +653,12 @@ binanceError_t binance::Account::getOpenOrders(Json::Value &json_result, const c
 		string action = "GET";
 		string post_data ="";
 		
-		Logger::write_log("<get_openOrders> url = |%s|", url.c_str());
+		BINANCE_LOG_TRACE(binanceLogAccount, "<get_openOrders> url = |%s|", url.c_str());
 	
 		string str_result;
-		Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		status = Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		if (status != binanceSuccess)
+			return status;
 
 		if (str_result.size() == 0)
 			status = binanceErrorEmptyServerResponse;
@@ -620,22 +670,24 @@ binanceError_t binance::Account::getOpenOrders(Json::Value &json_result, const c
 				JSONCPP_STRING err;
 				Json::CharReaderBuilder builder;
 				const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+				LatencyScope parse_scope(Latency::Parse);
 				if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 								   &err)) {
-					Logger::write_log("<get_openOrders> Error ! %s", err.c_str());
+					BINANCE_LOG_ERROR(binanceLogAccount, "<get_openOrders> Error ! %s", err.c_str());
 					status = binanceErrorParsingServerResponse;
+					Metrics::countError(status);
 					return status;
 				}
 				CHECK_SERVER_ERR(json_result);
 			}
 			catch (exception &e)
 			{
-			 	Logger::write_log("<get_openOrders> Error ! %s", e.what()); 
+			 	BINANCE_LOG_ERROR(binanceLogAccount, "<get_openOrders> Error ! %s", e.what()); 
 			}   
 		}
 	}
 	
-	Logger::write_log("<get_openOrders> Done.\n");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<get_openOrders> Done.\n");
 
 	return status;
 }
@@ -656,7 +708,10 @@ binanceError_t binance::Account::getAllOrders(Json::Value &json_result, const ch
 {
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<get_allOrders>");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<get_allOrders>");
+
+	if (server.isSimulator())
+		return Simulator::get(server).getAllOrders(json_result, symbol, orderId, limit);
 
 	if (api_key.size() == 0 || secret_key.size() == 0)
 		status = binanceErrorMissingAccountKeys;
@@ -702,10 +757,12 @@ binanceError_t binance::Account::getAllOrders(Json::Value &json_result, const ch
 		string action = "GET";
 		string post_data ="";
 		
-		Logger::write_log("<get_allOrders> url = |%s|", url.c_str());
+		BINANCE_LOG_TRACE(binanceLogAccount, "<get_allOrders> url = |%s|", url.c_str());
 	
 		string str_result;
-		Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		status = Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		if (status != binanceSuccess)
+			return status;
 
 		if (str_result.size() == 0)
 			status = binanceErrorEmptyServerResponse;
@@ -717,22 +774,24 @@ binanceError_t binance::Account::getAllOrders(Json::Value &json_result, const ch
 				JSONCPP_STRING err;
 				Json::CharReaderBuilder builder;
 				const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+				LatencyScope parse_scope(Latency::Parse);
 				if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 								   &err)) {
-					Logger::write_log("<get_allOrders> Error ! %s", err.c_str());
+					BINANCE_LOG_ERROR(binanceLogAccount, "<get_allOrders> Error ! %s", err.c_str());
 					status = binanceErrorParsingServerResponse;
+					Metrics::countError(status);
 					return status;
 				}
 				CHECK_SERVER_ERR(json_result);
 			}
 			catch (exception &e)
 			{
-			 	Logger::write_log("<get_allOrders> Error ! %s", e.what()); 
+			 	BINANCE_LOG_ERROR(binanceLogAccount, "<get_allOrders> Error ! %s", e.what()); 
 			}   
 		}
 	}
 	
-	Logger::write_log("<get_allOrders> Done.\n");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<get_allOrders> Done.\n");
 
 	return status;
 }
@@ -762,12 +821,18 @@ binanceError_t binance::Account::sendOrder(Json::Value &json_result, const char
 {	
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<send_order>");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<send_order>");
+
+	if (server.isSimulator())
+		return Simulator::get(server).sendOrder(json_result, symbol, side, type, timeInForce,
+			quantity, price, newClientOrderId, stopPrice);
 
 	if (api_key.size() == 0 || secret_key.size() == 0)
 		status = binanceErrorMissingAccountKeys;
 	else
 	{
+		const Latency::Ticks build_begin = Latency::now();
+
 		string url(hostname);
 		url += "/api/v3/order?";
 
@@ -797,11 +862,13 @@ binanceError_t binance::Account::sendOrder(Json::Value &json_result, const char
 			post_data.append(toString(price));
 		}
 
-		if (strlen(newClientOrderId) > 0)
-		{
-			post_data.append("&newClientOrderId=");
-			post_data.append(newClientOrderId);
-		}
+		// The id recognizes the order, should an attempt fail with an unknown outcome.
+		string clientOrderId(newClientOrderId);
+		if (clientOrderId.empty())
+			clientOrderId = RetryPolicy::makeClientOrderId();
+
+		post_data.append("&newClientOrderId=");
+		post_data.append(clientOrderId);
 
 		if (stopPrice > 0.0)
 		{
@@ -826,24 +893,84 @@ binanceError_t binance::Account::sendOrder(Json::Value &json_result, const char
 			post_data.append(to_string(recvWindow));
 		}
 
-		post_data.append("&timestamp=");
-		post_data.append(to_string(get_current_ms_epoch()));
-
-		string signature =  hmac_sha256(secret_key.c_str(), post_data.c_str());
-		post_data.append("&signature=");
-		post_data.append(signature);
-
 		vector <string> extra_http_header;
 		string header_chunk("X-MBX-APIKEY: ");
 		header_chunk.append(api_key);
 		extra_http_header.push_back(header_chunk);
 
-		Logger::write_log("<send_order> url = |%s|, post_data = |%s|", url.c_str(), post_data.c_str());
-	
 		string str_result;
-		Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		bool placed = false;
+		for (int attempt = 0; ; attempt++)
+		{
+			// Signed for each attempt, so that the timestamp stays within recvWindow.
+			const unsigned long timestamp = get_current_ms_epoch();
+			string signed_data(post_data);
+			signed_data.append("&timestamp=");
+			signed_data.append(to_string(timestamp));
+
+			string signature =  hmac_sha256(secret_key.c_str(), signed_data.c_str());
+			signed_data.append("&signature=");
+			signed_data.append(signature);
+
+			if (attempt == 0)
+				Latency::record(Latency::RequestBuild, build_begin);
+
+			BINANCE_LOG_TRACE(binanceLogAccount, "<send_order> url = |%s|, post_data = |%s|", url.c_str(), signed_data.c_str());
+
+			status = Server::getCurlWithHeader(str_result, url, extra_http_header, signed_data, action);
+
+			const binanceErrorInfo_t error = binanceGetLastError();
+			unsigned int delayMs = 0;
+			if (!RetryPolicy::shouldRetry(RetryPolicy::Order, attempt, error, delayMs))
+				break;
+
+			// An order rejected by the rate limits is not placed. After other
+			// failures it may be, execution status unknown, possibly not even
+			// visible yet. It is only known not to be placed once the exchange
+			// cannot accept the request any more: recvWindow (5 s by default)
+			// after its timestamp, plus the 1 s the timestamp may be ahead of
+			// the exchange clock.
+			const bool limited = (error.httpStatus == 429) || (error.httpStatus == 418);
+			if (!limited)
+			{
+				const unsigned long expiry = timestamp + ((recvWindow > 0) ? recvWindow : 5000) + 1000;
+				const unsigned long now = get_current_ms_epoch();
+				if (expiry > now)
+					delayMs = max(delayMs, (unsigned int)(expiry - now));
+			}
 
-		if (str_result.size() == 0)
+			BINANCE_LOG_INFO(binanceLogAccount, "<send_order> %s: %s, %s in %u ms", clientOrderId.c_str(),
+				error.httpStatus ? to_string(error.httpStatus).c_str() : binanceGetErrorString(error.status),
+				limited ? "retrying" : "looking up the order", delayMs);
+
+			this_thread::sleep_for(chrono::milliseconds(delayMs));
+
+			if (limited)
+				continue;
+
+			Json::Value order;
+			const binanceError_t lookup = getOrder(order, symbol, 0, clientOrderId.c_str(), recvWindow);
+			if (lookup == binanceSuccess)
+			{
+				BINANCE_LOG_INFO(binanceLogAccount, "<send_order> %s was placed by the failed attempt", clientOrderId.c_str());
+				json_result = order;
+				placed = true;
+				break;
+			}
+
+			// -2013 is "Order does not exist.", conclusive as the request has expired.
+			if ((lookup != binanceErrorServer) || (binanceGetLastError().code != -2013))
+			{
+				BINANCE_LOG_ERROR(binanceLogAccount, "<send_order> Error ! %s: cannot tell if the order is placed", clientOrderId.c_str());
+				break;
+			}
+		}
+
+		if (placed)
+			status = binanceSuccess;
+		else if (status != binanceSuccess)
+			return status;
+		else if (str_result.size() == 0)
 			status = binanceErrorEmptyServerResponse;
 		else
 		{
@@ -853,22 +980,24 @@ binanceError_t binance::Account::sendOrder(Json::Value &json_result, const char
 				JSONCPP_STRING err;
 				Json::CharReaderBuilder builder;
 				const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+				LatencyScope parse_scope(Latency::Parse);
 				if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 								   &err)) {
-					Logger::write_log("<send_order> Error ! %s", err.c_str());
+					BINANCE_LOG_ERROR(binanceLogAccount, "<send_order> Error ! %s", err.c_str());
 					status = binanceErrorParsingServerResponse;
+					Metrics::countError(status);
 					return status;
 				}
 				CHECK_SERVER_ERR(json_result);
 			}
 			catch (exception &e)
 			{
-			 	Logger::write_log("<send_order> Error ! %s", e.what()); 
+			 	BINANCE_LOG_ERROR(binanceLogAccount, "<send_order> Error ! %s", e.what()); 
 			}   
 		}
 	}
 	
-	Logger::write_log("<send_order> Done.\n");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<send_order> Done.\n");
 
 	return status;
 }
@@ -896,7 +1025,7 @@ binanceError_t binance::Account::sendTestOrder(Json::Value &json_result, const c
 {	
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<send_order>");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<send_order>");
 
 	if (api_key.size() == 0 || secret_key.size() == 0)
 		status = binanceErrorMissingAccountKeys;
@@ -967,10 +1096,12 @@ binanceError_t binance::Account::sendTestOrder(Json::Value &json_result, const c
 		header_chunk.append(api_key);
 		extra_http_header.push_back(header_chunk);
 
-		Logger::write_log("<send_order> url = |%s|, post_data = |%s|", url.c_str(), post_data.c_str());
+		BINANCE_LOG_TRACE(binanceLogAccount, "<send_order> url = |%s|, post_data = |%s|", url.c_str(), post_data.c_str());
 	
 		string str_result;
-		Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		status = Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		if (status != binanceSuccess)
+			return status;
 
 		if (str_result.size() == 0)
 			status = binanceErrorEmptyServerResponse;
@@ -982,22 +1113,24 @@ binanceError_t binance::Account::sendTestOrder(Json::Value &json_result, const c
 				JSONCPP_STRING err;
 				Json::CharReaderBuilder builder;
 				const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+				LatencyScope parse_scope(Latency::Parse);
 				if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 								   &err)) {
-					Logger::write_log("<send_order> Error ! %s", err.c_str());
+					BINANCE_LOG_ERROR(binanceLogAccount, "<send_order> Error ! %s", err.c_str());
 					status = binanceErrorParsingServerResponse;
+					Metrics::countError(status);
 					return status;
 				}
 				CHECK_SERVER_ERR(json_result);
 			}
 			catch (exception &e)
 			{
-			 	Logger::write_log("<send_order> Error ! %s", e.what()); 
+			 	BINANCE_LOG_ERROR(binanceLogAccount, "<send_order> Error ! %s", e.what()); 
 			}   
 		}
 	}
 	
-	Logger::write_log("<send_order> Done.\n");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<send_order> Done.\n");
 
 	return status;
 }
@@ -1018,7 +1151,10 @@ binanceError_t binance::Account::getOrder(Json::Value &json_result, const char *
 {	
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<get_order>");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<get_order>");
+
+	if (server.isSimulator())
+		return Simulator::get(server).getOrder(json_result, symbol, orderId, origClientOrderId);
 
 	if (api_key.size() == 0 || secret_key.size() == 0)
 		status = binanceErrorMissingAccountKeys;
@@ -1065,10 +1201,12 @@ binanceError_t binance::Account::getOrder(Json::Value &json_result, const char *
 
 		string post_data = "";
 	
-		Logger::write_log("<get_order> url = |%s|", url.c_str());
+		BINANCE_LOG_TRACE(binanceLogAccount, "<get_order> url = |%s|", url.c_str());
 	
 		string str_result;
-		Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		status = Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		if (status != binanceSuccess)
+			return status;
 
 		if (str_result.size() == 0)
 			status = binanceErrorEmptyServerResponse;
@@ -1080,22 +1218,24 @@ binanceError_t binance::Account::getOrder(Json::Value &json_result, const char *
 				JSONCPP_STRING err;
 				Json::CharReaderBuilder builder;
 				const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+				LatencyScope parse_scope(Latency::Parse);
 				if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 								   &err)) {
-					Logger::write_log("<get_order> Error ! %s", err.c_str());
+					BINANCE_LOG_ERROR(binanceLogAccount, "<get_order> Error ! %s", err.c_str());
 					status = binanceErrorParsingServerResponse;
+					Metrics::countError(status);
 					return status;
 				}
 				CHECK_SERVER_ERR(json_result);
 			}
 			catch (exception &e)
 			{
-			 	Logger::write_log("<get_order> Error ! %s", e.what()); 
+			 	BINANCE_LOG_ERROR(binanceLogAccount, "<get_order> Error ! %s", e.what()); 
 			}   
 		}
 	}
 	
-	Logger::write_log("<get_order> Done.\n");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<get_order> Done.\n");
 
 	return status;
 }
@@ -1116,12 +1256,17 @@ binanceError_t binance::Account::cancelOrder(Json::Value &json_result, const cha
 {
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<send_order>");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<send_order>");
+
+	if (server.isSimulator())
+		return Simulator::get(server).cancelOrder(json_result, symbol, orderId, origClientOrderId, newClientOrderId);
 
 	if (api_key.size() == 0 || secret_key.size() == 0)
 		status = binanceErrorMissingAccountKeys;
 	else
 	{
+		const Latency::Ticks build_begin = Latency::now();
+
 		string url(hostname);
 		url += "/api/v3/order?";
 
@@ -1166,10 +1311,14 @@ binanceError_t binance::Account::cancelOrder(Json::Value &json_result, const cha
 		header_chunk.append(api_key);
 		extra_http_header.push_back(header_chunk);
 
-		Logger::write_log("<send_order> url = |%s|, post_data = |%s|", url.c_str(), post_data.c_str());
+		Latency::record(Latency::RequestBuild, build_begin);
+
+		BINANCE_LOG_TRACE(binanceLogAccount, "<send_order> url = |%s|, post_data = |%s|", url.c_str(), post_data.c_str());
 	
 		string str_result;
-		Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		status = Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		if (status != binanceSuccess)
+			return status;
 
 		if (str_result.size() == 0)
 			status = binanceErrorEmptyServerResponse;
@@ -1181,22 +1330,24 @@ binanceError_t binance::Account::cancelOrder(Json::Value &json_result, const cha
 				JSONCPP_STRING err;
 				Json::CharReaderBuilder builder;
 				const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+				LatencyScope parse_scope(Latency::Parse);
 				if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 								   &err)) {
-					Logger::write_log("<send_order> Error ! %s", err.c_str());
+					BINANCE_LOG_ERROR(binanceLogAccount, "<send_order> Error ! %s", err.c_str());
 					status = binanceErrorParsingServerResponse;
+					Metrics::countError(status);
 					return status;
 				}
 				CHECK_SERVER_ERR(json_result);
 			}
 			catch (exception &e)
 			{
-			 	Logger::write_log("<send_order> Error ! %s", e.what()); 
+			 	BINANCE_LOG_ERROR(binanceLogAccount, "<send_order> Error ! %s", e.what()); 
 			}   
 		}
 	}
 	
-	Logger::write_log("<send_order> Done.\n");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<send_order> Done.\n");
 
 	return status;
 }
@@ -1206,7 +1357,7 @@ binanceError_t binance::Account::startUserDataStream(Json::Value &json_result)
 {	
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<start_userDataStream>");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<start_userDataStream>");
 
 	if (api_key.size() == 0)
 		status = binanceErrorMissingAccountKeys;
@@ -1221,13 +1372,15 @@ binanceError_t binance::Account::startUserDataStream(Json::Value &json_result)
 		header_chunk.append(api_key);
 		extra_http_header.push_back(header_chunk);
 
-		Logger::write_log("<start_userDataStream> url = |%s|", url.c_str());
+		BINANCE_LOG_TRACE(binanceLogAccount, "<start_userDataStream> url = |%s|", url.c_str());
 	
 		string action = "POST";
 		string post_data = "";
 
 		string str_result;
-		Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		status = Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		if (status != binanceSuccess)
+			return status;
 
 		if (str_result.size() == 0)
 			status = binanceErrorEmptyServerResponse;
@@ -1239,22 +1392,24 @@ binanceError_t binance::Account::startUserDataStream(Json::Value &json_result)
 				JSONCPP_STRING err;
 				Json::CharReaderBuilder builder;
 				const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+				LatencyScope parse_scope(Latency::Parse);
 				if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 								   &err)) {
-					Logger::write_log("<start_userDataStream> Error ! %s", err.c_str());
+					BINANCE_LOG_ERROR(binanceLogAccount, "<start_userDataStream> Error ! %s", err.c_str());
 					status = binanceErrorParsingServerResponse;
+					Metrics::countError(status);
 					return status;
 				}
 				CHECK_SERVER_ERR(json_result);
 			}
 			catch (exception &e)
 			{
-			 	Logger::write_log("<start_userDataStream> Error ! %s", e.what()); 
+			 	BINANCE_LOG_ERROR(binanceLogAccount, "<start_userDataStream> Error ! %s", e.what()); 
 			}   
 		}
 	}
 
-	Logger::write_log("<start_userDataStream> Done.\n");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<start_userDataStream> Done.\n");
 
 	return status;
 }
@@ -1264,7 +1419,7 @@ binanceError_t binance::Account::keepUserDataStream(const char *listenKey)
 {	
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<keep_userDataStream>");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<keep_userDataStream>");
 
 	if (api_key.size() == 0)
 		status = binanceErrorMissingAccountKeys;
@@ -1284,16 +1439,39 @@ binanceError_t binance::Account::keepUserDataStream(const char *listenKey)
 		string post_data("listenKey=");
 		post_data.append(listenKey);
 
-		Logger::write_log("<keep_userDataStream> url = |%s|, post_data = |%s|", url.c_str(), post_data.c_str());
-	
+		BINANCE_LOG_TRACE(binanceLogAccount, "<keep_userDataStream> url = |%s|, post_data = |%s|", url.c_str(), post_data.c_str());
+
 		string str_result;
-		Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		status = Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		if (status != binanceSuccess)
+			return status;
 
 		if (str_result.size() == 0)
 			status = binanceErrorEmptyServerResponse;
+		else
+		{
+			// An expired listenKey is reported as {"code":-1125,"msg":...};
+			// let the caller re-create the stream instead of failing hard.
+			Json::Value json_result;
+			JSONCPP_STRING err;
+			Json::CharReaderBuilder builder;
+			const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+			LatencyScope parse_scope(Latency::Parse);
+			if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
+							   &err)) {
+				BINANCE_LOG_ERROR(binanceLogAccount, "<keep_userDataStream> Error ! %s", err.c_str());
+				status = binanceErrorParsingServerResponse;
+				Metrics::countError(status);
+			}
+			else if (json_result.isObject() && json_result.isMember("code"))
+			{
+				BINANCE_LOG_ERROR(binanceLogAccount, "<keep_userDataStream> Error ! %s", json_result["msg"].asString().c_str());
+				status = binanceErrorInvalidServerResponse;
+			}
+		}
 	}
 
-	Logger::write_log("<keep_userDataStream> Done.\n");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<keep_userDataStream> Done.\n");
 
 	return status;
 }
@@ -1303,7 +1481,7 @@ binanceError_t binance::Account::closeUserDataStream(const char *listenKey)
 {	
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<close_userDataStream>");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<close_userDataStream>");
 
 	if (api_key.size() == 0)
 		status = binanceErrorMissingAccountKeys;
@@ -1322,16 +1500,18 @@ binanceError_t binance::Account::closeUserDataStream(const char *listenKey)
 		string post_data("listenKey=");
 		post_data.append(listenKey);
 
-		Logger::write_log("<close_userDataStream> url = |%s|, post_data = |%s|", url.c_str(), post_data.c_str());
+		BINANCE_LOG_TRACE(binanceLogAccount, "<close_userDataStream> url = |%s|, post_data = |%s|", url.c_str(), post_data.c_str());
 	
 		string str_result;
-		Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		status = Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		if (status != binanceSuccess)
+			return status;
 
 		if (str_result.size() == 0)
 			status = binanceErrorEmptyServerResponse;
 	}
 
-	Logger::write_log("<close_userDataStream> Done.\n");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<close_userDataStream> Done.\n");
 
 	return status;
 }
@@ -1356,7 +1536,7 @@ binanceError_t binance::Account::withdraw(Json::Value &json_result,
 {	
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<withdraw>");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<withdraw>");
 
 	if (api_key.size() == 0 || secret_key.size() == 0)
 		status = binanceErrorMissingAccountKeys;
@@ -1412,10 +1592,12 @@ binanceError_t binance::Account::withdraw(Json::Value &json_result,
 		header_chunk.append(api_key);
 		extra_http_header.push_back(header_chunk);
 
-		Logger::write_log("<withdraw> url = |%s|, post_data = |%s|", url.c_str(), post_data.c_str());
+		BINANCE_LOG_TRACE(binanceLogAccount, "<withdraw> url = |%s|, post_data = |%s|", url.c_str(), post_data.c_str());
 	
 		string str_result;
-		Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		status = Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		if (status != binanceSuccess)
+			return status;
 
 		if (str_result.size() == 0)
 			status = binanceErrorEmptyServerResponse;
@@ -1427,22 +1609,24 @@ binanceError_t binance::Account::withdraw(Json::Value &json_result,
 				JSONCPP_STRING err;
 				Json::CharReaderBuilder builder;
 				const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+				LatencyScope parse_scope(Latency::Parse);
 				if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 								   &err)) {
-					Logger::write_log("<withdraw> Error ! %s", err.c_str());
+					BINANCE_LOG_ERROR(binanceLogAccount, "<withdraw> Error ! %s", err.c_str());
 					status = binanceErrorParsingServerResponse;
+					Metrics::countError(status);
 					return status;
 				}
 				CHECK_SERVER_ERR(json_result);
 			}
 			catch (exception &e)
 			{
-			 	Logger::write_log("<withdraw> Error ! %s", e.what()); 
+			 	BINANCE_LOG_ERROR(binanceLogAccount, "<withdraw> Error ! %s", e.what()); 
 			}   
 		}
 	}
 	
-	Logger::write_log("<withdraw> Done.\n");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<withdraw> Done.\n");
 
 	return status;
 }
@@ -1464,7 +1648,7 @@ binanceError_t binance::Account::getDepositHistory(Json::Value &json_result,
 {	
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<get_depostHistory>");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<get_depostHistory>");
 
 	if (api_key.size() == 0 || secret_key.size() == 0)
 		status = binanceErrorMissingAccountKeys;
@@ -1522,10 +1706,12 @@ binanceError_t binance::Account::getDepositHistory(Json::Value &json_result,
 
 		string post_data = "";
 	
-		Logger::write_log("<get_depostHistory> url = |%s|", url.c_str());
+		BINANCE_LOG_TRACE(binanceLogAccount, "<get_depostHistory> url = |%s|", url.c_str());
 	
 		string str_result;
-		Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		status = Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		if (status != binanceSuccess)
+			return status;
 
 		if (str_result.size() == 0)
 			status = binanceErrorEmptyServerResponse;
@@ -1537,22 +1723,24 @@ binanceError_t binance::Account::getDepositHistory(Json::Value &json_result,
 				JSONCPP_STRING err;
 				Json::CharReaderBuilder builder;
 				const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+				LatencyScope parse_scope(Latency::Parse);
 				if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 								   &err)) {
-					Logger::write_log("<get_depostHistory> Error ! %s", err.c_str());
+					BINANCE_LOG_ERROR(binanceLogAccount, "<get_depostHistory> Error ! %s", err.c_str());
 					status = binanceErrorParsingServerResponse;
+					Metrics::countError(status);
 					return status;
 				}
 				CHECK_SERVER_ERR(json_result);
 			}
 			catch (exception &e)
 			{
-			 	Logger::write_log("<get_depostHistory> Error ! %s", e.what()); 
+			 	BINANCE_LOG_ERROR(binanceLogAccount, "<get_depostHistory> Error ! %s", e.what()); 
 			}   
 		}
 	}
 	
-	Logger::write_log("<get_depostHistory> Done.\n");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<get_depostHistory> Done.\n");
 
 	return status;
 }
@@ -1574,7 +1762,7 @@ binanceError_t binance::Account::getWithdrawHistory(Json::Value &json_result,
 {
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<get_withdrawHistory>");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<get_withdrawHistory>");
 
 	if (api_key.size() == 0 || secret_key.size() == 0)
 		status = binanceErrorMissingAccountKeys;
@@ -1632,10 +1820,12 @@ binanceError_t binance::Account::getWithdrawHistory(Json::Value &json_result,
 
 		string post_data = "";
 	
-		Logger::write_log("<get_withdrawHistory> url = |%s|", url.c_str());
+		BINANCE_LOG_TRACE(binanceLogAccount, "<get_withdrawHistory> url = |%s|", url.c_str());
 	
 		string str_result;
-		Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		status = Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		if (status != binanceSuccess)
+			return status;
 
 		if (str_result.size() == 0)
 			status = binanceErrorEmptyServerResponse;
@@ -1647,22 +1837,24 @@ binanceError_t binance::Account::getWithdrawHistory(Json::Value &json_result,
 				JSONCPP_STRING err;
 				Json::CharReaderBuilder builder;
 				const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+				LatencyScope parse_scope(Latency::Parse);
 				if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 								   &err)) {
-					Logger::write_log("<get_withdrawHistory> Error ! %s", err.c_str());
+					BINANCE_LOG_ERROR(binanceLogAccount, "<get_withdrawHistory> Error ! %s", err.c_str());
 					status = binanceErrorParsingServerResponse;
+					Metrics::countError(status);
 					return status;
 				}
 				CHECK_SERVER_ERR(json_result);
 			}
 			catch (exception &e)
 			{
-			 	Logger::write_log("<get_withdrawHistory> Error ! %s", e.what()); 
+			 	BINANCE_LOG_ERROR(binanceLogAccount, "<get_withdrawHistory> Error ! %s", e.what()); 
 			}   
 		}
 	}
 	
-	Logger::write_log("<get_withdrawHistory> Done.\n");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<get_withdrawHistory> Done.\n");
 
 	return status;
 }
@@ -1680,7 +1872,7 @@ binanceError_t binance::Account::getDepositAddress(Json::Value &json_result, con
 {	
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<get_depositAddress>");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<get_depositAddress>");
 
 	if (api_key.size() == 0 || secret_key.size() == 0)
 		status = binanceErrorMissingAccountKeys;
@@ -1715,10 +1907,12 @@ binanceError_t binance::Account::getDepositAddress(Json::Value &json_result, con
 
 		string post_data = "";
 	
-		Logger::write_log("<get_depositAddress> url = |%s|", url.c_str());
+		BINANCE_LOG_TRACE(binanceLogAccount, "<get_depositAddress> url = |%s|", url.c_str());
 	
 		string str_result;
-		Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		status = Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		if (status != binanceSuccess)
+			return status;
 
 		if (str_result.size() == 0)
 			status = binanceErrorEmptyServerResponse;
@@ -1730,22 +1924,24 @@ binanceError_t binance::Account::getDepositAddress(Json::Value &json_result, con
 				JSONCPP_STRING err;
 				Json::CharReaderBuilder builder;
 				const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+				LatencyScope parse_scope(Latency::Parse);
 				if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 								   &err)) {
-					Logger::write_log("<get_depositAddress> Error ! %s", err.c_str());
+					BINANCE_LOG_ERROR(binanceLogAccount, "<get_depositAddress> Error ! %s", err.c_str());
 					status = binanceErrorParsingServerResponse;
+					Metrics::countError(status);
 					return status;
 				}
 				CHECK_SERVER_ERR(json_result);
 			}
 			catch (exception &e)
 			{
-			 	Logger::write_log("<get_depositAddress> Error ! %s", e.what()); 
+			 	BINANCE_LOG_ERROR(binanceLogAccount, "<get_depositAddress> Error ! %s", e.what()); 
 			}   
 		}
 	}
 	
-	Logger::write_log("<get_depositAddress> Done.\n");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<get_depositAddress> Done.\n");
 
 	return status;
 }
@@ -1754,7 +1950,7 @@ binanceError_t binance::Account::getWalletData(Json::Value &json_result, long re
 {
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<get_walletData>");
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<get_walletData>");
 
 	if (api_key.size() == 0 || secret_key.size() == 0)
 		status = binanceErrorMissingAccountKeys;
@@ -1786,10 +1982,12 @@ binanceError_t binance::Account::getWalletData(Json::Value &json_result, long re
 
 		string post_data = "";
 
-		Logger::write_log("<get_walletData> url = |%s|", url.c_str());
+		BINANCE_LOG_TRACE(binanceLogAccount, "<get_walletData> url = |%s|", url.c_str());
 
 		string str_result;
-		Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		status = Server::getCurlWithHeader(str_result, url, extra_http_header, post_data, action);
+		if (status != binanceSuccess)
+			return status;
 
 		if (str_result.size() == 0)
 			status = binanceErrorEmptyServerResponse;
@@ -1801,17 +1999,19 @@ binanceError_t binance::Account::getWalletData(Json::Value &json_result, long re
 				JSONCPP_STRING err;
 				Json::CharReaderBuilder builder;
 				const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+				LatencyScope parse_scope(Latency::Parse);
 				if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 								   &err)) {
-					Logger::write_log("<get_walletData> Error ! %s", err.c_str());
+					BINANCE_LOG_ERROR(binanceLogAccount, "<get_walletData> Error ! %s", err.c_str());
 					status = binanceErrorParsingServerResponse;
+					Metrics::countError(status);
 					return status;
 				}
 				CHECK_SERVER_ERR(json_result);
 			}
 			catch (exception &e)
 			{
-				Logger::write_log("<get_walletData> Error ! %s", e.what());
+				BINANCE_LOG_ERROR(binanceLogAccount, "<get_walletData> Error ! %s", e.what());
 			}
 		}
 	}
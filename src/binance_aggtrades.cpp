@@ -0,0 +1,392 @@
+/*
+	C++ library for Binance API.
+*/
+
+#include "binance_aggtrades.h"
+#include "binance_logger.h"
+#include "binance_utils.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace binance;
+using namespace std;
+
+// Maximum page size of GET /api/v3/aggTrades.
+static const int pageSize = 1000;
+
+binance::AggTradeCrawler::AggTradeCrawler(const Server& server_, const string& root_, int threads_, int checkpointPages_) :
+
+server(server_), root(root_), threads(max(threads_, 1)), checkpointPages(max(checkpointPages_, 1)), stopped(false)
+
+{ }
+
+void binance::AggTradeCrawler::stop()
+{
+	stopped = true;
+}
+
+void binance::AggTradeCrawler::pack(const AggTrade& trade, char* record)
+{
+	memcpy(record, &trade.id, 8);
+	memcpy(record + 8, &trade.price, 8);
+	memcpy(record + 16, &trade.qty, 8);
+	memcpy(record + 24, &trade.time, 8);
+	record[32] = trade.isBuyerMaker ? 1 : 0;
+}
+
+void binance::AggTradeCrawler::unpack(const char* record, AggTrade& trade)
+{
+	memcpy(&trade.id, record, 8);
+	memcpy(&trade.price, record + 8, 8);
+	memcpy(&trade.qty, record + 16, 8);
+	memcpy(&trade.time, record + 24, 8);
+	trade.isBuyerMaker = (record[32] != 0);
+}
+
+// [
+//   {
+//     "a": 26129,         // Aggregate tradeId
+//     "p": "0.01633102",  // Price
+//     "q": "4.70443515",  // Quantity
+//     "f": 27781,         // First tradeId
+//     "l": 27781,         // Last tradeId
+//     "T": 1498793709153, // Timestamp
+//     "m": true,          // Was the buyer the maker?
+//     "M": true           // Was the trade the best price match?
+//   }
+// ]
+bool binance::AggTradeCrawler::parse(const char* data, size_t size, vector<AggTrade>& trades)
+{
+	trades.clear();
+
+	const char* p = data;
+	const char* end = data + size;
+	auto skip = [&]()
+	{
+		while ((p < end) && ((*p == ' ') || (*p == '\t') || (*p == '\r') || (*p == '\n')))
+			p++;
+	};
+
+	skip();
+	if ((p == end) || (*p++ != '['))
+		return false;
+
+	while (1)
+	{
+		skip();
+		if (p == end)
+			return false;
+		if (*p == ']')
+			return true;
+		if (*p == ',')
+		{
+			p++;
+			continue;
+		}
+		if (*p++ != '{')
+			return false;
+
+		AggTrade trade;
+		memset(&trade, 0, sizeof(trade));
+		while (1)
+		{
+			skip();
+			if (p == end)
+				return false;
+			if (*p == '}')
+			{
+				p++;
+				break;
+			}
+			if (*p == ',')
+			{
+				p++;
+				continue;
+			}
+
+			// Key.
+			if (*p++ != '"')
+				return false;
+			const char* key = p;
+			while ((p < end) && (*p != '"'))
+				p++;
+			if (p == end)
+				return false;
+			const size_t keylen = p++ - key;
+			skip();
+			if ((p == end) || (*p++ != ':'))
+				return false;
+			skip();
+
+			// Value, either a quoted decimal or a bare number / boolean.
+			if (p == end)
+				return false;
+			const bool quoted = (*p == '"');
+			if (quoted)
+				p++;
+			const char* value = p;
+			if (quoted)
+				while ((p < end) && (*p != '"'))
+					p++;
+			else
+				while ((p < end) && (*p != ',') && (*p != '}') && (*p != ' ') && (*p != '\n'))
+					p++;
+			if (p == end)
+				return false;
+			if (quoted)
+				p++;
+
+			if (keylen != 1)
+				continue;
+
+			switch (*key)
+			{
+			case 'a' : trade.id = strtoll(value, NULL, 10); break;
+			case 'p' : trade.price = strtod(value, NULL); break;
+			case 'q' : trade.qty = strtod(value, NULL); break;
+			case 'T' : trade.time = strtoll(value, NULL, 10); break;
+			case 'm' : trade.isBuyerMaker = (*value == 't'); break;
+			}
+		}
+
+		trades.push_back(trade);
+	}
+}
+
+long long binance::AggTradeCrawler::getCheckpoint(const string& symbol) const
+{
+	long long nextId = -1, length = 0;
+	FILE* fp = fopen((root + "/" + string_toupper(symbol.c_str()) + ".checkpoint").c_str(), "r");
+	if (fp)
+	{
+		if (fscanf(fp, "%lld %lld", &nextId, &length) != 2)
+			nextId = -1;
+		fclose(fp);
+	}
+
+	return nextId;
+}
+
+binanceError_t binance::AggTradeCrawler::load(const string& symbol, vector<AggTrade>& trades) const
+{
+	trades.clear();
+
+	const string prefix = root + "/" + string_toupper(symbol.c_str());
+
+	// Only the records covered by the checkpoint are complete.
+	long long nextId = -1, length = 0;
+	FILE* fp = fopen((prefix + ".checkpoint").c_str(), "r");
+	if (!fp)
+		return binanceSuccess;
+	if (fscanf(fp, "%lld %lld", &nextId, &length) != 2)
+		length = 0;
+	fclose(fp);
+
+	fp = fopen((prefix + ".agg").c_str(), "rb");
+	if (!fp)
+		return length ? binanceErrorUnknown : binanceSuccess;
+
+	vector<char> buffer(recordSize * pageSize);
+	size_t remaining = length / recordSize;
+	trades.reserve(remaining);
+	while (remaining)
+	{
+		const size_t count = fread(&buffer[0], recordSize, min<size_t>(remaining, pageSize), fp);
+		if (!count)
+			break;
+		for (size_t i = 0; i < count; i++)
+		{
+			AggTrade trade;
+			unpack(&buffer[i * recordSize], trade);
+			trades.push_back(trade);
+		}
+		remaining -= count;
+	}
+	fclose(fp);
+
+	return remaining ? binanceErrorUnknown : binanceSuccess;
+}
+
+// Make the written records durable, then record how far they go.
+static bool checkpoint(FILE* fp, const string& filename, long long nextId)
+{
+	if ((fflush(fp) != 0) || (fsync(fileno(fp)) != 0))
+		return false;
+
+	struct stat st;
+	if (fstat(fileno(fp), &st) != 0)
+		return false;
+	const long long length = st.st_size;
+
+	const string tmpname = filename + ".tmp";
+	FILE* cp = fopen(tmpname.c_str(), "w");
+	if (!cp)
+		return false;
+	fprintf(cp, "%lld %lld\n", nextId, length);
+	if ((fflush(cp) != 0) || (fsync(fileno(cp)) != 0))
+	{
+		fclose(cp);
+		return false;
+	}
+	fclose(cp);
+
+	return rename(tmpname.c_str(), filename.c_str()) == 0;
+}
+
+binanceError_t binance::AggTradeCrawler::crawlSymbol(const string& symbol, long long fromId, long long endTime)
+{
+	const string prefix = root + "/" + string_toupper(symbol.c_str());
+	const string filename = prefix + ".agg";
+	const string cpname = prefix + ".checkpoint";
+
+	// Resume from the checkpoint, dropping the records written after it.
+	long long nextId = fromId, length = 0;
+	FILE* cp = fopen(cpname.c_str(), "r");
+	if (cp)
+	{
+		if (fscanf(cp, "%lld %lld", &nextId, &length) != 2)
+		{
+			nextId = fromId;
+			length = 0;
+		}
+		fclose(cp);
+	}
+	if (file_exists(filename) && (truncate(filename.c_str(), length) != 0))
+	{
+		BINANCE_LOG_ERROR(binanceLogMarket, "<AggTradeCrawler::crawl> Error ! cannot truncate %s", filename.c_str());
+		return binanceErrorUnknown;
+	}
+
+	FILE* fp = fopen(filename.c_str(), "ab");
+	if (!fp)
+	{
+		BINANCE_LOG_ERROR(binanceLogMarket, "<AggTradeCrawler::crawl> Error ! cannot open %s", filename.c_str());
+		return binanceErrorUnknown;
+	}
+
+	BINANCE_LOG_DEBUG(binanceLogMarket, "<AggTradeCrawler::crawl> %s from id %lld", symbol.c_str(), nextId);
+
+	binanceError_t status = binanceSuccess;
+	vector<AggTrade> trades;
+	vector<char> buffer;
+	long long total = 0;
+	for (int page = 1; !stopped; page++)
+	{
+		string url(server.getHostname());
+		url += "/api/v3/aggTrades?symbol=";
+		url += symbol;
+		url += "&fromId=";
+		url += to_string(nextId);
+		url += "&limit=";
+		url += to_string(pageSize);
+
+		string str_result;
+		status = Server::getCurl(str_result, url);
+		if (status != binanceSuccess)
+			break;
+
+		if (str_result.size() == 0)
+		{
+			status = binanceErrorEmptyServerResponse;
+			break;
+		}
+
+		if (!parse(str_result.c_str(), str_result.size(), trades))
+		{
+			BINANCE_LOG_ERROR(binanceLogMarket, "<AggTradeCrawler::crawl> Error ! %s: |%s|", symbol.c_str(), str_result.c_str());
+			status = binanceErrorInvalidServerResponse;
+			break;
+		}
+
+		bool done = (trades.size() < (size_t)pageSize);
+		buffer.resize(trades.size() * recordSize);
+		size_t count = 0;
+		for (size_t i = 0; i < trades.size(); i++)
+		{
+			if (endTime && (trades[i].time > endTime))
+			{
+				done = true;
+				break;
+			}
+			if (trades[i].id < nextId)
+				continue;
+
+			pack(trades[i], &buffer[count * recordSize]);
+			nextId = trades[i].id + 1;
+			count++;
+		}
+
+		if (count && (fwrite(&buffer[0], recordSize, count, fp) != count))
+		{
+			BINANCE_LOG_ERROR(binanceLogMarket, "<AggTradeCrawler::crawl> Error ! cannot write %s", filename.c_str());
+			status = binanceErrorUnknown;
+			break;
+		}
+		total += count;
+
+		if (done)
+			break;
+
+		if ((page % checkpointPages == 0) && !checkpoint(fp, cpname, nextId))
+		{
+			BINANCE_LOG_ERROR(binanceLogMarket, "<AggTradeCrawler::crawl> Error ! cannot checkpoint %s", cpname.c_str());
+			status = binanceErrorUnknown;
+			break;
+		}
+	}
+
+	// Keep whatever was fetched completely, even if interrupted by an error.
+	if (!checkpoint(fp, cpname, nextId) && (status == binanceSuccess))
+	{
+		BINANCE_LOG_ERROR(binanceLogMarket, "<AggTradeCrawler::crawl> Error ! cannot checkpoint %s", cpname.c_str());
+		status = binanceErrorUnknown;
+	}
+	fclose(fp);
+
+	BINANCE_LOG_INFO(binanceLogMarket, "<AggTradeCrawler::crawl> %s done, %lld trades, next id %lld", symbol.c_str(), total, nextId);
+
+	return status;
+}
+
+binanceError_t binance::AggTradeCrawler::crawl(const vector<string>& symbols, long long fromId, long long endTime)
+{
+	if (!make_directories(root))
+	{
+		BINANCE_LOG_ERROR(binanceLogMarket, "<AggTradeCrawler::crawl> Error ! cannot create %s", root.c_str());
+		return binanceErrorUnknown;
+	}
+
+	stopped = false;
+
+	// Workers take the symbols one by one.
+	atomic<size_t> next(0);
+	vector<binanceError_t> statuses(symbols.size(), binanceSuccess);
+	auto worker = [&]()
+	{
+		for (size_t i = next++; i < symbols.size(); i = next++)
+			statuses[i] = crawlSymbol(symbols[i], fromId, endTime);
+	};
+
+	vector<thread> workers;
+	for (int i = 1; i < min<long long>(threads, symbols.size()); i++)
+		workers.push_back(thread(worker));
+	worker();
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+
+	for (size_t i = 0; i < symbols.size(); i++)
+		if (statuses[i] != binanceSuccess)
+		{
+			BINANCE_LOG_ERROR(binanceLogMarket, "<AggTradeCrawler::crawl> Error ! %s: %s", symbols[i].c_str(), binanceGetErrorString(statuses[i]));
+			return statuses[i];
+		}
+
+	return binanceSuccess;
+}
+
@@ -0,0 +1,336 @@
+/*
+	C++ library for Binance API.
+*/
+
+#include "binance_hosts.h"
+#include "binance_logger.h"
+#include "binance_metrics.h"
+#include "binance_ratelimit.h"
+#include "binance_utils.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <limits>
+#include <thread>
+
+using namespace binance;
+using namespace std;
+
+// Weight of the latest ping in the smoothed round trip time.
+static const double rtt_alpha = 0.2;
+
+static const long probe_timeout_ms = 2000;
+
+static mutex pools_lock;
+
+// Never destroyed, as other threads may still route requests at exit.
+static vector<HostPool*>& getPools()
+{
+	static vector<HostPool*>* pools = new vector<HostPool*>();
+	return *pools;
+}
+
+binance::HostPool::HostPool(const vector<string>& urls, const string& pingPath_) :
+	pingPath(pingPath_), maxFailures(3), openMs(30000)
+{
+	for (size_t i = 0; i < urls.size(); i++)
+	{
+		Host host;
+		host.url = urls[i];
+		host.rttMs = -1;
+		host.failures = 0;
+		host.open = false;
+		host.openUntilMs = 0;
+		host.trial = false;
+		hosts.push_back(host);
+		probes.push_back(NULL);
+	}
+
+	Metrics::addCollector([this]()
+	{
+		lock_guard<mutex> guard(lock);
+		for (size_t i = 0; i < hosts.size(); i++)
+		{
+			const Metrics::Labels labels(1, make_pair(string("host"), hosts[i].url));
+			Metrics::getGauge("binance_host_rtt_ms", "Smoothed ping round trip of the host", labels).set(hosts[i].rttMs);
+			Metrics::getGauge("binance_host_up", "Whether the host takes requests", labels).set(hosts[i].open ? 0 : 1);
+		}
+	});
+}
+
+HostPool& binance::HostPool::add(const vector<string>& urls, const string& pingPath)
+{
+	lock_guard<mutex> guard(pools_lock);
+	vector<HostPool*>& pools = getPools();
+	for (size_t i = 0; i < pools.size(); i++)
+		if (pools[i]->hosts[0].url == urls[0])
+			return *pools[i];
+
+	pools.push_back(new HostPool(urls, pingPath));
+	return *pools.back();
+}
+
+HostPool* binance::HostPool::find(const string& url)
+{
+	lock_guard<mutex> guard(pools_lock);
+	vector<HostPool*>& pools = getPools();
+	for (size_t i = 0; i < pools.size(); i++)
+	{
+		// The first url is immutable, so it is safe to read without the pool lock.
+		const string& primary = pools[i]->hosts[0].url;
+		if ((url.compare(0, primary.size(), primary) == 0) &&
+			((url.size() == primary.size()) || (url[primary.size()] == '/')))
+			return pools[i];
+	}
+
+	return NULL;
+}
+
+// The fastest of the hosts in service, or of those out of service
+// for long enough to be tried again, then let through as their trial.
+// Unmeasured hosts go last, in order. Negative if there is none.
+int binance::HostPool::pick(const string& other)
+{
+	const double now = get_monotonic_ms();
+
+	int best = -1;
+	double bestRtt = 0;
+	for (int i = 0; i < (int)hosts.size(); i++)
+	{
+		const Host& candidate = hosts[i];
+		if ((candidate.open && (now < candidate.openUntilMs)) || (candidate.url == other))
+			continue;
+
+		const double rtt = (candidate.rttMs < 0) ? numeric_limits<double>::max() : candidate.rttMs;
+		if ((best < 0) || (rtt < bestRtt))
+		{
+			best = i;
+			bestRtt = rtt;
+		}
+	}
+
+	if ((best >= 0) && hosts[best].open)
+	{
+		// Half open: the other requests keep away until this one reports.
+		hosts[best].trial = true;
+		hosts[best].openUntilMs = now + openMs;
+	}
+
+	return best;
+}
+
+string binance::HostPool::route(const string& url, string& host)
+{
+	lock_guard<mutex> guard(lock);
+	int best = pick(string());
+
+	// All hosts are out: rather try the one to recover first than fail.
+	if (best < 0)
+	{
+		best = 0;
+		for (int i = 1; i < (int)hosts.size(); i++)
+			if (hosts[i].openUntilMs < hosts[best].openUntilMs)
+				best = i;
+	}
+
+	host = hosts[best].url;
+	return host + url.substr(hosts[0].url.size());
+}
+
+bool binance::HostPool::routeOther(const string& url, const string& other, string& routed, string& host)
+{
+	lock_guard<mutex> guard(lock);
+	const int best = pick(other);
+	if (best < 0)
+		return false;
+
+	host = hosts[best].url;
+	routed = host + url.substr(hosts[0].url.size());
+	return true;
+}
+
+void binance::HostPool::report(const string& host, bool success)
+{
+	lock_guard<mutex> guard(lock);
+	for (size_t i = 0; i < hosts.size(); i++)
+	{
+		Host& h = hosts[i];
+		if (h.url != host)
+			continue;
+
+		if (success)
+		{
+			if (h.open)
+				BINANCE_LOG_INFO(binanceLogHttp, "<HostPool> %s is back in service", h.url.c_str());
+
+			h.failures = 0;
+			h.open = false;
+			h.trial = false;
+		}
+		else if (++h.failures >= maxFailures)
+		{
+			if (!h.open)
+				BINANCE_LOG_INFO(binanceLogHttp, "<HostPool> %s is out of service after %d failures", h.url.c_str(), h.failures);
+
+			h.open = true;
+			h.trial = false;
+			h.openUntilMs = get_monotonic_ms() + openMs;
+		}
+
+		break;
+	}
+}
+
+void binance::HostPool::setBreaker(int failures, unsigned int open_ms)
+{
+	lock_guard<mutex> guard(lock);
+	maxFailures = max(failures, 1);
+	openMs = open_ms;
+}
+
+void binance::HostPool::getHosts(vector<Host>& hosts_)
+{
+	lock_guard<mutex> guard(lock);
+	hosts_ = hosts;
+}
+
+bool binance::HostPool::isDue(size_t i)
+{
+	lock_guard<mutex> guard(lock);
+	return !hosts[i].open || (get_monotonic_ms() >= hosts[i].openUntilMs);
+}
+
+static size_t discardCb(void *content, size_t size, size_t nmemb, void *userdata)
+{
+	return size * nmemb;
+}
+
+void binance::HostPool::probe()
+{
+	vector<string> urls;
+	{
+		lock_guard<mutex> guard(lock);
+		for (size_t i = 0; i < hosts.size(); i++)
+			urls.push_back(hosts[i].url);
+	}
+
+	// The pings count against the limits of the first host, as the rest do.
+	RateLimiter& limiter = RateLimiter::get(urls[0]);
+
+	for (size_t i = 0; i < urls.size(); i++)
+	{
+		// The hosts out of service are left alone until their breaker
+		// period is over, then the ping is their trial, as a request is.
+		if (!isDue(i))
+			continue;
+
+		// Pings are the least important requests of all.
+		if (!limiter.tryAcquire(RateLimiter::getWeight(urls[i] + pingPath, "GET"), binanceRequestHistory))
+			break;
+
+		{
+			lock_guard<mutex> guard(lock);
+			Host& host = hosts[i];
+			if (host.open)
+			{
+				host.trial = true;
+				host.openUntilMs = get_monotonic_ms() + openMs;
+			}
+		}
+
+		if (!probes[i])
+			probes[i] = curl_easy_init();
+		CURL* curl = probes[i];
+		if (!curl)
+			continue;
+
+		curl_easy_setopt(curl, CURLOPT_SHARE, Server::getCurlShare());
+		curl_easy_setopt(curl, CURLOPT_URL, (urls[i] + pingPath).c_str());
+		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, discardCb);
+		Server::setupTls(curl);
+		curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+		curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, probe_timeout_ms);
+
+		const double begin = get_monotonic_ms();
+		const CURLcode res = curl_easy_perform(curl);
+		const double rtt = get_monotonic_ms() - begin;
+
+		long httpStatus = 0;
+		if (res == CURLE_OK)
+			curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpStatus);
+
+		const bool success = (res == CURLE_OK) && (httpStatus == 200);
+		if (success)
+		{
+			lock_guard<mutex> guard(lock);
+			double& smoothed = hosts[i].rttMs;
+			smoothed = (smoothed < 0) ? rtt : (1 - rtt_alpha) * smoothed + rtt_alpha * rtt;
+		}
+		else
+			BINANCE_LOG_DEBUG(binanceLogHttp, "<HostPool> ping of %s failed: %s, HTTP %ld",
+				urls[i].c_str(), curl_easy_strerror(res), httpStatus);
+
+		report(urls[i], success);
+	}
+}
+
+static mutex probe_lock;
+static condition_variable probe_cond;
+static thread probe_thread;
+static bool probe_stop = false;
+
+void binance::HostPool::startProbing(unsigned int period_ms)
+{
+	stopProbing();
+
+	lock_guard<mutex> guard(probe_lock);
+	probe_stop = false;
+	probe_thread = thread([](unsigned int period_ms)
+	{
+		unique_lock<mutex> lock(probe_lock);
+		while (!probe_stop)
+		{
+			lock.unlock();
+			{
+				vector<HostPool*> pools;
+				{
+					lock_guard<mutex> guard(pools_lock);
+					pools = getPools();
+				}
+
+				for (size_t i = 0; i < pools.size(); i++)
+					pools[i]->probe();
+			}
+			lock.lock();
+
+			probe_cond.wait_for(lock, chrono::milliseconds(period_ms), [] { return probe_stop; });
+		}
+	},
+	period_ms);
+}
+
+void binance::HostPool::stopProbing()
+{
+	{
+		lock_guard<mutex> guard(probe_lock);
+		probe_stop = true;
+	}
+	probe_cond.notify_all();
+
+	if (probe_thread.joinable())
+		probe_thread.join();
+}
+
+// Do not leave a joinable thread behind at exit.
+class ProbeFinalize
+{
+public :
+
+	~ProbeFinalize()
+	{
+		HostPool::stopProbing();
+	}
+};
+
+static ProbeFinalize probeFinalize;
+
@@ -0,0 +1,252 @@
+/*
+	C++ library for Binance API.
+*/
+
+#include "binance_klines.h"
+#include "binance_logger.h"
+#include "binance_utils.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace binance;
+using namespace std;
+
+// All columns are 8 bytes wide, so that a row count is the file size / 8.
+static const char* columns[] =
+{
+	"open_time.i64",
+	"open.f64",
+	"high.f64",
+	"low.f64",
+	"close.f64",
+	"volume.f64",
+};
+
+static const size_t ncolumns = sizeof(columns) / sizeof(columns[0]);
+
+static const size_t width = 8;
+
+static off_t getFileSize(const string& filename)
+{
+	struct stat st;
+	if (stat(filename.c_str(), &st) != 0)
+		return 0;
+
+	return st.st_size;
+}
+
+// Columns may be left with different lengths by a crash in the middle
+// of an append: cut them all to the number of complete rows.
+static size_t repair(const string& path)
+{
+	size_t rows = (size_t)-1;
+	for (size_t i = 0; i < ncolumns; i++)
+		rows = min(rows, (size_t)getFileSize(path + "/" + columns[i]) / width);
+
+	for (size_t i = 0; i < ncolumns; i++)
+	{
+		const string filename = path + "/" + columns[i];
+		if ((size_t)getFileSize(filename) != rows * width)
+			if (truncate(filename.c_str(), rows * width) != 0)
+				BINANCE_LOG_ERROR(binanceLogMarket, "<KlineStore> Error ! cannot truncate %s", filename.c_str());
+	}
+
+	return rows;
+}
+
+binance::KlineStore::Mapping::Mapping() : size(0), openTime(NULL), open(NULL), high(NULL), low(NULL), close(NULL), volume(NULL)
+{
+	for (size_t i = 0; i < ncolumns; i++)
+	{
+		maps[i] = NULL;
+		lengths[i] = 0;
+	}
+}
+
+binance::KlineStore::Mapping::~Mapping()
+{
+	unload();
+}
+
+bool binance::KlineStore::Mapping::load(const string& path)
+{
+	unload();
+
+	const size_t rows = repair(path);
+	if (rows == 0)
+		return true;
+
+	for (size_t i = 0; i < ncolumns; i++)
+	{
+		const string filename = path + "/" + columns[i];
+		int fd = ::open(filename.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			unload();
+			return false;
+		}
+
+		lengths[i] = rows * width;
+		maps[i] = mmap(NULL, lengths[i], PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (maps[i] == MAP_FAILED)
+		{
+			maps[i] = NULL;
+			unload();
+			return false;
+		}
+
+		// Backtests scan the columns from start to end.
+		madvise(maps[i], lengths[i], MADV_SEQUENTIAL);
+	}
+
+	size = rows;
+	openTime = reinterpret_cast<const long long*>(maps[0]);
+	open = reinterpret_cast<const double*>(maps[1]);
+	high = reinterpret_cast<const double*>(maps[2]);
+	low = reinterpret_cast<const double*>(maps[3]);
+	close = reinterpret_cast<const double*>(maps[4]);
+	volume = reinterpret_cast<const double*>(maps[5]);
+
+	return true;
+}
+
+void binance::KlineStore::Mapping::unload()
+{
+	for (size_t i = 0; i < ncolumns; i++)
+	{
+		if (maps[i])
+			munmap(maps[i], lengths[i]);
+		maps[i] = NULL;
+		lengths[i] = 0;
+	}
+
+	size = 0;
+	openTime = NULL;
+	open = high = low = close = volume = NULL;
+}
+
+binance::KlineStore::KlineStore(const string& root_) : root(root_) { }
+
+string binance::KlineStore::getPath(const char *symbol, const char *interval) const
+{
+	return root + "/" + string_toupper(symbol) + "/" + interval;
+}
+
+size_t binance::KlineStore::size(const char *symbol, const char *interval, long long *lastOpenTime) const
+{
+	const string path = getPath(symbol, interval);
+	const size_t rows = repair(path);
+
+	if (lastOpenTime)
+	{
+		*lastOpenTime = -1;
+		if (rows)
+		{
+			FILE* fp = fopen((path + "/" + columns[0]).c_str(), "rb");
+			if (fp)
+			{
+				if ((fseeko(fp, (rows - 1) * width, SEEK_SET) != 0) || (fread(lastOpenTime, width, 1, fp) != 1))
+					*lastOpenTime = -1;
+				fclose(fp);
+			}
+		}
+	}
+
+	return rows;
+}
+
+binanceError_t binance::KlineStore::append(const char *symbol, const char *interval, const vector<Kline>& klines)
+{
+	const string path = getPath(symbol, interval);
+	if (!make_directories(path))
+	{
+		BINANCE_LOG_ERROR(binanceLogMarket, "<KlineStore::append> Error ! cannot create %s", path.c_str());
+		return binanceErrorUnknown;
+	}
+
+	long long lastOpenTime;
+	size(symbol, interval, &lastOpenTime);
+
+	size_t first = 0;
+	while ((first < klines.size()) && (klines[first].openTime <= lastOpenTime))
+		first++;
+	if (first == klines.size())
+		return binanceSuccess;
+
+	// Transpose rows into columns, one write per column.
+	const size_t rows = klines.size() - first;
+	vector<char> buffer(rows * width);
+	for (size_t c = 0; c < ncolumns; c++)
+	{
+		for (size_t i = 0; i < rows; i++)
+		{
+			const Kline& kline = klines[first + i];
+			char* dst = &buffer[i * width];
+			switch (c)
+			{
+			case 0 : memcpy(dst, &kline.openTime, width); break;
+			case 1 : memcpy(dst, &kline.open, width); break;
+			case 2 : memcpy(dst, &kline.high, width); break;
+			case 3 : memcpy(dst, &kline.low, width); break;
+			case 4 : memcpy(dst, &kline.close, width); break;
+			case 5 : memcpy(dst, &kline.volume, width); break;
+			}
+		}
+
+		const string filename = path + "/" + columns[c];
+		FILE* fp = fopen(filename.c_str(), "ab");
+		bool written = false;
+		if (fp)
+		{
+			// Closed in any case, the data is only known to be written once closed.
+			written = (fwrite(&buffer[0], 1, buffer.size(), fp) == buffer.size());
+			written = (fclose(fp) == 0) && written;
+		}
+		if (!written)
+		{
+			BINANCE_LOG_ERROR(binanceLogMarket, "<KlineStore::append> Error ! cannot write %s", filename.c_str());
+			// Drop the partially appended rows.
+			repair(path);
+			return binanceErrorUnknown;
+		}
+	}
+
+	return binanceSuccess;
+}
+
+binanceError_t binance::KlineStore::sync(KlineDownloader& downloader, const char *symbol, const char *interval,
+	long long startTime, long long endTime)
+{
+	const long long now = get_current_ms_epoch();
+	if ((endTime <= 0) || (endTime > now))
+		endTime = now;
+
+	long long lastOpenTime;
+	if (size(symbol, interval, &lastOpenTime))
+		startTime = lastOpenTime + 1;
+
+	BINANCE_LOG_DEBUG(binanceLogMarket, "<KlineStore::sync> %s %s from %lld", symbol, interval, startTime);
+
+	vector<Kline> klines;
+	binanceError_t status = downloader.download(klines, symbol, interval, startTime, endTime);
+	if (status != binanceSuccess)
+		return status;
+
+	// The store is append-only: leave the candle still in progress for the next sync.
+	while (!klines.empty() && (klines.back().closeTime >= now))
+		klines.pop_back();
+
+	return append(symbol, interval, klines);
+}
+
+bool binance::KlineStore::map(const char *symbol, const char *interval, Mapping& mapping) const
+{
+	return mapping.load(getPath(symbol, interval));
+}
@@ -0,0 +1,168 @@
+/*
+	C++ library for Binance API.
+*/
+
+#include "binance_klines.h"
+#include "binance_logger.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+
+using namespace binance;
+using namespace std;
+
+binance::KlineDownloader::KlineDownloader(const Server& server_, int threads_, int pageSize_) :
+
+server(server_), threads(max(threads_, 1)), pageSize(min(max(pageSize_, 1), 1000))
+
+{ }
+
+long long binance::KlineDownloader::getIntervalMs(const char *interval)
+{
+	char* unit = NULL;
+	const long long num = strtol(interval, &unit, 10);
+	if ((unit == interval) || (num <= 0))
+		return 0;
+
+	switch (*unit)
+	{
+	case 's' : return num * 1000;
+	case 'm' : return num * 60 * 1000;
+	case 'h' : return num * 60 * 60 * 1000;
+	case 'd' : return num * 24 * 60 * 60 * 1000;
+	case 'w' : return num * 7 * 24 * 60 * 60 * 1000;
+	// The shortest month, so that a page never holds more than pageSize candles.
+	case 'M' : return num * 28 * 24 * 60 * 60 * 1000;
+	}
+
+	return 0;
+}
+
+// [
+//   1499040000000,      // Open time
+//   "0.01634790",       // Open
+//   "0.80000000",       // High
+//   "0.01575800",       // Low
+//   "0.01577100",       // Close
+//   "148976.11427815",  // Volume
+//   1499644799999,      // Close time
+//   "2434.19055334",    // Quote asset volume
+//   308,                // Number of trades
+//   "1756.87402397",    // Taker buy base asset volume
+//   "28.46694368",      // Taker buy quote asset volume
+//   "17928899.62484339" // Ignore.
+// ]
+void binance::KlineDownloader::parse(const Json::Value& json_kline, Kline& kline)
+{
+	kline.openTime = json_kline[0].asInt64();
+	kline.open = atof(json_kline[1].asString().c_str());
+	kline.high = atof(json_kline[2].asString().c_str());
+	kline.low = atof(json_kline[3].asString().c_str());
+	kline.close = atof(json_kline[4].asString().c_str());
+	kline.volume = atof(json_kline[5].asString().c_str());
+	kline.closeTime = json_kline[6].asInt64();
+	kline.quoteVolume = atof(json_kline[7].asString().c_str());
+	kline.trades = json_kline[8].asInt64();
+	kline.takerBuyBaseVolume = atof(json_kline[9].asString().c_str());
+	kline.takerBuyQuoteVolume = atof(json_kline[10].asString().c_str());
+}
+
+// Fetch all candles opened within [startTime, endTime) page by page.
+// A page holds all of them unless the interval is irregular.
+static binanceError_t downloadChunk(Market& market, vector<Kline>& klines, const char *symbol,
+	const char *interval, long long startTime, long long endTime, int pageSize)
+{
+	while (startTime < endTime)
+	{
+		Json::Value json_result;
+		binanceError_t status = market.getKlines(json_result, symbol, interval, startTime, endTime - 1, pageSize);
+		if (status != binanceSuccess)
+			return status;
+
+		if (!json_result.isArray())
+			return binanceErrorInvalidServerResponse;
+
+		for (Json::Value::ArrayIndex i = 0; i < json_result.size(); i++)
+		{
+			Kline kline;
+			KlineDownloader::parse(json_result[i], kline);
+			klines.push_back(kline);
+		}
+
+		if ((int)json_result.size() < pageSize)
+			break;
+
+		startTime = klines.back().openTime + 1;
+	}
+
+	return binanceSuccess;
+}
+
+binanceError_t binance::KlineDownloader::download(vector<Kline>& klines, const char *symbol, const char *interval,
+	long long startTime, long long endTime)
+{
+	klines.clear();
+
+	const long long intervalMs = getIntervalMs(interval);
+	if (!intervalMs)
+		return binanceErrorUnknown;
+
+	if (startTime >= endTime)
+		return binanceSuccess;
+
+	BINANCE_LOG_DEBUG(binanceLogMarket, "<KlineDownloader::download> %s %s [%lld, %lld)", symbol, interval, startTime, endTime);
+
+	const long long pageMs = intervalMs * pageSize;
+	const size_t nchunks = (endTime - startTime + pageMs - 1) / pageMs;
+	vector<vector<Kline> > chunks(nchunks);
+	vector<binanceError_t> statuses(nchunks, binanceSuccess);
+
+	// Workers take the chunks in time order.
+	atomic<size_t> next(0);
+	const string symbol_(symbol), interval_(interval);
+	auto worker = [&]()
+	{
+		Market market(server);
+		for (size_t i = next++; i < nchunks; i = next++)
+		{
+			const long long chunkStart = startTime + i * pageMs;
+			const long long chunkEnd = min(chunkStart + pageMs, endTime);
+			statuses[i] = downloadChunk(market, chunks[i], symbol_.c_str(), interval_.c_str(),
+				chunkStart, chunkEnd, pageSize);
+		}
+	};
+
+	vector<thread> workers;
+	for (int i = 1; i < min<long long>(threads, nchunks); i++)
+		workers.push_back(thread(worker));
+	worker();
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+
+	for (size_t i = 0; i < nchunks; i++)
+		if (statuses[i] != binanceSuccess)
+		{
+			BINANCE_LOG_ERROR(binanceLogMarket, "<KlineDownloader::download> Error ! %s", binanceGetErrorString(statuses[i]));
+			return statuses[i];
+		}
+
+	// Chunks are ordered and disjoint, but the exchange may return
+	// a candle opened just before the range, or repeat one on a boundary.
+	for (size_t i = 0; i < nchunks; i++)
+		for (size_t j = 0; j < chunks[i].size(); j++)
+		{
+			const Kline& kline = chunks[i][j];
+			if ((kline.openTime < startTime) || (kline.openTime >= endTime))
+				continue;
+			if (!klines.empty() && (kline.openTime <= klines.back().openTime))
+				continue;
+			klines.push_back(kline);
+		}
+
+	BINANCE_LOG_INFO(binanceLogMarket, "<KlineDownloader::download> Done, %zu klines.", klines.size());
+
+	return binanceSuccess;
+}
+
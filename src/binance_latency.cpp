@@ -0,0 +1,428 @@
+/*
+	C++ library for Binance API.
+*/
+
+#include "binance_latency.h"
+#include "binance_logger.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace binance;
+using namespace std;
+
+// Log-linear buckets: values below 2 * subBuckets have a bucket each, then
+// every power of two is split into subBuckets buckets of equal width.
+static const int subBucketBits = 6;
+static const uint64_t subBuckets = 1 << subBucketBits;
+static const int bucketCount = 32 * subBuckets; // up to 2^37 ns
+
+static int getBucket(uint64_t ns)
+{
+	if (ns < 2 * subBuckets)
+		return (int)ns;
+
+	const int exponent = 63 - __builtin_clzll(ns) - subBucketBits;
+	const int bucket = (exponent + 1) * subBuckets + (int)((ns >> exponent) - subBuckets);
+	return min(bucket, bucketCount - 1);
+}
+
+static double getBucketMiddle(int bucket)
+{
+	if (bucket < 2 * (int)subBuckets)
+		return bucket;
+
+	const int exponent = bucket / subBuckets - 1;
+	const uint64_t lower = (bucket % subBuckets + subBuckets) << exponent;
+	return lower + ((uint64_t)1 << exponent) / 2.0;
+}
+
+namespace
+{
+
+// Written by the owning thread only, so that plain loads and stores are
+// enough, and read by any thread. A reset() concurrent with recording may
+// leave a few samples of the thread out, which is fine for monitoring.
+struct Histogram
+{
+	atomic<uint32_t> counts[bucketCount];
+	atomic<uint64_t> count;
+	atomic<uint64_t> sum;
+	atomic<uint64_t> min;
+	atomic<uint64_t> max;
+
+	Histogram()
+	{
+		clear();
+	}
+
+	void clear()
+	{
+		for (int i = 0; i < bucketCount; i++)
+			counts[i].store(0, memory_order_relaxed);
+		count.store(0, memory_order_relaxed);
+		sum.store(0, memory_order_relaxed);
+		min.store(UINT64_MAX, memory_order_relaxed);
+		max.store(0, memory_order_relaxed);
+	}
+
+	void add(uint64_t ns)
+	{
+		atomic<uint32_t>& bucket = counts[getBucket(ns)];
+		bucket.store(bucket.load(memory_order_relaxed) + 1, memory_order_relaxed);
+		count.store(count.load(memory_order_relaxed) + 1, memory_order_relaxed);
+		sum.store(sum.load(memory_order_relaxed) + ns, memory_order_relaxed);
+		if (ns < min.load(memory_order_relaxed))
+			min.store(ns, memory_order_relaxed);
+		if (ns > max.load(memory_order_relaxed))
+			max.store(ns, memory_order_relaxed);
+	}
+};
+
+// Snapshot of histograms merged over threads.
+struct Merged
+{
+	vector<uint64_t> counts;
+	uint64_t count, sum, min, max;
+
+	Merged() : counts(bucketCount), count(0), sum(0), min(UINT64_MAX), max(0) { }
+
+	void add(const Histogram& histogram)
+	{
+		for (int i = 0; i < bucketCount; i++)
+			counts[i] += histogram.counts[i].load(memory_order_relaxed);
+		count += histogram.count.load(memory_order_relaxed);
+		sum += histogram.sum.load(memory_order_relaxed);
+		min = std::min(min, histogram.min.load(memory_order_relaxed));
+		max = std::max(max, histogram.max.load(memory_order_relaxed));
+	}
+
+	double getPercentile(double p) const
+	{
+		const uint64_t rank = std::max((uint64_t)(p / 100.0 * count + 0.5), (uint64_t)1);
+		uint64_t seen = 0;
+		for (int i = 0; i < bucketCount; i++)
+		{
+			seen += counts[i];
+			if (seen >= rank)
+				return std::min(std::max(getBucketMiddle(i), (double)min), (double)max);
+		}
+		return max;
+	}
+};
+
+struct ThreadHistograms
+{
+	Histogram points[Latency::PointCount];
+};
+
+// Histograms of the running threads, and those merged from the exited ones.
+// Never destroyed, as threads may still record during the static destruction.
+struct Registry
+{
+	mutex lock;
+	vector<ThreadHistograms*> threads;
+	ThreadHistograms exited;
+};
+
+static Registry& getRegistry()
+{
+	static Registry* registry = new Registry();
+	return *registry;
+}
+
+class ThreadHistogramsHolder
+{
+public :
+
+	ThreadHistograms* histograms;
+
+	ThreadHistogramsHolder() : histograms(new ThreadHistograms())
+	{
+		Registry& registry = getRegistry();
+		lock_guard<mutex> guard(registry.lock);
+		registry.threads.push_back(histograms);
+	}
+
+	~ThreadHistogramsHolder()
+	{
+		Registry& registry = getRegistry();
+		lock_guard<mutex> guard(registry.lock);
+		for (int point = 0; point < Latency::PointCount; point++)
+		{
+			Merged merged;
+			merged.add(histograms->points[point]);
+
+			Histogram& exited = registry.exited.points[point];
+			for (int i = 0; i < bucketCount; i++)
+				if (merged.counts[i])
+					exited.counts[i].store(exited.counts[i].load() + merged.counts[i]);
+			exited.count.store(exited.count.load() + merged.count);
+			exited.sum.store(exited.sum.load() + merged.sum);
+			exited.min.store(min(exited.min.load(), merged.min));
+			exited.max.store(max(exited.max.load(), merged.max));
+		}
+		registry.threads.erase(find(registry.threads.begin(), registry.threads.end(), histograms));
+		delete histograms;
+	}
+};
+
+} // namespace
+
+static ThreadHistograms& getThreadHistograms()
+{
+	static thread_local ThreadHistogramsHolder holder;
+	return *holder.histograms;
+}
+
+static atomic<bool> enabled(true);
+
+namespace
+{
+
+// Conversion of the timestamps to ns: the rate is measured once on first use,
+// then refined about every second against the initial anchor.
+struct TicksClock
+{
+	Latency::Ticks anchorTicks;
+	uint64_t anchorNs;
+	atomic<double> nsPerTick;
+	atomic<Latency::Ticks> refinedTicks;
+	Latency::Ticks refinePeriod;
+
+	TicksClock() : refinePeriod(0)
+	{
+		nsPerTick.store(1);
+		anchorTicks = Latency::now();
+		anchorNs = monotonicNs();
+		refinedTicks.store(anchorTicks);
+#if defined(__x86_64__) || defined(__i386__)
+		// Spin for 1 ms, for a first estimate.
+		while (monotonicNs() - anchorNs < 1000000) { }
+		refine(Latency::now());
+		refinePeriod = (Latency::Ticks)(1e9 / nsPerTick.load());
+#endif
+	}
+
+	static uint64_t monotonicNs()
+	{
+		return chrono::duration_cast<chrono::nanoseconds>(
+			chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void refine(Latency::Ticks ticks)
+	{
+		const uint64_t ns = monotonicNs();
+		if (ticks > anchorTicks)
+			nsPerTick.store((double)(ns - anchorNs) / (ticks - anchorTicks), memory_order_relaxed);
+	}
+
+	double toNs(Latency::Ticks begin, Latency::Ticks end)
+	{
+		if (refinePeriod && (end - refinedTicks.load(memory_order_relaxed) > refinePeriod))
+		{
+			refinedTicks.store(end, memory_order_relaxed);
+			refine(end);
+		}
+
+		return (end > begin) ? (end - begin) * nsPerTick.load(memory_order_relaxed) : 0;
+	}
+};
+
+} // namespace
+
+// Calibrated by the first measurement rather than at load time, so that
+// the processes which never record pay nothing for it.
+static TicksClock& getTicksClock()
+{
+	static TicksClock ticksClock;
+	return ticksClock;
+}
+
+uint64_t binance::Latency::monotonicNs()
+{
+	return TicksClock::monotonicNs();
+}
+
+const char* binance::Latency::getName(Point point)
+{
+	static const char* names[] =
+	{
+		"request_build",
+		"sign",
+		"dns_lookup",
+		"connect",
+		"tls_handshake",
+		"first_byte",
+		"transfer",
+		"parse",
+		"callback",
+		"ws_dispatch",
+	};
+
+	if ((point < 0) || (point >= PointCount))
+		return "unknown";
+
+	return names[point];
+}
+
+void binance::Latency::setEnabled(bool enabled_)
+{
+	enabled.store(enabled_);
+}
+
+bool binance::Latency::isEnabled()
+{
+	return enabled.load(memory_order_relaxed);
+}
+
+void binance::Latency::record(Point point, Ticks begin)
+{
+	if (!isEnabled())
+		return;
+
+	recordNs(point, getTicksClock().toNs(begin, now()));
+}
+
+void binance::Latency::recordNs(Point point, double ns)
+{
+	if (!isEnabled() || (point < 0) || (point >= PointCount))
+		return;
+
+	getThreadHistograms().points[point].add((uint64_t)max(ns, 0.0));
+}
+
+static Merged getMerged(Latency::Point point)
+{
+	Registry& registry = getRegistry();
+	lock_guard<mutex> guard(registry.lock);
+
+	Merged merged;
+	merged.add(registry.exited.points[point]);
+	for (size_t i = 0; i < registry.threads.size(); i++)
+		merged.add(registry.threads[i]->points[point]);
+
+	return merged;
+}
+
+void binance::Latency::getStats(Point point, Stats& stats)
+{
+	stats = Stats();
+	if ((point < 0) || (point >= PointCount))
+		return;
+
+	const Merged merged = getMerged(point);
+	stats.count = merged.count;
+	if (!merged.count)
+		return;
+
+	stats.min = merged.min;
+	stats.max = merged.max;
+	stats.mean = (double)merged.sum / merged.count;
+	stats.p50 = merged.getPercentile(50);
+	stats.p90 = merged.getPercentile(90);
+	stats.p99 = merged.getPercentile(99);
+	stats.p999 = merged.getPercentile(99.9);
+}
+
+void binance::Latency::reset()
+{
+	Registry& registry = getRegistry();
+	lock_guard<mutex> guard(registry.lock);
+
+	for (int point = 0; point < PointCount; point++)
+	{
+		registry.exited.points[point].clear();
+		for (size_t i = 0; i < registry.threads.size(); i++)
+			registry.threads[i]->points[point].clear();
+	}
+}
+
+string binance::Latency::dump()
+{
+	string result;
+	for (int point = 0; point < PointCount; point++)
+	{
+		Stats stats;
+		getStats((Point)point, stats);
+		if (!stats.count)
+			continue;
+
+		char line[256];
+		snprintf(line, sizeof(line),
+			"%s count=%llu mean=%.1f p50=%.1f p90=%.1f p99=%.1f p99.9=%.1f max=%.1f us\n",
+			getName((Point)point), (unsigned long long)stats.count, stats.mean * 1e-3,
+			stats.p50 * 1e-3, stats.p90 * 1e-3, stats.p99 * 1e-3, stats.p999 * 1e-3, stats.max * 1e-3);
+		result += line;
+	}
+
+	return result;
+}
+
+static mutex dump_lock;
+static condition_variable dump_cond;
+static bool dump_stop = true;
+static thread dump_thread;
+
+void binance::Latency::startDump(unsigned int period_sec, bool reset)
+{
+	stopDump();
+
+	lock_guard<mutex> guard(dump_lock);
+	dump_stop = false;
+	dump_thread = thread([](unsigned int period_sec, bool reset)
+	{
+		unique_lock<mutex> lock(dump_lock);
+		while (!dump_cond.wait_for(lock, chrono::seconds(period_sec), [] { return dump_stop; }))
+		{
+			lock.unlock();
+
+			const string lines = Latency::dump();
+			size_t begin = 0;
+			for (size_t end = lines.find('\n'); end != string::npos; begin = end + 1, end = lines.find('\n', begin))
+				BINANCE_LOG_INFO(binanceLogGeneral, "<Latency> %s", lines.substr(begin, end - begin).c_str());
+			if (reset)
+				Latency::reset();
+
+			lock.lock();
+		}
+	},
+	period_sec, reset);
+}
+
+void binance::Latency::stopDump()
+{
+	{
+		lock_guard<mutex> guard(dump_lock);
+		dump_stop = true;
+	}
+	dump_cond.notify_all();
+
+	if (dump_thread.joinable())
+		dump_thread.join();
+}
+
+namespace
+{
+
+// Do not leave a joinable thread behind at exit.
+class LatencyDumpFinalize
+{
+public :
+
+	~LatencyDumpFinalize()
+	{
+		Latency::stopDump();
+	}
+};
+
+} // namespace
+
+static LatencyDumpFinalize latencyDumpFinalize;
+
@@ -1,85 +1,480 @@
 /*
 	Author: tensaix2j
 	Date  : 2017/10/15
-	
+
 	C++ library for Binance API.
 */
 
 #include "binance_logger.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
 #include <cstdarg>
+#include <cstring>
+#include <mutex>
+#include <stdint.h>
 #include <sys/time.h>
+#include <thread>
+#include <vector>
 
+using namespace binance;
 using namespace std;
 
 int	binance::Logger::debug_level = 0;
 string binance::Logger::debug_log_file = "/tmp/binawatch.log";
 int	binance::Logger::debug_log_file_enable = 0;
 FILE *binance::Logger::log_fp = NULL;
+int binance::Logger::category_levels[binanceLogCategoryCount] =
+	{ binanceLogTrace, binanceLogTrace, binanceLogTrace, binanceLogTrace, binanceLogTrace };
 
-void binance::Logger::write_log( const char *fmt, ... ) 
+// Layout of a record in the ring, followed by the arguments: the type byte,
+// then either 8 bytes of value, or the length and the bytes of a string.
+struct LogRecordHeader
 {
-	if ( debug_level == 0 )
-		return;
+	uint32_t size;
+	uint8_t clean;
+	uint8_t count;
+	int64_t sec;
+	int64_t usec;
+	const char* fmt;
+};
 
-	if ( debug_log_file_enable == 1 )
-		open_logfp_if_not_opened();
+static const uint32_t nullString = UINT32_MAX;
+
+// Single producer (the owning thread), single consumer (the writer) ring.
+struct LogRing
+{
+	static const size_t capacity = 1024 * 1024;
+
+	char buffer[capacity];
+	atomic<size_t> head; // written up to, by the producer
+	atomic<size_t> tail; // read up to, by the consumer
+	atomic<uint64_t> dropped;
+	atomic<bool> closed; // the thread has exited
+
+	LogRing() : head(0), tail(0), dropped(0), closed(false) { }
+
+	void write(size_t position, const void* data, size_t size)
+	{
+		const size_t offset = position % capacity;
+		const size_t first = min(size, capacity - offset);
+		memcpy(buffer + offset, data, first);
+		memcpy(buffer, (const char*)data + first, size - first);
+	}
+
+	void read(size_t position, void* data, size_t size) const
+	{
+		const size_t offset = position % capacity;
+		const size_t first = min(size, capacity - offset);
+		memcpy(data, buffer + offset, first);
+		memcpy((char*)data + first, buffer, size - first);
+	}
+};
+
+// Rings of the threads, never destroyed, as threads may still log
+// during the static destruction.
+struct LogRegistry
+{
+	mutex lock;
+	vector<LogRing*> rings;
+};
+
+static LogRegistry& getLogRegistry()
+{
+	static LogRegistry* registry = new LogRegistry();
+	return *registry;
+}
+
+class LogRingHolder
+{
+public :
+
+	LogRing* ring;
+
+	LogRingHolder() : ring(new LogRing())
+	{
+		LogRegistry& registry = getLogRegistry();
+		lock_guard<mutex> guard(registry.lock);
+		registry.rings.push_back(ring);
+	}
+
+	// The writer frees the ring once it is drained.
+	~LogRingHolder()
+	{
+		ring->closed.store(true, memory_order_release);
+	}
+};
+
+static LogRing& getLogRing()
+{
+	static thread_local LogRingHolder holder;
+	return *holder.ring;
+}
+
+static mutex writer_lock;
+static condition_variable writer_cond;
+static bool writer_stop = false;
+static thread writer_thread;
+static atomic<int> writer_state(0); // 0 - not started, 1 - running, 2 - stopped
+
+static void startWriter();
+
+void binance::Logger::write_record( bool clean, const char *fmt, const LogArg *args, int count )
+{
+	if ( writer_state.load(memory_order_acquire) == 0 )
+		startWriter();
+
+	LogRecordHeader header;
+	header.size = sizeof(header);
+	header.clean = clean;
+	header.count = (uint8_t)min(count, 255);
+
+	uint32_t lengths[256];
+	for ( int i = 0; i < header.count; i++ )
+	{
+		header.size += 1;
+		if ( args[i].type == LogArg::String )
+		{
+			lengths[i] = args[i].s ? (uint32_t)strlen( args[i].s ) : nullString;
+			header.size += sizeof(uint32_t) + ( args[i].s ? lengths[i] : 0 );
+		}
+		else
+			header.size += 8;
+	}
+
+	LogRing& ring = getLogRing();
+	const size_t head = ring.head.load(memory_order_relaxed);
+	if ( header.size > LogRing::capacity - ( head - ring.tail.load(memory_order_acquire) ) )
+	{
+		ring.dropped.store( ring.dropped.load(memory_order_relaxed) + 1, memory_order_relaxed );
+		return;
+	}
 
-	va_list arg;
-	
-	char new_fmt[1024];
-	
 	struct timeval tv;
-	gettimeofday(&tv, NULL); 
-	time_t t = tv.tv_sec;
-	struct tm * now = localtime( &t );
+	gettimeofday(&tv, NULL);
+	header.sec = tv.tv_sec;
+	header.usec = tv.tv_usec;
+	header.fmt = fmt;
 
+	size_t position = head;
+	ring.write( position, &header, sizeof(header) );
+	position += sizeof(header);
+	for ( int i = 0; i < header.count; i++ )
+	{
+		const uint8_t type = args[i].type;
+		ring.write( position++, &type, 1 );
+		if ( args[i].type == LogArg::String )
+		{
+			ring.write( position, &lengths[i], sizeof(uint32_t) );
+			position += sizeof(uint32_t);
+			if ( args[i].s )
+			{
+				ring.write( position, args[i].s, lengths[i] );
+				position += lengths[i];
+			}
+		}
+		else
+		{
+			ring.write( position, &args[i].ull, 8 );
+			position += 8;
+		}
+	}
+	ring.head.store( position, memory_order_release );
 
-	sprintf( new_fmt, "%04d-%02d-%02d %02d:%02d:%02d %06ld :%s\n",
-		now->tm_year + 1900, now->tm_mon + 1, now->tm_mday, now->tm_hour, now->tm_min, now->tm_sec, (long)tv.tv_usec, fmt );
+	// Nobody is left to write it out.
+	if ( writer_state.load(memory_order_acquire) == 2 )
+		flush();
+}
 
-	va_start (arg, fmt);
-	
-	if ( debug_log_file_enable && log_fp )
+template<typename T>
+static int print(char* buffer, size_t size, const char* spec, int stars, const int* star, T value)
+{
+	switch (stars)
 	{
-		vfprintf( log_fp , new_fmt ,arg );
-		fflush(log_fp);
+	case 0 : return snprintf(buffer, size, spec, value);
+	case 1 : return snprintf(buffer, size, spec, star[0], value);
+	default : return snprintf(buffer, size, spec, star[0], star[1], value);
 	}
-	else
+}
+
+static int print(char* buffer, size_t size, const char* spec, int stars, const int* star, const LogArg& arg)
+{
+	switch (arg.type)
 	{
-		vfprintf ( stdout, new_fmt, arg);
-		fflush(stdout);
-	}   
+	case LogArg::Int : return print(buffer, size, spec, stars, star, arg.i);
+	case LogArg::UInt : return print(buffer, size, spec, stars, star, arg.u);
+	case LogArg::Long : return print(buffer, size, spec, stars, star, arg.l);
+	case LogArg::ULong : return print(buffer, size, spec, stars, star, arg.ul);
+	case LogArg::LongLong : return print(buffer, size, spec, stars, star, arg.ll);
+	case LogArg::ULongLong : return print(buffer, size, spec, stars, star, arg.ull);
+	case LogArg::Double : return print(buffer, size, spec, stars, star, arg.d);
+	case LogArg::Pointer : return print(buffer, size, spec, stars, star, arg.p);
+	case LogArg::String : return print(buffer, size, spec, stars, star, arg.s);
+	}
 
-	va_end (arg);
+	return 0;
 }
 
-// Write log to channel without any timestamp nor new line
-void binance::Logger::write_log_clean( const char *fmt, ... ) 
+// Same as vsprintf() of the original arguments, one conversion at a time.
+static void format(string& line, const char* fmt, const LogArg* args, int count)
 {
-	if ( debug_level == 0 )
+	int next = 0;
+	for (const char* p = fmt; *p; )
+	{
+		if (*p != '%')
+		{
+			const char* end = strchr(p, '%');
+			if (!end)
+				end = p + strlen(p);
+			line.append(p, end - p);
+			p = end;
+			continue;
+		}
+
+		if (p[1] == '%')
+		{
+			line += '%';
+			p += 2;
+			continue;
+		}
+
+		const char* begin = p++;
+		int stars = 0;
+		while (*p && strchr("-+ #0'", *p)) p++;
+		if (*p == '*') { stars++; p++; } else while (isdigit(*p)) p++;
+		if (*p == '.')
+		{
+			p++;
+			if (*p == '*') { stars++; p++; } else while (isdigit(*p)) p++;
+		}
+		while (*p && strchr("hlLqjzt", *p)) p++;
+		if (!*p)
+		{
+			line.append(begin);
+			break;
+		}
+		const char conversion = *p++;
+		const string spec(begin, p);
+
+		int star[2] = { 0, 0 };
+		for (int i = 0; i < stars; i++)
+			if (next < count)
+				star[i] = args[next++].i;
+
+		// A missing or mismatching argument is printed as the bare conversion,
+		// instead of the undefined behavior of printf.
+		if ((next >= count) || (conversion == 'n') ||
+			((conversion == 's') != (args[next].type == LogArg::String)))
+		{
+			line += spec;
+			next++;
+			continue;
+		}
+
+		char buffer[512];
+		const int length = print(buffer, sizeof(buffer), spec.c_str(), stars, star, args[next]);
+		if (length < (int)sizeof(buffer))
+			line.append(buffer, max(length, 0));
+		else
+		{
+			vector<char> large(length + 1);
+			print(&large[0], large.size(), spec.c_str(), stars, star, args[next]);
+			line.append(&large[0], length);
+		}
+		next++;
+	}
+}
+
+struct LogEntry
+{
+	int64_t sec;
+	int64_t usec;
+	vector<char> record;
+
+	bool operator<(const LogEntry& other) const
+	{
+		return (sec < other.sec) || ((sec == other.sec) && (usec < other.usec));
+	}
+};
+
+static void decode(const vector<char>& record, LogRecordHeader& header, vector<LogArg>& args)
+{
+	memcpy(&header, &record[0], sizeof(header));
+
+	size_t position = sizeof(header);
+	for (int i = 0; i < header.count; i++)
+	{
+		const LogArg::Type type = (LogArg::Type)(uint8_t)record[position++];
+		LogArg arg(0);
+		arg.type = type;
+		if (type == LogArg::String)
+		{
+			uint32_t length;
+			memcpy(&length, &record[position], sizeof(length));
+			position += sizeof(length);
+			arg.s = (length == nullString) ? NULL : &record[position];
+			if (length != nullString)
+				position += length;
+		}
+		else
+		{
+			memcpy(&arg.ull, &record[position], 8);
+			position += 8;
+		}
+		args.push_back(arg);
+	}
+}
+
+static mutex drain_lock;
+
+// Format the records of all rings, in time order, and write them out.
+void binance::Logger::flush()
+{
+	lock_guard<mutex> guard(drain_lock);
+
+	vector<LogRing*> rings;
+	{
+		LogRegistry& registry = getLogRegistry();
+		lock_guard<mutex> guard(registry.lock);
+		rings = registry.rings;
+	}
+
+	vector<LogEntry> entries;
+	uint64_t dropped = 0;
+	for (size_t i = 0; i < rings.size(); i++)
+	{
+		LogRing& ring = *rings[i];
+		const bool closed = ring.closed.load(memory_order_acquire);
+		const size_t head = ring.head.load(memory_order_acquire);
+		size_t tail = ring.tail.load(memory_order_relaxed);
+		while (tail != head)
+		{
+			LogRecordHeader header;
+			ring.read(tail, &header, sizeof(header));
+
+			entries.push_back(LogEntry());
+			LogEntry& entry = entries.back();
+			entry.sec = header.sec;
+			entry.usec = header.usec;
+			entry.record.resize(header.size + 1);
+			ring.read(tail, &entry.record[0], header.size);
+			entry.record[header.size] = '\0'; // keeps the last string terminated
+			tail += header.size;
+		}
+		ring.tail.store(tail, memory_order_release);
+		dropped += ring.dropped.exchange(0);
+
+		if (closed)
+		{
+			LogRegistry& registry = getLogRegistry();
+			lock_guard<mutex> guard(registry.lock);
+			registry.rings.erase(find(registry.rings.begin(), registry.rings.end(), rings[i]));
+			delete rings[i];
+		}
+	}
+
+	if (entries.empty() && !dropped)
 		return;
 
-	if ( debug_log_file_enable == 1 )
-		open_logfp_if_not_opened();
+	stable_sort(entries.begin(), entries.end());
 
-	va_list arg;
-	va_start (arg, fmt);
-	
-	if ( debug_log_file_enable && log_fp )
+	string lines;
+	int64_t prefixSec = -1;
+	char prefix[64] = "";
+	vector<LogArg> args;
+	for (size_t i = 0; i < entries.size(); i++)
 	{
-		vfprintf( log_fp , fmt ,arg );
-		fflush(log_fp);
+		LogRecordHeader header;
+		args.clear();
+		decode(entries[i].record, header, args);
+
+		if (!header.clean)
+		{
+			if (header.sec != prefixSec)
+			{
+				prefixSec = header.sec;
+				const time_t t = header.sec;
+				struct tm now;
+				localtime_r(&t, &now);
+				snprintf(prefix, sizeof(prefix), "%04d-%02d-%02d %02d:%02d:%02d",
+					now.tm_year + 1900, now.tm_mon + 1, now.tm_mday, now.tm_hour, now.tm_min, now.tm_sec);
+			}
+
+			char usec[16];
+			snprintf(usec, sizeof(usec), " %06ld :", (long)header.usec);
+			lines += prefix;
+			lines += usec;
+		}
+
+		format(lines, header.fmt, args.empty() ? NULL : &args[0], (int)args.size());
+
+		if (!header.clean)
+			lines += '\n';
 	}
-	else
+
+	if (dropped)
 	{
-		vfprintf ( stdout, fmt, arg);
-		fflush(stdout);
+		char line[128];
+		snprintf(line, sizeof(line), "<Logger> Error ! %llu log lines dropped, the ring is full\n",
+			(unsigned long long)dropped);
+		lines += line;
 	}
 
-	va_end (arg);
+	if ( debug_log_file_enable == 1 )
+		open_logfp_if_not_opened();
+
+	FILE* fp = ( debug_log_file_enable && log_fp ) ? log_fp : stdout;
+	fwrite(lines.data(), 1, lines.size(), fp);
+	fflush(fp);
+}
+
+static void startWriter()
+{
+	lock_guard<mutex> guard(writer_lock);
+	if (writer_state.load() != 0)
+		return;
+
+	writer_thread = thread([]()
+	{
+		unique_lock<mutex> lock(writer_lock);
+		while (!writer_stop)
+		{
+			lock.unlock();
+			Logger::flush();
+			lock.lock();
+
+			writer_cond.wait_for(lock, chrono::milliseconds(1), [] { return writer_stop; });
+		}
+	});
+	writer_state.store(1, memory_order_release);
 }
 
+// Write out the last lines, then log synchronously from then on.
+class LoggerFinalize
+{
+public :
+
+	~LoggerFinalize()
+	{
+		{
+			lock_guard<mutex> guard(writer_lock);
+			writer_stop = true;
+			writer_state.store(2, memory_order_release);
+		}
+		writer_cond.notify_all();
+
+		if (writer_thread.joinable())
+			writer_thread.join();
+
+		Logger::flush();
+	}
+};
+
+static LoggerFinalize loggerFinalize;
+
 void binance::Logger::open_logfp_if_not_opened()
 {
 	if ( debug_log_file_enable && log_fp == NULL )
@@ -98,6 +493,17 @@ void binance::Logger::set_debug_level( int level )
 	debug_level = level;
 }
 
+void binance::Logger::set_log_level( binanceLogLevel_t level )
+{
+	for ( int i = 0; i < binanceLogCategoryCount; i++ )
+		category_levels[i] = level;
+}
+
+void binance::Logger::set_log_level( binanceLogCategory_t category, binanceLogLevel_t level )
+{
+	category_levels[category] = level;
+}
+
 void binance::Logger::set_debug_logfp( FILE* fp ) 
 {
 	log_fp = fp;
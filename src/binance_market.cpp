@@ -6,7 +6,10 @@
 */
 
 #include "binance.h"
+#include "binance_latency.h"
 #include "binance_logger.h"
+#include "binance_metrics.h"
+#include "binance_ratelimit.h"
 #include "binance_utils.h"
 
 #include <fstream>
@@ -27,13 +30,15 @@ binanceError_t binance::Market::getExchangeInfo(Json::Value &json_result)
 {
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<get_exchangeInfo>");
+	BINANCE_LOG_DEBUG(binanceLogMarket, "<get_exchangeInfo>");
 
 	string url(hostname);
 	url += "/api/v3/exchangeInfo";
 
 	string str_result;
-	Server::getCurl(str_result, url);
+	status = Server::getCurl(str_result, url);
+	if (status != binanceSuccess)
+		return status;
 
 	if (str_result.size() == 0)
 		status = binanceErrorEmptyServerResponse;
@@ -45,28 +50,33 @@ binanceError_t binance::Market::getExchangeInfo(Json::Value &json_result)
 			JSONCPP_STRING err;
 			Json::CharReaderBuilder builder;
 			const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+			LatencyScope parse_scope(Latency::Parse);
 			if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 							   &err)) {
-				Logger::write_log("<get_exchangeInfo> Error ! %s", err.c_str());
+				BINANCE_LOG_ERROR(binanceLogMarket, "<get_exchangeInfo> Error ! %s", err.c_str());
 				status = binanceErrorParsingServerResponse;
+				Metrics::countError(status);
 				return status;
 			}
 			CHECK_SERVER_ERR(json_result);
+
+			server.getRateLimiter().setLimits(json_result["rateLimits"]);
 		}
 		catch (exception &e)
 		{
-			Logger::write_log("<get_exchangeInfo> Error ! %s", e.what());
+			BINANCE_LOG_ERROR(binanceLogMarket, "<get_exchangeInfo> Error ! %s", e.what());
 			status = binanceErrorParsingServerResponse;
+			Metrics::countError(status);
 		}
 	}
 
-	Logger::write_log("<get_exchangeInfo> Done.");
+	BINANCE_LOG_DEBUG(binanceLogMarket, "<get_exchangeInfo> Done.");
 
 	return status;
 }
 
 binanceError_t binance::Market::getAndSaveExchangeInfo() {
-    Logger::write_log("<getAndSave_exchangeInfo>");
+    BINANCE_LOG_DEBUG(binanceLogMarket, "<getAndSave_exchangeInfo>");
     Json::StreamWriterBuilder builder;
     builder["indentation"] = "\t";
     std::unique_ptr<Json::StreamWriter> writer(builder.newStreamWriter());
@@ -76,14 +86,14 @@ binanceError_t binance::Market::getAndSaveExchangeInfo() {
 
     std::ofstream ofs("exchangeinfo.json");
     if (!ofs.is_open()) {
-        Logger::write_log("Failed to open file exchangeinfo.json");
+        BINANCE_LOG_ERROR(binanceLogMarket, "Failed to open file exchangeinfo.json");
         return binanceErrorUnknown;
     }
 
     writer->write(result, &ofs);
     ofs.close();
 
-    Logger::write_log("<getAndSave_exchangeInfo> Done.");
+    BINANCE_LOG_DEBUG(binanceLogMarket, "<getAndSave_exchangeInfo> Done.");
     return binanceSuccess;
 }
 
@@ -91,7 +101,7 @@ binanceError_t binance::Market::getExchangeInfoLocaly(Json::Value &json_result)
 {
     binanceError_t status = binanceSuccess;
 
-    Logger::write_log("<getExchangeInfoLocaly>");
+    BINANCE_LOG_DEBUG(binanceLogMarket, "<getExchangeInfoLocaly>");
 
     std::ifstream jsonFile("exchangeinfo.json");
 
@@ -120,22 +130,25 @@ binanceError_t binance::Market::getExchangeInfoLocaly(Json::Value &json_result)
 			JSONCPP_STRING err;
 			Json::CharReaderBuilder builder;
 			const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+			LatencyScope parse_scope(Latency::Parse);
 			if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 							   &err)) {
-				Logger::write_log("<getExchangeInfoLocaly> Error ! %s", err.c_str());
+				BINANCE_LOG_ERROR(binanceLogMarket, "<getExchangeInfoLocaly> Error ! %s", err.c_str());
 				status = binanceErrorParsingServerResponse;
+				Metrics::countError(status);
 				return status;
 			}
 			CHECK_SERVER_ERR(json_result);
         }
         catch (exception &e)
         {
-            Logger::write_log("<getExchangeInfoLocaly> Error ! %s", e.what());
+            BINANCE_LOG_ERROR(binanceLogMarket, "<getExchangeInfoLocaly> Error ! %s", e.what());
             status = binanceErrorParsingServerResponse;
+            Metrics::countError(status);
         }
     }
 
-    Logger::write_log("<getExchangeInfoLocaly> Done.");
+    BINANCE_LOG_DEBUG(binanceLogMarket, "<getExchangeInfoLocaly> Done.");
 
     return status;
 }
@@ -150,7 +163,7 @@ binanceError_t binance::Market::getExchangeInfoLocaly(Json::Value &json_result)
 //(quantity-minQty) % stepSize == 0
 binanceError_t binance::Market::getLotSize(const char *symbol, double& maxQty, double& minQty, double& stepSize)
 {
-	Logger::write_log("<get_lotSize>");
+	BINANCE_LOG_DEBUG(binanceLogMarket, "<get_lotSize>");
 
 	Json::Value exchangeInfo;
 	string str_symbol = string_toupper(symbol);
@@ -180,14 +193,14 @@ binanceError_t binance::Market::getLotSize(const char *symbol, double& maxQty, d
 		}
 	}
 
-	Logger::write_log("<get_lotSize> Done.");
+	BINANCE_LOG_DEBUG(binanceLogMarket, "<get_lotSize> Done.");
 
 	return status;
 }
 
 binanceError_t binance::Market::getTickSize(const char *symbol, double& maxPrice, double& minPrice, double& tickSize)
 {
-	Logger::write_log("<get_tickSize>");
+	BINANCE_LOG_DEBUG(binanceLogMarket, "<get_tickSize>");
 
 	Json::Value exchangeInfo;
 	string str_symbol = string_toupper(symbol);
@@ -217,14 +230,14 @@ binanceError_t binance::Market::getTickSize(const char *symbol, double& maxPrice
 		}
 	}
 
-	Logger::write_log("<get_tickSize> Done.");
+	BINANCE_LOG_DEBUG(binanceLogMarket, "<get_tickSize> Done.");
 
 	return status;
 }
 
 binanceError_t binance::Market::getBaseAsset(const char *symbol, string& baseAsset, int& baseAssetPrecision, int& baseCommissionPrecision)
 {
-  Logger::write_log("<get_BaseAssetconst>");
+  BINANCE_LOG_DEBUG(binanceLogMarket, "<get_BaseAssetconst>");
 
   Json::Value exchangeInfo;
   string str_symbol = string_toupper(symbol);
@@ -248,14 +261,14 @@ binanceError_t binance::Market::getBaseAsset(const char *symbol, string& baseAss
     }
   }
 
-  Logger::write_log("<get_BaseAssetconst> Done.");
+  BINANCE_LOG_DEBUG(binanceLogMarket, "<get_BaseAssetconst> Done.");
 
   return status;
 }
 
 binanceError_t binance::Market::getMinNotional(const char *symbol, double& minNotional)
 {
-    Logger::write_log("<get_MinNotional>");
+    BINANCE_LOG_DEBUG(binanceLogMarket, "<get_MinNotional>");
 
     Json::Value exchangeInfo;
     string str_symbol = string_toupper(symbol);
@@ -283,7 +296,7 @@ binanceError_t binance::Market::getMinNotional(const char *symbol, double& minNo
         }
     }
 
-    Logger::write_log("<get_MinNotional> Done.");
+    BINANCE_LOG_DEBUG(binanceLogMarket, "<get_MinNotional> Done.");
 
     return status;
 }
@@ -294,13 +307,15 @@ binanceError_t binance::Market::getAllPrices(Json::Value &json_result)
 {
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<get_allPrices>");
+	BINANCE_LOG_DEBUG(binanceLogMarket, "<get_allPrices>");
 
 	string url(hostname);
 	url += "/api/v1/ticker/allPrices";
 
 	string str_result;
-	Server::getCurl(str_result, url);
+	status = Server::getCurl(str_result, url);
+	if (status != binanceSuccess)
+		return status;
 
 	if (str_result.size() == 0)
 		status = binanceErrorEmptyServerResponse;
@@ -312,22 +327,25 @@ binanceError_t binance::Market::getAllPrices(Json::Value &json_result)
 			JSONCPP_STRING err;
 			Json::CharReaderBuilder builder;
 			const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+			LatencyScope parse_scope(Latency::Parse);
 			if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 							   &err)) {
-				Logger::write_log("<get_allPrices> Error ! %s", err.c_str());
+				BINANCE_LOG_ERROR(binanceLogMarket, "<get_allPrices> Error ! %s", err.c_str());
 				status = binanceErrorParsingServerResponse;
+				Metrics::countError(status);
 				return status;
 			}
 			CHECK_SERVER_ERR(json_result);
 		}
 		catch (exception &e)
 		{
-		 	Logger::write_log("<get_allPrices> Error ! %s", e.what());
+		 	BINANCE_LOG_ERROR(binanceLogMarket, "<get_allPrices> Error ! %s", e.what());
 			status = binanceErrorParsingServerResponse;
+			Metrics::countError(status);
 		}
 	}
 
-	Logger::write_log("<get_allPrices> Done.");
+	BINANCE_LOG_DEBUG(binanceLogMarket, "<get_allPrices> Done.");
 
 	return status;
 }
@@ -337,7 +355,7 @@ binanceError_t binance::Market::getPrice(const char *symbol, double& price)
 {
     binanceError_t status = binanceSuccess;
 
-    Logger::write_log("<get_price>");
+    BINANCE_LOG_DEBUG(binanceLogMarket, "<get_price>");
 
     string url(hostname);
     url += "/api/v3/ticker/price?";
@@ -347,10 +365,12 @@ binanceError_t binance::Market::getPrice(const char *symbol, double& price)
     querystring.append(symbol);
 
     url.append(querystring);
-    Logger::write_log("<get_price> url = |%s|", url.c_str());
+    BINANCE_LOG_TRACE(binanceLogMarket, "<get_price> url = |%s|", url.c_str());
 
     string str_result;
-    Server::getCurl(str_result, url);
+    status = Server::getCurl(str_result, url);
+    if (status != binanceSuccess)
+        return status;
 
     if (str_result.size() == 0)
         status = binanceErrorEmptyServerResponse;
@@ -362,10 +382,12 @@ binanceError_t binance::Market::getPrice(const char *symbol, double& price)
 			JSONCPP_STRING err;
 			Json::CharReaderBuilder builder;
 			const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+			LatencyScope parse_scope(Latency::Parse);
 			if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 							   &err)) {
-				Logger::write_log("<get_price> Error ! %s", err.c_str());
+				BINANCE_LOG_ERROR(binanceLogMarket, "<get_price> Error ! %s", err.c_str());
 				status = binanceErrorParsingServerResponse;
+				Metrics::countError(status);
 				return status;
 			}
 			CHECK_SERVER_ERR(json_result);
@@ -373,12 +395,13 @@ binanceError_t binance::Market::getPrice(const char *symbol, double& price)
         }
         catch (exception &e)
         {
-            Logger::write_log("<get_price> Error ! %s", e.what());
+            BINANCE_LOG_ERROR(binanceLogMarket, "<get_price> Error ! %s", e.what());
             status = binanceErrorParsingServerResponse;
+            Metrics::countError(status);
         }
     }
 
-    Logger::write_log("<get_price> Done.");
+    BINANCE_LOG_DEBUG(binanceLogMarket, "<get_price> Done.");
 
     return status;
 }
@@ -388,7 +411,7 @@ binanceError_t binance::Market::getPriceTick(const char *symbol, double& askPric
 {
     binanceError_t status = binanceSuccess;
 
-    Logger::write_log("<get_PriceTick>");
+    BINANCE_LOG_DEBUG(binanceLogMarket, "<get_PriceTick>");
 
     string url(hostname);
     url += "/api/v3/ticker/bookTicker?";
@@ -398,10 +421,12 @@ binanceError_t binance::Market::getPriceTick(const char *symbol, double& askPric
     querystring.append(symbol);
 
     url.append(querystring);
-    Logger::write_log("<get_PriceTick> url = |%s|", url.c_str());
+    BINANCE_LOG_TRACE(binanceLogMarket, "<get_PriceTick> url = |%s|", url.c_str());
 
     string str_result;
-    Server::getCurl(str_result, url);
+    status = Server::getCurl(str_result, url);
+    if (status != binanceSuccess)
+        return status;
 
     if (str_result.size() == 0)
         status = binanceErrorEmptyServerResponse;
@@ -413,10 +438,12 @@ binanceError_t binance::Market::getPriceTick(const char *symbol, double& askPric
 			JSONCPP_STRING err;
 			Json::CharReaderBuilder builder;
 			const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+			LatencyScope parse_scope(Latency::Parse);
 			if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 							   &err)) {
-				Logger::write_log("<get_PriceTick> Error ! %s", err.c_str());
+				BINANCE_LOG_ERROR(binanceLogMarket, "<get_PriceTick> Error ! %s", err.c_str());
 				status = binanceErrorParsingServerResponse;
+				Metrics::countError(status);
 				return status;
 			}
 			CHECK_SERVER_ERR(json_result);
@@ -427,12 +454,13 @@ binanceError_t binance::Market::getPriceTick(const char *symbol, double& askPric
         }
         catch (exception &e)
         {
-            Logger::write_log("<get_PriceTick> Error ! %s", e.what());
+            BINANCE_LOG_ERROR(binanceLogMarket, "<get_PriceTick> Error ! %s", e.what());
             status = binanceErrorParsingServerResponse;
+            Metrics::countError(status);
         }
     }
 
-    Logger::write_log("<get_PriceTick> Done.");
+    BINANCE_LOG_DEBUG(binanceLogMarket, "<get_PriceTick> Done.");
 
     return status;
 }
@@ -443,13 +471,15 @@ binanceError_t binance::Market::getAllBookTickers(Json::Value &json_result)
 {
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<get_allBookTickers>");
+	BINANCE_LOG_DEBUG(binanceLogMarket, "<get_allBookTickers>");
 
 	string url(hostname);
 	url += "/api/v1/ticker/allBookTickers";
 
 	string str_result;
-	Server::getCurl(str_result, url);
+	status = Server::getCurl(str_result, url);
+	if (status != binanceSuccess)
+		return status;
 
 	if (str_result.size() == 0)
 		status = binanceErrorEmptyServerResponse;
@@ -461,22 +491,25 @@ binanceError_t binance::Market::getAllBookTickers(Json::Value &json_result)
 			JSONCPP_STRING err;
 			Json::CharReaderBuilder builder;
 			const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+			LatencyScope parse_scope(Latency::Parse);
 			if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 							   &err)) {
-				Logger::write_log("<get_allBookTickers> Error ! %s", err.c_str());
+				BINANCE_LOG_ERROR(binanceLogMarket, "<get_allBookTickers> Error ! %s", err.c_str());
 				status = binanceErrorParsingServerResponse;
+				Metrics::countError(status);
 				return status;
 			}
 			CHECK_SERVER_ERR(json_result);
 		}
 		catch (exception &e)
 		{
-		 	Logger::write_log("<get_allBookTickers> Error ! %s", e.what());
+		 	BINANCE_LOG_ERROR(binanceLogMarket, "<get_allBookTickers> Error ! %s", e.what());
 			status = binanceErrorParsingServerResponse;
+			Metrics::countError(status);
 		}
 	}
 
-	Logger::write_log("<get_allBookTickers> Done.");
+	BINANCE_LOG_DEBUG(binanceLogMarket, "<get_allBookTickers> Done.");
 
 	return status;
 }
@@ -485,7 +518,7 @@ binanceError_t binance::Market::getBookTicker(Json::Value &json_result, const ch
 {
     binanceError_t status = binanceSuccess;
 
-    Logger::write_log("<get_BookTicker>");
+    BINANCE_LOG_DEBUG(binanceLogMarket, "<get_BookTicker>");
 
     string url(hostname);
     url += "/api/v3/ticker/bookTicker?";
@@ -494,10 +527,12 @@ binanceError_t binance::Market::getBookTicker(Json::Value &json_result, const ch
     querystring.append(symbol);
 
     url.append(querystring);
-    Logger::write_log("<get_BookTicker> url = |%s|", url.c_str());
+    BINANCE_LOG_TRACE(binanceLogMarket, "<get_BookTicker> url = |%s|", url.c_str());
 
     string str_result;
-    Server::getCurl(str_result, url);
+    status = Server::getCurlHedged(str_result, url);
+    if (status != binanceSuccess)
+        return status;
 
     if (str_result.size() == 0)
         status = binanceErrorEmptyServerResponse;
@@ -509,22 +544,25 @@ binanceError_t binance::Market::getBookTicker(Json::Value &json_result, const ch
 			JSONCPP_STRING err;
 			Json::CharReaderBuilder builder;
 			const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+			LatencyScope parse_scope(Latency::Parse);
 			if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 							   &err)) {
-				Logger::write_log("<get_BookTicker> Error ! %s", err.c_str());
+				BINANCE_LOG_ERROR(binanceLogMarket, "<get_BookTicker> Error ! %s", err.c_str());
 				status = binanceErrorParsingServerResponse;
+				Metrics::countError(status);
 				return status;
 			}
 			CHECK_SERVER_ERR(json_result);
         }
         catch (exception &e)
         {
-            Logger::write_log("<get_BookTicker> Error ! %s", e.what());
+            BINANCE_LOG_ERROR(binanceLogMarket, "<get_BookTicker> Error ! %s", e.what());
             status = binanceErrorParsingServerResponse;
+            Metrics::countError(status);
         }
     }
 
-    Logger::write_log("<get_BookTicker> Done.");
+    BINANCE_LOG_DEBUG(binanceLogMarket, "<get_BookTicker> Done.");
 
     return status;
 }
@@ -541,7 +579,7 @@ binanceError_t binance::Market::getDepth(Json::Value &json_result, const char *s
 {
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<get_depth>");
+	BINANCE_LOG_DEBUG(binanceLogMarket, "<get_depth>");
 
 	string url(hostname);
 	url += "/api/v3/depth?";
@@ -552,10 +590,12 @@ binanceError_t binance::Market::getDepth(Json::Value &json_result, const char *s
 	querystring.append(to_string(limit));
 
 	url.append(querystring);
-	Logger::write_log("<get_depth> url = |%s|", url.c_str());
+	BINANCE_LOG_TRACE(binanceLogMarket, "<get_depth> url = |%s|", url.c_str());
 
 	string str_result;
-	Server::getCurl(str_result, url);
+	status = Server::getCurlHedged(str_result, url);
+	if (status != binanceSuccess)
+		return status;
 
 	if (str_result.size() == 0)
 		status = binanceErrorEmptyServerResponse;
@@ -567,22 +607,25 @@ binanceError_t binance::Market::getDepth(Json::Value &json_result, const char *s
 			JSONCPP_STRING err;
 			Json::CharReaderBuilder builder;
 			const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+			LatencyScope parse_scope(Latency::Parse);
 			if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 							   &err)) {
-				Logger::write_log("<get_depth> Error ! %s", err.c_str());
+				BINANCE_LOG_ERROR(binanceLogMarket, "<get_depth> Error ! %s", err.c_str());
 				status = binanceErrorParsingServerResponse;
+				Metrics::countError(status);
 				return status;
 			}
 			CHECK_SERVER_ERR(json_result);
 		}
 		catch (exception &e)
 		{
-		 	Logger::write_log("<get_depth> Error ! %s", e.what());
+		 	BINANCE_LOG_ERROR(binanceLogMarket, "<get_depth> Error ! %s", e.what());
 			status = binanceErrorParsingServerResponse;
+			Metrics::countError(status);
 		}
 	}
 
-	Logger::write_log("<get_depth> Done.");
+	BINANCE_LOG_DEBUG(binanceLogMarket, "<get_depth> Done.");
 
 	return status;
 }
@@ -602,7 +645,7 @@ binanceError_t binance::Market::getAggTrades(Json::Value &json_result, const cha
 {
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<get_aggTrades>");
+	BINANCE_LOG_DEBUG(binanceLogMarket, "<get_aggTrades>");
 
 	string url(hostname);
 	url += "/api/v3/aggTrades?";
@@ -617,10 +660,12 @@ binanceError_t binance::Market::getAggTrades(Json::Value &json_result, const cha
 	querystring.append(to_string(limit));
 
 	url.append(querystring);
-	Logger::write_log("<get_aggTrades> url = |%s|", url.c_str());
+	BINANCE_LOG_TRACE(binanceLogMarket, "<get_aggTrades> url = |%s|", url.c_str());
 
 	string str_result;
-	Server::getCurl(str_result, url);
+	status = Server::getCurl(str_result, url);
+	if (status != binanceSuccess)
+		return status;
 
 	if (str_result.size() == 0)
 		status = binanceErrorEmptyServerResponse;
@@ -632,22 +677,25 @@ binanceError_t binance::Market::getAggTrades(Json::Value &json_result, const cha
 			JSONCPP_STRING err;
 			Json::CharReaderBuilder builder;
 			const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+			LatencyScope parse_scope(Latency::Parse);
 			if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 							   &err)) {
-				Logger::write_log("<get_aggTrades> Error ! %s", err.c_str());
+				BINANCE_LOG_ERROR(binanceLogMarket, "<get_aggTrades> Error ! %s", err.c_str());
 				status = binanceErrorParsingServerResponse;
+				Metrics::countError(status);
 				return status;
 			}
 			CHECK_SERVER_ERR(json_result);
 		}
 		catch (exception &e)
 		{
-		 	Logger::write_log("<get_aggTrades> Error ! %s", e.what());
+		 	BINANCE_LOG_ERROR(binanceLogMarket, "<get_aggTrades> Error ! %s", e.what());
 			status = binanceErrorParsingServerResponse;
+			Metrics::countError(status);
 		}
 	}
 
-	Logger::write_log("<get_aggTrades> Done.");
+	BINANCE_LOG_DEBUG(binanceLogMarket, "<get_aggTrades> Done.");
 
 	return status;
 }
@@ -667,7 +715,7 @@ binanceError_t binance::Market::getAggTrades(Json::Value &json_result, const cha
 {
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<get_aggTrades>");
+	BINANCE_LOG_DEBUG(binanceLogMarket, "<get_aggTrades>");
 
 	string url(hostname);
 	url += "/api/v3/aggTrades?";
@@ -685,10 +733,12 @@ binanceError_t binance::Market::getAggTrades(Json::Value &json_result, const cha
 	querystring.append(to_string(limit));
 
 	url.append(querystring);
-	Logger::write_log("<get_aggTrades> url = |%s|", url.c_str());
+	BINANCE_LOG_TRACE(binanceLogMarket, "<get_aggTrades> url = |%s|", url.c_str());
 
 	string str_result;
-	Server::getCurl(str_result, url);
+	status = Server::getCurl(str_result, url);
+	if (status != binanceSuccess)
+		return status;
 
 	if (str_result.size() == 0)
 		status = binanceErrorEmptyServerResponse;
@@ -700,22 +750,25 @@ binanceError_t binance::Market::getAggTrades(Json::Value &json_result, const cha
 			JSONCPP_STRING err;
 			Json::CharReaderBuilder builder;
 			const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+			LatencyScope parse_scope(Latency::Parse);
 			if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 							   &err)) {
-				Logger::write_log("<get_aggTrades> Error ! %s", err.c_str());
+				BINANCE_LOG_ERROR(binanceLogMarket, "<get_aggTrades> Error ! %s", err.c_str());
 				status = binanceErrorParsingServerResponse;
+				Metrics::countError(status);
 				return status;
 			}
 			CHECK_SERVER_ERR(json_result);
 		}
 		catch (exception &e)
 		{
-		 	Logger::write_log("<get_aggTrades> Error ! %s", e.what());
+		 	BINANCE_LOG_ERROR(binanceLogMarket, "<get_aggTrades> Error ! %s", e.what());
 			status = binanceErrorParsingServerResponse;
+			Metrics::countError(status);
 		}
 	}
 
-	Logger::write_log("<get_aggTrades> Done.");
+	BINANCE_LOG_DEBUG(binanceLogMarket, "<get_aggTrades> Done.");
 
 	return status;
 }
@@ -729,7 +782,7 @@ binanceError_t binance::Market::get24hr(Json::Value &json_result, const char *sy
 {
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<get_24hr>");
+	BINANCE_LOG_DEBUG(binanceLogMarket, "<get_24hr>");
 
 	string url(hostname);
 	url += "/api/v3/ticker/24hr?";
@@ -738,10 +791,12 @@ binanceError_t binance::Market::get24hr(Json::Value &json_result, const char *sy
 	querystring.append(symbol);
 
 	url.append(querystring);
-	Logger::write_log("<get_24hr> url = |%s|", url.c_str());
+	BINANCE_LOG_TRACE(binanceLogMarket, "<get_24hr> url = |%s|", url.c_str());
 
 	string str_result;
-	Server::getCurl(str_result, url);
+	status = Server::getCurl(str_result, url);
+	if (status != binanceSuccess)
+		return status;
 
 	if (str_result.size() == 0)
 		status = binanceErrorEmptyServerResponse;
@@ -753,22 +808,25 @@ binanceError_t binance::Market::get24hr(Json::Value &json_result, const char *sy
 			JSONCPP_STRING err;
 			Json::CharReaderBuilder builder;
 			const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+			LatencyScope parse_scope(Latency::Parse);
 			if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 							   &err)) {
-				Logger::write_log("<get_24hr> Error ! %s", err.c_str());
+				BINANCE_LOG_ERROR(binanceLogMarket, "<get_24hr> Error ! %s", err.c_str());
 				status = binanceErrorParsingServerResponse;
+				Metrics::countError(status);
 				return status;
 			}
 			CHECK_SERVER_ERR(json_result);
 		}
 		catch (exception &e)
 		{
-		 	Logger::write_log("<get_24hr> Error ! %s", e.what());
+		 	BINANCE_LOG_ERROR(binanceLogMarket, "<get_24hr> Error ! %s", e.what());
 			status = binanceErrorParsingServerResponse;
+			Metrics::countError(status);
 		}
 	}
 
-	Logger::write_log("<get_24hr> Done.");
+	BINANCE_LOG_DEBUG(binanceLogMarket, "<get_24hr> Done.");
 
 	return status;
 }
@@ -779,7 +837,7 @@ binanceError_t binance::Market::get24hrTick(const char *symbol, double& lastPric
 {
     binanceError_t status = binanceSuccess;
 
-    Logger::write_log("<get_24hr>");
+    BINANCE_LOG_DEBUG(binanceLogMarket, "<get_24hr>");
 
     string url(hostname);
     url += "/api/v3/ticker/24hr?";
@@ -789,10 +847,12 @@ binanceError_t binance::Market::get24hrTick(const char *symbol, double& lastPric
     querystring.append(symbol);
 
     url.append(querystring);
-    Logger::write_log("<get_24hr> url = |%s|", url.c_str());
+    BINANCE_LOG_TRACE(binanceLogMarket, "<get_24hr> url = |%s|", url.c_str());
 
     string str_result;
-    Server::getCurl(str_result, url);
+    status = Server::getCurl(str_result, url);
+    if (status != binanceSuccess)
+        return status;
 
     if (str_result.size() == 0)
         status = binanceErrorEmptyServerResponse;
@@ -804,10 +864,12 @@ binanceError_t binance::Market::get24hrTick(const char *symbol, double& lastPric
 			JSONCPP_STRING err;
 			Json::CharReaderBuilder builder;
 			const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+			LatencyScope parse_scope(Latency::Parse);
 			if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 							   &err)) {
-				Logger::write_log("<get_24hr> Error ! %s", err.c_str());
+				BINANCE_LOG_ERROR(binanceLogMarket, "<get_24hr> Error ! %s", err.c_str());
 				status = binanceErrorParsingServerResponse;
+				Metrics::countError(status);
 				return status;
 			}
 			CHECK_SERVER_ERR(json_result);
@@ -824,12 +886,13 @@ binanceError_t binance::Market::get24hrTick(const char *symbol, double& lastPric
         }
         catch (exception &e)
         {
-            Logger::write_log("<get_24hr> Error ! %s", e.what());
+            BINANCE_LOG_ERROR(binanceLogMarket, "<get_24hr> Error ! %s", e.what());
             status = binanceErrorParsingServerResponse;
+            Metrics::countError(status);
         }
     }
 
-    Logger::write_log("<get_24hr> Done.");
+    BINANCE_LOG_DEBUG(binanceLogMarket, "<get_24hr> Done.");
 
     return status;
 }
@@ -849,7 +912,7 @@ binanceError_t binance::Market::getKlines(Json::Value &json_result, const char *
 {
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<get_klines>");
+	BINANCE_LOG_DEBUG(binanceLogMarket, "<get_klines>");
 
 	string url(hostname);
 	url += prefix + "/klines?";
@@ -876,10 +939,12 @@ binanceError_t binance::Market::getKlines(Json::Value &json_result, const char *
 	querystring.append(to_string(limit));
 
 	url.append(querystring);
-	Logger::write_log("<get_klines> url = |%s|", url.c_str());
+	BINANCE_LOG_TRACE(binanceLogMarket, "<get_klines> url = |%s|", url.c_str());
 
 	string str_result;
-	Server::getCurl(str_result, url);
+	status = Server::getCurl(str_result, url);
+	if (status != binanceSuccess)
+		return status;
 
 	if (str_result.size() == 0)
 		status = binanceErrorEmptyServerResponse;
@@ -891,22 +956,25 @@ binanceError_t binance::Market::getKlines(Json::Value &json_result, const char *
 			JSONCPP_STRING err;
 			Json::CharReaderBuilder builder;
 			const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+			LatencyScope parse_scope(Latency::Parse);
 			if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 							   &err)) {
-				Logger::write_log("<get_klines> Error ! %s", err.c_str());
+				BINANCE_LOG_ERROR(binanceLogMarket, "<get_klines> Error ! %s", err.c_str());
 				status = binanceErrorParsingServerResponse;
+				Metrics::countError(status);
 				return status;
 			}
 			CHECK_SERVER_ERR(json_result);
 		}
 		catch (exception &e)
 		{
-		 	Logger::write_log("<get_klines> Error ! %s", e.what());
+		 	BINANCE_LOG_ERROR(binanceLogMarket, "<get_klines> Error ! %s", e.what());
 			status = binanceErrorParsingServerResponse;
+			Metrics::countError(status);
 		}
 	}
 
-	Logger::write_log("<get_klines> Done.");
+	BINANCE_LOG_DEBUG(binanceLogMarket, "<get_klines> Done.");
 
 	return status;
 }
@@ -915,7 +983,7 @@ binanceError_t binance::Market::getLastFundingRate(Json::Value &json_result, con
 {
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<get_fundingRate>");
+	BINANCE_LOG_DEBUG(binanceLogMarket, "<get_fundingRate>");
 
 	string url(hostname);
 	url = "https://www.binance.com/fapi/v1/premiumIndex?";
@@ -924,10 +992,12 @@ binanceError_t binance::Market::getLastFundingRate(Json::Value &json_result, con
 	querystring.append(symbol);
 
 	url.append(querystring);
-	Logger::write_log("<get_fundingRate> url = |%s|", url.c_str());
+	BINANCE_LOG_TRACE(binanceLogMarket, "<get_fundingRate> url = |%s|", url.c_str());
 
 	string str_result;
-	Server::getCurl(str_result, url);
+	status = Server::getCurl(str_result, url);
+	if (status != binanceSuccess)
+		return status;
 
 	if (str_result.size() == 0)
 		status = binanceErrorEmptyServerResponse;
@@ -939,22 +1009,25 @@ binanceError_t binance::Market::getLastFundingRate(Json::Value &json_result, con
 			JSONCPP_STRING err;
 			Json::CharReaderBuilder builder;
 			const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+			LatencyScope parse_scope(Latency::Parse);
 			if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 							   &err)) {
-				Logger::write_log("<get_fundingRate> Error ! %s", err.c_str());
+				BINANCE_LOG_ERROR(binanceLogMarket, "<get_fundingRate> Error ! %s", err.c_str());
 				status = binanceErrorParsingServerResponse;
+				Metrics::countError(status);
 				return status;
 			}
 			CHECK_SERVER_ERR(json_result);
 		}
 		catch (exception &e)
 		{
-		 	Logger::write_log("<get_fundingRate> Error ! %s", e.what());
+		 	BINANCE_LOG_ERROR(binanceLogMarket, "<get_fundingRate> Error ! %s", e.what());
 			status = binanceErrorParsingServerResponse;
+			Metrics::countError(status);
 		}
 	}
 
-	Logger::write_log("<get_fundingRate> Done.");
+	BINANCE_LOG_DEBUG(binanceLogMarket, "<get_fundingRate> Done.");
 
 	std::cout<<str_result<<std::endl<<std::endl;
 
@@ -965,15 +1038,17 @@ binanceError_t binance::Market::getServerTime(Json::Value &json_result)
 {
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<get_ServerTime>");
+	BINANCE_LOG_DEBUG(binanceLogMarket, "<get_ServerTime>");
 
 	string url(hostname);
 	url = "https://www.binance.com/fapi/v1/time";
 
-	Logger::write_log("<get_serverTime> url = |%s|", url.c_str());
+	BINANCE_LOG_TRACE(binanceLogMarket, "<get_serverTime> url = |%s|", url.c_str());
 
 	string str_result;
-	Server::getCurl(str_result, url);
+	status = Server::getCurl(str_result, url);
+	if (status != binanceSuccess)
+		return status;
 
 	if (str_result.size() == 0)
 		status = binanceErrorEmptyServerResponse;
@@ -985,22 +1060,25 @@ binanceError_t binance::Market::getServerTime(Json::Value &json_result)
 			JSONCPP_STRING err;
 			Json::CharReaderBuilder builder;
 			const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+			LatencyScope parse_scope(Latency::Parse);
 			if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 							   &err)) {
-				Logger::write_log("<get_serverTime> Error ! %s", err.c_str());
+				BINANCE_LOG_ERROR(binanceLogMarket, "<get_serverTime> Error ! %s", err.c_str());
 				status = binanceErrorParsingServerResponse;
+				Metrics::countError(status);
 				return status;
 			}
 			CHECK_SERVER_ERR(json_result);
 		}
 		catch (exception &e)
 		{
-		 	Logger::write_log("<get_serverTime> Error ! %s", e.what());
+		 	BINANCE_LOG_ERROR(binanceLogMarket, "<get_serverTime> Error ! %s", e.what());
 			status = binanceErrorParsingServerResponse;
+			Metrics::countError(status);
 		}
 	}
 
-	Logger::write_log("<get_ServerTime> Done.");
+	BINANCE_LOG_DEBUG(binanceLogMarket, "<get_ServerTime> Done.");
 
 	return status;
 }
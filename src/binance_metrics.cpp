@@ -0,0 +1,567 @@
+/*
+	C++ library for Binance API.
+*/
+
+#include "binance_metrics.h"
+#include "binance_logger.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace binance;
+using namespace std;
+
+// Capacity of the registry: the cells of the counters are preallocated
+// in each thread, so that incrementing never has to grow them.
+static const int maxCounters = 2048;
+static const int maxGauges = 2048;
+
+namespace
+{
+
+struct Series
+{
+	string name;
+	string labels; // formatted, without braces
+	Metrics::Labels tags;
+	int slot;
+};
+
+struct Family
+{
+	string help;
+	bool counter;
+	vector<int> series;
+};
+
+// Written by the owning thread only, read by any thread.
+struct ThreadCounters
+{
+	atomic<uint64_t> cells[maxCounters];
+
+	ThreadCounters()
+	{
+		for (int i = 0; i < maxCounters; i++)
+			cells[i].store(0, memory_order_relaxed);
+	}
+};
+
+// Never destroyed, as threads may still count during the static destruction.
+struct Registry
+{
+	mutex lock;
+	map<string, Family> families;
+	map<string, int> index; // series by name and labels
+	deque<Series> series; // never reallocated
+	int counters;
+	int gauges;
+	vector<ThreadCounters*> threads;
+	vector<uint64_t> exited; // counts of the exited threads
+	atomic<double> gaugeValues[maxGauges];
+	vector<function<void()> > collectors;
+
+	Registry() : counters(0), gauges(0), exited(maxCounters)
+	{
+		for (int i = 0; i < maxGauges; i++)
+			gaugeValues[i].store(0, memory_order_relaxed);
+	}
+};
+
+static Registry& getRegistry()
+{
+	static Registry* registry = new Registry();
+	return *registry;
+}
+
+class ThreadCountersHolder
+{
+public :
+
+	ThreadCounters* counters;
+
+	ThreadCountersHolder() : counters(new ThreadCounters())
+	{
+		Registry& registry = getRegistry();
+		lock_guard<mutex> guard(registry.lock);
+		registry.threads.push_back(counters);
+	}
+
+	~ThreadCountersHolder()
+	{
+		Registry& registry = getRegistry();
+		lock_guard<mutex> guard(registry.lock);
+		for (int i = 0; i < maxCounters; i++)
+			registry.exited[i] += counters->cells[i].load(memory_order_relaxed);
+		registry.threads.erase(find(registry.threads.begin(), registry.threads.end(), counters));
+		delete counters;
+	}
+};
+
+} // namespace
+
+static ThreadCounters& getThreadCounters()
+{
+	static thread_local ThreadCountersHolder holder;
+	return *holder.counters;
+}
+
+void binance::Metrics::Counter::add(uint64_t value) const
+{
+	if (id < 0)
+		return;
+
+	atomic<uint64_t>& cell = getThreadCounters().cells[id];
+	cell.store(cell.load(memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+void binance::Metrics::Gauge::set(double value) const
+{
+	if (id < 0)
+		return;
+
+	getRegistry().gaugeValues[id].store(value, memory_order_relaxed);
+}
+
+void binance::Metrics::Gauge::add(double value) const
+{
+	if (id < 0)
+		return;
+
+	atomic<double>& gauge = getRegistry().gaugeValues[id];
+	double current = gauge.load(memory_order_relaxed);
+	while (!gauge.compare_exchange_weak(current, current + value, memory_order_relaxed)) { }
+}
+
+static string formatLabels(const Metrics::Labels& labels)
+{
+	string result;
+	for (size_t i = 0; i < labels.size(); i++)
+	{
+		if (i)
+			result += ',';
+		result += labels[i].first;
+		result += "=\"";
+		for (size_t j = 0; j < labels[i].second.size(); j++)
+		{
+			const char c = labels[i].second[j];
+			if (c == '\n')
+				result += "\\n";
+			else
+			{
+				if ((c == '\\') || (c == '"'))
+					result += '\\';
+				result += c;
+			}
+		}
+		result += '"';
+	}
+
+	return result;
+}
+
+// Slot of the series, or -1 if the registry is full or the type conflicts.
+static int getSeries(const string& name, const string& help, const Metrics::Labels& labels, bool counter)
+{
+	Registry& registry = getRegistry();
+	lock_guard<mutex> guard(registry.lock);
+
+	const string labelsString = formatLabels(labels);
+	const string key = name + "{" + labelsString + "}";
+	map<string, int>::const_iterator it = registry.index.find(key);
+	if (it != registry.index.end())
+	{
+		if (registry.families[name].counter != counter)
+			return -1;
+		return registry.series[it->second].slot;
+	}
+
+	map<string, Family>::iterator family = registry.families.find(name);
+	if (family == registry.families.end())
+	{
+		family = registry.families.insert(make_pair(name, Family())).first;
+		family->second.help = help;
+		family->second.counter = counter;
+	}
+	else if (family->second.counter != counter)
+	{
+		BINANCE_LOG_ERROR(binanceLogGeneral, "<Metrics> Error ! %s is registered with another type", name.c_str());
+		return -1;
+	}
+
+	int& used = counter ? registry.counters : registry.gauges;
+	if (used >= (counter ? maxCounters : maxGauges))
+	{
+		BINANCE_LOG_ERROR(binanceLogGeneral, "<Metrics> Error ! too many series, %s is not registered", key.c_str());
+		return -1;
+	}
+
+	Series series;
+	series.name = name;
+	series.labels = labelsString;
+	series.tags = labels;
+	series.slot = used++;
+	registry.index[key] = registry.series.size();
+	family->second.series.push_back(registry.series.size());
+	registry.series.push_back(series);
+
+	return series.slot;
+}
+
+Metrics::Counter binance::Metrics::getCounter(const string& name, const string& help, const Labels& labels)
+{
+	return Counter(getSeries(name, help, labels, true));
+}
+
+Metrics::Gauge binance::Metrics::getGauge(const string& name, const string& help, const Labels& labels)
+{
+	return Gauge(getSeries(name, help, labels, false));
+}
+
+void binance::Metrics::addCollector(const function<void()>& collector)
+{
+	Registry& registry = getRegistry();
+	lock_guard<mutex> guard(registry.lock);
+	registry.collectors.push_back(collector);
+}
+
+void binance::Metrics::countError(binanceError_t error)
+{
+	static Counter counters[binanceErrorUnknown + 1];
+	static once_flag once;
+	call_once(once, []()
+	{
+		for (int i = binanceSuccess + 1; i <= binanceErrorUnknown; i++)
+			counters[i] = getCounter("binance_rest_errors_total", "Failed REST requests, by error",
+				Labels(1, make_pair(string("error"), string(binanceGetErrorString((binanceError_t)i)))));
+	});
+
+	if ((error > binanceSuccess) && (error <= binanceErrorUnknown))
+		counters[error].add();
+}
+
+namespace
+{
+
+// Current value of every series, in the order of the families.
+struct Sample
+{
+	const Series* series;
+	const Family* family;
+	double value;
+};
+
+} // namespace
+
+static void collect(vector<Sample>& samples)
+{
+	Registry& registry = getRegistry();
+
+	vector<function<void()> > collectors;
+	{
+		lock_guard<mutex> guard(registry.lock);
+		collectors = registry.collectors;
+	}
+	for (size_t i = 0; i < collectors.size(); i++)
+		collectors[i]();
+
+	lock_guard<mutex> guard(registry.lock);
+
+	vector<uint64_t> counts(registry.exited);
+	for (size_t i = 0; i < registry.threads.size(); i++)
+		for (int j = 0; j < registry.counters; j++)
+			counts[j] += registry.threads[i]->cells[j].load(memory_order_relaxed);
+
+	// The registry only grows, so the pointers stay valid after unlocking.
+	for (map<string, Family>::const_iterator family = registry.families.begin();
+		family != registry.families.end(); family++)
+		for (size_t i = 0; i < family->second.series.size(); i++)
+		{
+			Sample sample;
+			sample.series = &registry.series[family->second.series[i]];
+			sample.family = &family->second;
+			sample.value = family->second.counter ? counts[sample.series->slot] :
+				registry.gaugeValues[sample.series->slot].load(memory_order_relaxed);
+			samples.push_back(sample);
+		}
+}
+
+string binance::Metrics::scrape()
+{
+	vector<Sample> samples;
+	collect(samples);
+
+	string result;
+	char value[64];
+	for (size_t i = 0; i < samples.size(); i++)
+	{
+		const Sample& sample = samples[i];
+		if (!i || (sample.family != samples[i - 1].family))
+		{
+			result += "# HELP " + sample.series->name + " " + sample.family->help + "\n";
+			result += "# TYPE " + sample.series->name + (sample.family->counter ? " counter\n" : " gauge\n");
+		}
+
+		result += sample.series->name;
+		if (!sample.series->labels.empty())
+			result += "{" + sample.series->labels + "}";
+		snprintf(value, sizeof(value), " %.17g\n", sample.value);
+		result += value;
+	}
+
+	return result;
+}
+
+static mutex http_lock;
+static thread http_thread;
+static atomic<bool> http_stop(true);
+
+static void serveHttp(int fd)
+{
+	while (!http_stop.load())
+	{
+		struct pollfd pfd = { fd, POLLIN, 0 };
+		if (poll(&pfd, 1, 200) <= 0)
+			continue;
+
+		const int client = accept(fd, NULL, NULL);
+		if (client < 0)
+			continue;
+
+		struct timeval timeout = { 1, 0 };
+		setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+		string request;
+		char buffer[1024];
+		while (request.find("\r\n\r\n") == string::npos && request.size() < 8192)
+		{
+			const ssize_t n = recv(client, buffer, sizeof(buffer), 0);
+			if (n <= 0)
+				break;
+			request.append(buffer, n);
+		}
+
+		string response;
+		if (request.compare(0, 4, "GET ") == 0)
+		{
+			const string body = Metrics::scrape();
+			response = "HTTP/1.1 200 OK\r\n"
+				"Content-Type: text/plain; version=0.0.4\r\n"
+				"Content-Length: " + to_string(body.size()) + "\r\n"
+				"Connection: close\r\n\r\n" + body;
+		}
+		else
+			response = "HTTP/1.1 405 Method Not Allowed\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+		for (size_t sent = 0; sent < response.size(); )
+		{
+			const ssize_t n = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+			if (n <= 0)
+				break;
+			sent += n;
+		}
+		close(client);
+	}
+
+	close(fd);
+}
+
+bool binance::Metrics::startHttp(int port, const string& address)
+{
+	stopHttp();
+
+	const int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+	{
+		BINANCE_LOG_ERROR(binanceLogGeneral, "<Metrics::startHttp> Error ! socket: %s", strerror(errno));
+		return false;
+	}
+
+	const int one = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	if ((inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) ||
+		bind(fd, (struct sockaddr*)&addr, sizeof(addr)) || listen(fd, 16))
+	{
+		BINANCE_LOG_ERROR(binanceLogGeneral, "<Metrics::startHttp> Error ! cannot listen on %s:%d: %s",
+			address.c_str(), port, strerror(errno));
+		close(fd);
+		return false;
+	}
+
+	lock_guard<mutex> guard(http_lock);
+	http_stop.store(false);
+	http_thread = thread(serveHttp, fd);
+
+	BINANCE_LOG_INFO(binanceLogGeneral, "<Metrics::startHttp> Serving metrics on %s:%d", address.c_str(), port);
+
+	return true;
+}
+
+void binance::Metrics::stopHttp()
+{
+	lock_guard<mutex> guard(http_lock);
+	http_stop.store(true);
+	if (http_thread.joinable())
+		http_thread.join();
+}
+
+static mutex statsd_lock;
+static condition_variable statsd_cond;
+static bool statsd_stop = true;
+static thread statsd_thread;
+
+// Lines of the series changed since the last push, in DogStatsD format.
+static void formatStatsd(const string& prefix, map<string, double>& pushed, vector<string>& lines)
+{
+	vector<Sample> samples;
+	collect(samples);
+
+	char value[64];
+	for (size_t i = 0; i < samples.size(); i++)
+	{
+		const Sample& sample = samples[i];
+		const string key = sample.series->name + "{" + sample.series->labels + "}";
+		double& last = pushed[key];
+
+		string line = prefix + sample.series->name;
+		if (sample.family->counter)
+		{
+			if (sample.value <= last)
+				continue;
+			snprintf(value, sizeof(value), ":%.17g|c", sample.value - last);
+		}
+		else
+			snprintf(value, sizeof(value), ":%.17g|g", sample.value);
+		line += value;
+		last = sample.value;
+
+		const Metrics::Labels& tags = sample.series->tags;
+		for (size_t j = 0; j < tags.size(); j++)
+		{
+			line += j ? "," : "|#";
+			line += tags[j].first + ":" + tags[j].second;
+		}
+
+		lines.push_back(line);
+	}
+}
+
+bool binance::Metrics::startStatsd(const string& host, int port, unsigned int period_sec, const string& prefix)
+{
+	stopStatsd();
+
+	struct addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	struct addrinfo* address = NULL;
+	const string service = to_string(port);
+	if (getaddrinfo(host.c_str(), service.c_str(), &hints, &address) || !address)
+	{
+		BINANCE_LOG_ERROR(binanceLogGeneral, "<Metrics::startStatsd> Error ! cannot resolve %s", host.c_str());
+		return false;
+	}
+
+	const int fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+	if ((fd < 0) || connect(fd, address->ai_addr, address->ai_addrlen))
+	{
+		BINANCE_LOG_ERROR(binanceLogGeneral, "<Metrics::startStatsd> Error ! cannot connect to %s:%d: %s",
+			host.c_str(), port, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		freeaddrinfo(address);
+		return false;
+	}
+	freeaddrinfo(address);
+
+	lock_guard<mutex> guard(statsd_lock);
+	statsd_stop = false;
+	statsd_thread = thread([](int fd, unsigned int period_sec, string prefix)
+	{
+		map<string, double> pushed;
+		unique_lock<mutex> lock(statsd_lock);
+		while (!statsd_cond.wait_for(lock, chrono::seconds(period_sec), [] { return statsd_stop; }))
+		{
+			lock.unlock();
+
+			vector<string> lines;
+			formatStatsd(prefix, pushed, lines);
+
+			// Keep the datagrams within a typical MTU.
+			string datagram;
+			for (size_t i = 0; i <= lines.size(); i++)
+			{
+				if (!datagram.empty() && ((i == lines.size()) || (datagram.size() + lines[i].size() + 1 > 1400)))
+				{
+					send(fd, datagram.data(), datagram.size(), 0);
+					datagram.clear();
+				}
+				if (i == lines.size())
+					break;
+				if (!datagram.empty())
+					datagram += '\n';
+				datagram += lines[i];
+			}
+
+			lock.lock();
+		}
+
+		close(fd);
+	},
+	fd, period_sec, prefix);
+
+	return true;
+}
+
+void binance::Metrics::stopStatsd()
+{
+	{
+		lock_guard<mutex> guard(statsd_lock);
+		statsd_stop = true;
+	}
+	statsd_cond.notify_all();
+
+	if (statsd_thread.joinable())
+		statsd_thread.join();
+}
+
+namespace
+{
+
+// Do not leave joinable threads behind at exit.
+class MetricsFinalize
+{
+public :
+
+	~MetricsFinalize()
+	{
+		Metrics::stopHttp();
+		Metrics::stopStatsd();
+	}
+};
+
+} // namespace
+
+static MetricsFinalize metricsFinalize;
+
@@ -0,0 +1,915 @@
+/*
+	C++ library for Binance API.
+*/
+
+#include "binance.h"
+#include "binance_klines.h"
+#include "binance_logger.h"
+#include "binance_mock.h"
+#include "binance_recorder.h"
+#include "binance_utils.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <libwebsockets.h>
+
+using namespace binance;
+using namespace std;
+
+static int mockHttpCb(struct lws *wsi, enum lws_callback_reasons reason, void *user, void *in, size_t len)
+{
+	MockServer* mock = static_cast<MockServer*>(lws_context_user(lws_get_context(wsi)));
+	if (!mock)
+		return lws_callback_http_dummy(wsi, reason, user, in, len);
+
+	return mock->onHttp(wsi, reason, in, len);
+}
+
+static int mockWebsocketCb(struct lws *wsi, enum lws_callback_reasons reason, void *user, void *in, size_t len)
+{
+	MockServer* mock = static_cast<MockServer*>(lws_context_user(lws_get_context(wsi)));
+	if (!mock)
+		return lws_callback_http_dummy(wsi, reason, user, in, len);
+
+	return mock->onWebsocket(wsi, reason, in, len);
+}
+
+// The websocket protocol is named as the one requested by binance::Websocket.
+static struct lws_protocols mockProtocols[] =
+{
+	{ "http", mockHttpCb, 0, 0 },
+	{ "binance-websocket-api", mockWebsocketCb, 0, 64 * 1024 },
+	{ NULL, NULL, 0, 0 }
+};
+
+static string toJson(const Json::Value& value)
+{
+	Json::StreamWriterBuilder builder;
+	builder["indentation"] = "";
+	return Json::writeString(builder, value);
+}
+
+static string getError(int code, const char* msg)
+{
+	Json::Value error;
+	error["code"] = code;
+	error["msg"] = msg;
+	return toJson(error);
+}
+
+static string urlDecode(const string& str)
+{
+	string result;
+	for (size_t i = 0; i < str.size(); i++)
+	{
+		if ((str[i] == '%') && (i + 2 < str.size()))
+		{
+			result += (char)strtol(str.substr(i + 1, 2).c_str(), NULL, 16);
+			i += 2;
+		}
+		else if (str[i] == '+')
+			result += ' ';
+		else
+			result += str[i];
+	}
+
+	return result;
+}
+
+static void parseParams(const string& str, map<string, string>& params)
+{
+	vector<string> pairs;
+	string s(str);
+	split_string(s, '&', pairs);
+	for (size_t i = 0; i < pairs.size(); i++)
+	{
+		const size_t eq = pairs[i].find('=');
+		if (eq == string::npos)
+			params[urlDecode(pairs[i])] = "";
+		else
+			params[urlDecode(pairs[i].substr(0, eq))] = urlDecode(pairs[i].substr(eq + 1));
+	}
+}
+
+static string getParam(const MockServer::Request& request, const char* name, const char* defaultValue = "")
+{
+	map<string, string>::const_iterator it = request.params.find(name);
+	return (it != request.params.end()) ? it->second : defaultValue;
+}
+
+binance::MockServer::MockServer() : context(NULL), running(false), port(0),
+	nextOrderId(1), nextUpdateId(1), nextListenKey(1)
+{
+	addDefaultHandlers();
+}
+
+binance::MockServer::~MockServer()
+{
+	stop();
+}
+
+bool binance::MockServer::start(int port_)
+{
+	stop();
+
+	struct lws_context_creation_info info;
+	memset(&info, 0, sizeof(info));
+	info.port = port_;
+	info.iface = "127.0.0.1";
+	info.protocols = mockProtocols;
+	info.gid = -1;
+	info.uid = -1;
+	info.user = this;
+	info.fd_limit_per_thread = 1024;
+	info.max_http_header_pool = 1024;
+
+	context = lws_create_context(&info);
+	if (!context)
+	{
+		BINANCE_LOG_ERROR(binanceLogGeneral, "<MockServer::start> Error ! cannot listen on port %d", port_);
+		return false;
+	}
+
+	// The actual port, if any free one was requested.
+	port = port_;
+	struct lws_vhost* vhost = lws_get_vhost_by_name(context, "default");
+	if (vhost)
+		port = lws_get_vhost_listen_port(vhost);
+
+	running = true;
+	service = thread(&MockServer::serve, this);
+
+	BINANCE_LOG_INFO(binanceLogGeneral, "<MockServer::start> Listening on %s", getUrl().c_str());
+
+	return true;
+}
+
+void binance::MockServer::stop()
+{
+	if (!context)
+		return;
+
+	running = false;
+	lws_cancel_service(context);
+	service.join();
+
+	lws_context_destroy(context);
+	context = NULL;
+
+	httpSessions.clear();
+	wsSessions.clear();
+
+	lock_guard<mutex> guard(lock);
+	pending.clear();
+	subscribers.clear();
+}
+
+void binance::MockServer::serve()
+{
+	while (running)
+		if (lws_service(context, 0) < 0)
+			break;
+}
+
+int binance::MockServer::getPort() const
+{
+	return port;
+}
+
+string binance::MockServer::getUrl() const
+{
+	return string("http://127.0.0.1:") + to_string(port);
+}
+
+void binance::MockServer::setHandler(const string& method, const string& path, Handler handler)
+{
+	lock_guard<mutex> guard(lock);
+	handlers[method + " " + path] = handler;
+}
+
+void binance::MockServer::setResponse(const string& method, const string& path, const string& body, int status)
+{
+	setHandler(method, path, [body, status](const Request&, string& response)
+	{
+		response = body;
+		return status;
+	});
+}
+
+void binance::MockServer::setPrice(const string& symbol, double price)
+{
+	lock_guard<mutex> guard(lock);
+	prices[symbol] = price;
+}
+
+void binance::MockServer::setBalance(const string& asset, double free, double locked)
+{
+	lock_guard<mutex> guard(lock);
+	balances[asset] = make_pair(free, locked);
+}
+
+double binance::MockServer::getPrice(const string& symbol)
+{
+	lock_guard<mutex> guard(lock);
+	map<string, double>::const_iterator it = prices.find(symbol);
+	return (it != prices.end()) ? it->second : 100.0;
+}
+
+void binance::MockServer::publish(const string& path, const string& frame)
+{
+	{
+		lock_guard<mutex> guard(lock);
+		pending.push_back(make_pair(path, frame));
+	}
+
+	if (context)
+		lws_cancel_service(context);
+}
+
+bool binance::MockServer::play(const string& filename, double speed)
+{
+	RecordReader reader;
+	if (!reader.open(filename))
+	{
+		BINANCE_LOG_ERROR(binanceLogGeneral, "<MockServer::play> Error ! cannot open %s", filename.c_str());
+		return false;
+	}
+
+	vector<string> paths;
+	const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	int64_t firstNs = -1;
+	RecordReader::Record record;
+	while (reader.next(record))
+	{
+		if (record.type == Recorder::StreamName)
+		{
+			if (paths.size() <= record.stream)
+				paths.resize(record.stream + 1);
+			paths[record.stream].assign(record.payload.begin(), record.payload.end());
+			continue;
+		}
+
+		if ((record.type != Recorder::Frame) || (record.stream >= paths.size()))
+			continue;
+
+		if (speed > 0)
+		{
+			if (firstNs < 0)
+				firstNs = record.timeNs;
+			const chrono::steady_clock::time_point due = start + chrono::nanoseconds((int64_t)((record.timeNs - firstNs) / speed));
+			if (due > chrono::steady_clock::now())
+				this_thread::sleep_until(due);
+		}
+
+		publish(paths[record.stream], string(record.payload.begin(), record.payload.end()));
+	}
+
+	return true;
+}
+
+size_t binance::MockServer::getSubscribers(const string& path) const
+{
+	lock_guard<mutex> guard(lock);
+	map<string, size_t>::const_iterator it = subscribers.find(path);
+	return (it != subscribers.end()) ? it->second : 0;
+}
+
+int binance::MockServer::handle(const Request& request, string& body)
+{
+	Handler handler;
+	{
+		lock_guard<mutex> guard(lock);
+		map<string, Handler>::const_iterator it = handlers.find(request.method + " " + request.path);
+		if (it != handlers.end())
+			handler = it->second;
+	}
+
+	if (!handler)
+	{
+		body = getError(-1000, "Unknown endpoint.");
+		return 404;
+	}
+
+	return handler(request, body);
+}
+
+void binance::MockServer::respond(lws* wsi, HttpSession& session)
+{
+	session.status = handle(session.request, session.response);
+
+	unsigned char buffer[LWS_PRE + 1024];
+	unsigned char* start = &buffer[LWS_PRE];
+	unsigned char* p = start;
+	unsigned char* end = &buffer[sizeof(buffer) - 1];
+	if (lws_add_http_common_headers(wsi, session.status, "application/json;charset=UTF-8",
+		session.response.size(), &p, end) ||
+		lws_finalize_write_http_header(wsi, start, &p, end))
+	{
+		BINANCE_LOG_ERROR(binanceLogGeneral, "<MockServer> Error ! cannot write the headers of %s", session.request.path.c_str());
+		return;
+	}
+
+	lws_callback_on_writable(wsi);
+}
+
+int binance::MockServer::onHttp(lws* wsi, int reason, void* in, size_t len)
+{
+	switch (reason)
+	{
+	case LWS_CALLBACK_HTTP :
+	{
+		HttpSession& session = httpSessions[wsi];
+		session = HttpSession();
+		session.request.path = static_cast<const char*>(in);
+
+		if (lws_hdr_total_length(wsi, WSI_TOKEN_POST_URI))
+			session.request.method = "POST";
+		else if (lws_hdr_total_length(wsi, WSI_TOKEN_PUT_URI))
+			session.request.method = "PUT";
+		else if (lws_hdr_total_length(wsi, WSI_TOKEN_DELETE_URI))
+			session.request.method = "DELETE";
+		else
+			session.request.method = "GET";
+
+		// Query arguments come url-decoded, one "name=value" per fragment.
+		char arg[1024];
+		for (int i = 0; lws_hdr_copy_fragment(wsi, arg, sizeof(arg), WSI_TOKEN_HTTP_URI_ARGS, i) > 0; i++)
+		{
+			const char* eq = strchr(arg, '=');
+			if (eq)
+				session.request.params[string(arg, eq - arg)] = eq + 1;
+			else
+				session.request.params[arg] = "";
+		}
+
+		// Signed requests carry their parameters in the form body.
+		char length[32] = "";
+		if (lws_hdr_total_length(wsi, WSI_TOKEN_HTTP_CONTENT_LENGTH) &&
+			(lws_hdr_copy(wsi, length, sizeof(length), WSI_TOKEN_HTTP_CONTENT_LENGTH) > 0) &&
+			(atol(length) > 0))
+			return 0;
+
+		respond(wsi, session);
+		return 0;
+	}
+
+	case LWS_CALLBACK_HTTP_BODY :
+		httpSessions[wsi].body.append(static_cast<const char*>(in), len);
+		return 0;
+
+	case LWS_CALLBACK_HTTP_BODY_COMPLETION :
+	{
+		HttpSession& session = httpSessions[wsi];
+		parseParams(session.body, session.request.params);
+		respond(wsi, session);
+		return 0;
+	}
+
+	case LWS_CALLBACK_HTTP_WRITEABLE :
+	{
+		unordered_map<lws*, HttpSession>::iterator it = httpSessions.find(wsi);
+		if (it == httpSessions.end())
+			return -1;
+
+		const string& response = it->second.response;
+		vector<unsigned char> buffer(LWS_PRE + response.size());
+		memcpy(&buffer[LWS_PRE], response.c_str(), response.size());
+		httpSessions.erase(it);
+		if (lws_write(wsi, &buffer[LWS_PRE], buffer.size() - LWS_PRE, LWS_WRITE_HTTP_FINAL) < 0)
+			return -1;
+
+		// Keep the connection alive for the next request.
+		if (lws_http_transaction_completed(wsi))
+			return -1;
+		return 0;
+	}
+
+	case LWS_CALLBACK_CLOSED_HTTP :
+		httpSessions.erase(wsi);
+		break;
+
+	default :
+		break;
+	}
+
+	return lws_callback_http_dummy(wsi, (enum lws_callback_reasons)reason, NULL, in, len);
+}
+
+int binance::MockServer::onWebsocket(lws* wsi, int reason, void* in, size_t len)
+{
+	switch (reason)
+	{
+	// The headers are still there while the upgrade is being accepted.
+	case LWS_CALLBACK_FILTER_PROTOCOL_CONNECTION :
+	{
+		char uri[1024] = "";
+		lws_hdr_copy(wsi, uri, sizeof(uri), WSI_TOKEN_GET_URI);
+		wsSessions[wsi].path = uri;
+		return 0;
+	}
+
+	case LWS_CALLBACK_ESTABLISHED :
+	{
+		lock_guard<mutex> guard(lock);
+		subscribers[wsSessions[wsi].path]++;
+		return 0;
+	}
+
+	case LWS_CALLBACK_CLOSED :
+	{
+		unordered_map<lws*, WsSession>::iterator it = wsSessions.find(wsi);
+		if (it == wsSessions.end())
+			return 0;
+
+		{
+			lock_guard<mutex> guard(lock);
+			if (subscribers[it->second.path] > 0)
+				subscribers[it->second.path]--;
+		}
+		wsSessions.erase(it);
+		return 0;
+	}
+
+	// Woken up by publish().
+	case LWS_CALLBACK_EVENT_WAIT_CANCELLED :
+	{
+		vector<pair<string, string> > frames;
+		{
+			lock_guard<mutex> guard(lock);
+			frames.swap(pending);
+		}
+
+		for (size_t i = 0; i < frames.size(); i++)
+			for (unordered_map<lws*, WsSession>::iterator it = wsSessions.begin(); it != wsSessions.end(); it++)
+				if (it->second.path == frames[i].first)
+				{
+					// A client that does not keep up loses the oldest frames.
+					if (it->second.queue.size() >= 65536)
+						it->second.queue.pop_front();
+					it->second.queue.push_back(frames[i].second);
+					lws_callback_on_writable(it->first);
+				}
+		return 0;
+	}
+
+	case LWS_CALLBACK_SERVER_WRITEABLE :
+	{
+		unordered_map<lws*, WsSession>::iterator it = wsSessions.find(wsi);
+		if ((it == wsSessions.end()) || it->second.queue.empty())
+			return 0;
+
+		const string& frame = it->second.queue.front();
+		vector<unsigned char> buffer(LWS_PRE + frame.size());
+		memcpy(&buffer[LWS_PRE], frame.c_str(), frame.size());
+		it->second.queue.pop_front();
+		if (lws_write(wsi, &buffer[LWS_PRE], buffer.size() - LWS_PRE, LWS_WRITE_TEXT) < 0)
+			return -1;
+
+		if (!it->second.queue.empty())
+			lws_callback_on_writable(wsi);
+		return 0;
+	}
+
+	default :
+		break;
+	}
+
+	return 0;
+}
+
+MockServer::Order* binance::MockServer::findOrder(const Request& request)
+{
+	const string orderId = getParam(request, "orderId");
+	if (!orderId.empty())
+	{
+		map<long, Order>::iterator it = orders.find(atol(orderId.c_str()));
+		return (it != orders.end()) ? &it->second : NULL;
+	}
+
+	const string clientOrderId = getParam(request, "origClientOrderId");
+	for (map<long, Order>::iterator it = orders.begin(); it != orders.end(); it++)
+		if (it->second.json["clientOrderId"].asString() == clientOrderId)
+			return &it->second;
+
+	return NULL;
+}
+
+void binance::MockServer::addDefaultHandlers()
+{
+	handlers["GET /api/v3/ping"] = [](const Request&, string& body)
+	{
+		body = "{}";
+		return 200;
+	};
+
+	handlers["GET /api/v3/time"] = [](const Request&, string& body)
+	{
+		Json::Value result;
+		result["serverTime"] = (Json::UInt64)get_local_ms_epoch();
+		body = toJson(result);
+		return 200;
+	};
+
+	handlers["GET /api/v3/exchangeInfo"] = [this](const Request&, string& body)
+	{
+		Json::Value result;
+		result["timezone"] = "UTC";
+		result["serverTime"] = (Json::UInt64)get_local_ms_epoch();
+
+		const struct { const char* type; const char* interval; int num; int limit; } limits[] =
+		{
+			{ "REQUEST_WEIGHT", "MINUTE", 1, 1200 },
+			{ "ORDERS", "SECOND", 10, 50 },
+			{ "ORDERS", "DAY", 1, 160000 },
+			{ "RAW_REQUESTS", "MINUTE", 5, 6100 },
+		};
+		result["rateLimits"] = Json::Value(Json::arrayValue);
+		for (size_t i = 0; i < sizeof(limits) / sizeof(limits[0]); i++)
+		{
+			Json::Value limit;
+			limit["rateLimitType"] = limits[i].type;
+			limit["interval"] = limits[i].interval;
+			limit["intervalNum"] = limits[i].num;
+			limit["limit"] = limits[i].limit;
+			result["rateLimits"].append(limit);
+		}
+
+		vector<string> symbols;
+		{
+			lock_guard<mutex> guard(lock);
+			for (map<string, double>::const_iterator it = prices.begin(); it != prices.end(); it++)
+				symbols.push_back(it->first);
+		}
+		if (symbols.empty())
+			symbols.push_back("BTCUSDT");
+
+		result["symbols"] = Json::Value(Json::arrayValue);
+		for (size_t i = 0; i < symbols.size(); i++)
+		{
+			const string& symbol = symbols[i];
+			const size_t quote = (symbol.size() > 4) ? symbol.size() - 4 : symbol.size();
+
+			Json::Value info;
+			info["symbol"] = symbol;
+			info["status"] = "TRADING";
+			info["baseAsset"] = symbol.substr(0, quote);
+			info["baseAssetPrecision"] = 8;
+			info["quoteAsset"] = symbol.substr(quote);
+			info["quotePrecision"] = 8;
+			info["baseCommissionPrecision"] = 8;
+			info["quoteCommissionPrecision"] = 8;
+
+			Json::Value priceFilter;
+			priceFilter["filterType"] = "PRICE_FILTER";
+			priceFilter["minPrice"] = "0.01000000";
+			priceFilter["maxPrice"] = "1000000.00000000";
+			priceFilter["tickSize"] = "0.01000000";
+			info["filters"].append(priceFilter);
+
+			Json::Value lotSize;
+			lotSize["filterType"] = "LOT_SIZE";
+			lotSize["minQty"] = "0.00001000";
+			lotSize["maxQty"] = "9000.00000000";
+			lotSize["stepSize"] = "0.00001000";
+			info["filters"].append(lotSize);
+
+			Json::Value minNotional;
+			minNotional["filterType"] = "MIN_NOTIONAL";
+			minNotional["minNotional"] = "10.00000000";
+			info["filters"].append(minNotional);
+
+			result["symbols"].append(info);
+		}
+
+		body = toJson(result);
+		return 200;
+	};
+
+	// Flat book of one lot per level, one tick apart around the price.
+	handlers["GET /api/v3/depth"] = [this](const Request& request, string& body)
+	{
+		const double price = getPrice(getParam(request, "symbol"));
+		const int limit = min(max(atoi(getParam(request, "limit", "100").c_str()), 1), 5000);
+
+		Json::Value result;
+		{
+			lock_guard<mutex> guard(lock);
+			result["lastUpdateId"] = (Json::Int64)nextUpdateId++;
+		}
+		result["bids"] = Json::Value(Json::arrayValue);
+		result["asks"] = Json::Value(Json::arrayValue);
+		for (int i = 0; i < limit; i++)
+		{
+			Json::Value bid(Json::arrayValue), ask(Json::arrayValue);
+			bid.append(toString(price - 0.01 * (i + 1), 2));
+			bid.append("1.00000000");
+			ask.append(toString(price + 0.01 * (i + 1), 2));
+			ask.append("1.00000000");
+			result["bids"].append(bid);
+			result["asks"].append(ask);
+		}
+
+		body = toJson(result);
+		return 200;
+	};
+
+	handlers["GET /api/v3/ticker/price"] = [this](const Request& request, string& body)
+	{
+		Json::Value result;
+		const string symbol = getParam(request, "symbol");
+		result["symbol"] = symbol.empty() ? "BTCUSDT" : symbol;
+		result["price"] = toString(getPrice(result["symbol"].asString()), 8);
+		if (symbol.empty())
+		{
+			Json::Value all(Json::arrayValue);
+			all.append(result);
+			result = all;
+		}
+
+		body = toJson(result);
+		return 200;
+	};
+
+	handlers["GET /api/v3/ticker/bookTicker"] = [this](const Request& request, string& body)
+	{
+		Json::Value result;
+		const string symbol = getParam(request, "symbol");
+		const double price = getPrice(symbol.empty() ? "BTCUSDT" : symbol);
+		result["symbol"] = symbol.empty() ? "BTCUSDT" : symbol;
+		result["bidPrice"] = toString(price - 0.01, 8);
+		result["bidQty"] = "1.00000000";
+		result["askPrice"] = toString(price + 0.01, 8);
+		result["askQty"] = "1.00000000";
+		if (symbol.empty())
+		{
+			Json::Value all(Json::arrayValue);
+			all.append(result);
+			result = all;
+		}
+
+		body = toJson(result);
+		return 200;
+	};
+
+	handlers["GET /api/v3/ticker/24hr"] = [this](const Request& request, string& body)
+	{
+		const string symbol = getParam(request, "symbol", "BTCUSDT");
+		const double price = getPrice(symbol);
+
+		Json::Value result;
+		result["symbol"] = symbol;
+		result["priceChange"] = "0.00000000";
+		result["priceChangePercent"] = "0.000";
+		result["lastPrice"] = toString(price, 8);
+		result["bidPrice"] = toString(price - 0.01, 8);
+		result["bidQty"] = "1.00000000";
+		result["askPrice"] = toString(price + 0.01, 8);
+		result["askQty"] = "1.00000000";
+		result["highPrice"] = toString(price, 8);
+		result["lowPrice"] = toString(price, 8);
+		result["volume"] = "0.00000000";
+		result["quoteVolume"] = "0.00000000";
+
+		body = toJson(result);
+		return 200;
+	};
+
+	// Flat candles over the requested range.
+	handlers["GET /api/v3/klines"] = [this](const Request& request, string& body)
+	{
+		const long long intervalMs = KlineDownloader::getIntervalMs(getParam(request, "interval").c_str());
+		if (!intervalMs)
+		{
+			body = getError(-1120, "Invalid interval.");
+			return 400;
+		}
+
+		const int limit = min(max(atoi(getParam(request, "limit", "500").c_str()), 1), 1000);
+		long long endTime = atoll(getParam(request, "endTime", "0").c_str());
+		if (!endTime)
+			endTime = get_local_ms_epoch();
+		long long startTime = atoll(getParam(request, "startTime", "0").c_str());
+		if (!startTime)
+			startTime = endTime - (limit - 1) * intervalMs;
+		startTime = (startTime + intervalMs - 1) / intervalMs * intervalMs;
+
+		const string price = toString(getPrice(getParam(request, "symbol")), 8);
+		Json::Value result(Json::arrayValue);
+		for (long long t = startTime; (t <= endTime) && ((int)result.size() < limit); t += intervalMs)
+		{
+			Json::Value kline(Json::arrayValue);
+			kline.append((Json::Int64)t);
+			kline.append(price);
+			kline.append(price);
+			kline.append(price);
+			kline.append(price);
+			kline.append("1.00000000");
+			kline.append((Json::Int64)(t + intervalMs - 1));
+			kline.append(price);
+			kline.append(1);
+			kline.append("0.50000000");
+			kline.append("0.00000000");
+			kline.append("0");
+			result.append(kline);
+		}
+
+		body = toJson(result);
+		return 200;
+	};
+
+	// One trade every 100 ms since the epoch, id by id.
+	handlers["GET /api/v3/aggTrades"] = [this](const Request& request, string& body)
+	{
+		const int limit = min(max(atoi(getParam(request, "limit", "500").c_str()), 1), 1000);
+		const long long now = get_local_ms_epoch();
+		long long fromId = atoll(getParam(request, "fromId", "-1").c_str());
+		long long lastId = now / 100;
+		if (fromId < 0)
+		{
+			const long long startTime = atoll(getParam(request, "startTime", "0").c_str());
+			const long long endTime = atoll(getParam(request, "endTime", "0").c_str());
+			fromId = startTime ? (startTime + 99) / 100 : lastId - limit + 1;
+			if (endTime)
+				lastId = min(lastId, endTime / 100);
+		}
+
+		const string price = toString(getPrice(getParam(request, "symbol")), 8);
+		Json::Value result(Json::arrayValue);
+		for (long long id = fromId; (id <= lastId) && ((int)result.size() < limit); id++)
+		{
+			Json::Value trade;
+			trade["a"] = (Json::Int64)id;
+			trade["p"] = price;
+			trade["q"] = "1.00000000";
+			trade["f"] = (Json::Int64)id;
+			trade["l"] = (Json::Int64)id;
+			trade["T"] = (Json::Int64)(id * 100);
+			trade["m"] = (id % 2 == 0);
+			trade["M"] = true;
+			result.append(trade);
+		}
+
+		body = toJson(result);
+		return 200;
+	};
+
+	handlers["GET /api/v3/account"] = [this](const Request&, string& body)
+	{
+		Json::Value result;
+		result["makerCommission"] = 10;
+		result["takerCommission"] = 10;
+		result["canTrade"] = true;
+		result["canWithdraw"] = true;
+		result["canDeposit"] = true;
+		result["updateTime"] = (Json::UInt64)get_local_ms_epoch();
+		result["accountType"] = "SPOT";
+		result["balances"] = Json::Value(Json::arrayValue);
+
+		lock_guard<mutex> guard(lock);
+		for (map<string, pair<double, double> >::const_iterator it = balances.begin(); it != balances.end(); it++)
+		{
+			Json::Value balance;
+			balance["asset"] = it->first;
+			balance["free"] = toString(it->second.first, 8);
+			balance["locked"] = toString(it->second.second, 8);
+			result["balances"].append(balance);
+		}
+
+		body = toJson(result);
+		return 200;
+	};
+
+	// Orders are accepted and stored, market ones are filled right away at the price.
+	Handler newOrder = [this](const Request& request, string& body)
+	{
+		const string symbol = getParam(request, "symbol");
+		const string type = getParam(request, "type");
+		if (symbol.empty() || type.empty() || getParam(request, "side").empty())
+		{
+			body = getError(-1102, "Mandatory parameter was not sent, was empty/null, or malformed.");
+			return 400;
+		}
+
+		const double price = getPrice(symbol);
+		const bool market = (type == "MARKET");
+
+		lock_guard<mutex> guard(lock);
+		const long orderId = nextOrderId++;
+		Json::Value order;
+		order["symbol"] = symbol;
+		order["orderId"] = (Json::Int64)orderId;
+		order["orderListId"] = -1;
+		order["clientOrderId"] = getParam(request, "newClientOrderId", ("mock-" + to_string(orderId)).c_str());
+		order["transactTime"] = (Json::UInt64)get_local_ms_epoch();
+		order["price"] = market ? "0.00000000" : getParam(request, "price");
+		order["origQty"] = getParam(request, "quantity");
+		order["executedQty"] = market ? getParam(request, "quantity") : "0.00000000";
+		order["cummulativeQuoteQty"] = market ?
+			toString(atof(getParam(request, "quantity").c_str()) * price, 8) : "0.00000000";
+		order["status"] = market ? "FILLED" : "NEW";
+		order["timeInForce"] = getParam(request, "timeInForce", "GTC");
+		order["type"] = type;
+		order["side"] = getParam(request, "side");
+
+		Order& stored = orders[orderId];
+		stored.json = order;
+		stored.open = !market;
+
+		body = toJson(order);
+		return 200;
+	};
+	handlers["POST /api/v3/order"] = newOrder;
+
+	handlers["POST /api/v3/order/test"] = [](const Request&, string& body)
+	{
+		body = "{}";
+		return 200;
+	};
+
+	handlers["GET /api/v3/order"] = [this](const Request& request, string& body)
+	{
+		lock_guard<mutex> guard(lock);
+		Order* order = findOrder(request);
+		if (!order)
+		{
+			body = getError(-2013, "Order does not exist.");
+			return 400;
+		}
+
+		body = toJson(order->json);
+		return 200;
+	};
+
+	handlers["DELETE /api/v3/order"] = [this](const Request& request, string& body)
+	{
+		lock_guard<mutex> guard(lock);
+		Order* order = findOrder(request);
+		if (!order || !order->open)
+		{
+			body = getError(-2011, "Unknown order sent.");
+			return 400;
+		}
+
+		order->open = false;
+		order->json["status"] = "CANCELED";
+		body = toJson(order->json);
+		return 200;
+	};
+
+	handlers["GET /api/v3/openOrders"] = [this](const Request& request, string& body)
+	{
+		const string symbol = getParam(request, "symbol");
+		Json::Value result(Json::arrayValue);
+
+		lock_guard<mutex> guard(lock);
+		for (map<long, Order>::const_iterator it = orders.begin(); it != orders.end(); it++)
+			if (it->second.open && (symbol.empty() || (it->second.json["symbol"].asString() == symbol)))
+				result.append(it->second.json);
+
+		body = toJson(result);
+		return 200;
+	};
+
+	handlers["GET /api/v3/allOrders"] = [this](const Request& request, string& body)
+	{
+		const string symbol = getParam(request, "symbol");
+		const long fromId = atol(getParam(request, "orderId", "0").c_str());
+		Json::Value result(Json::arrayValue);
+
+		lock_guard<mutex> guard(lock);
+		for (map<long, Order>::const_iterator it = orders.lower_bound(fromId); it != orders.end(); it++)
+			if (it->second.json["symbol"].asString() == symbol)
+				result.append(it->second.json);
+
+		body = toJson(result);
+		return 200;
+	};
+
+	handlers["GET /api/v3/myTrades"] = [](const Request&, string& body)
+	{
+		body = "[]";
+		return 200;
+	};
+
+	handlers["POST /api/v3/userDataStream"] = [this](const Request&, string& body)
+	{
+		Json::Value result;
+		{
+			lock_guard<mutex> guard(lock);
+			result["listenKey"] = "mock-listen-key-" + to_string(nextListenKey++);
+		}
+
+		body = toJson(result);
+		return 200;
+	};
+
+	handlers["PUT /api/v3/userDataStream"] = [](const Request&, string& body)
+	{
+		body = "{}";
+		return 200;
+	};
+
+	handlers["DELETE /api/v3/userDataStream"] = handlers["PUT /api/v3/userDataStream"];
+}
+
@@ -0,0 +1,313 @@
+/*
+	C++ library for Binance API.
+*/
+
+#include "binance_order_tracker.h"
+#include "binance_logger.h"
+
+#include <cstdlib>
+
+using namespace binance;
+using namespace std;
+
+binance::OrderTracker::Order::Order() : orderId(0), price(0), origQty(0), stopPrice(0),
+	executedQty(0), cummulativeQuoteQty(0), updateTime(0) { }
+
+binance::OrderTracker::Balance::Balance() : free(0), locked(0) { }
+
+binance::OrderTracker::OrderTracker() : balancesTime(0), reconciling(false) { }
+
+static double toDouble(const Json::Value &value)
+{
+	return atof(value.asString().c_str());
+}
+
+// Orders in any other state will never change again.
+static bool isOpen(const string &status)
+{
+	return (status == "NEW") || (status == "PARTIALLY_FILLED") || (status == "PENDING_CANCEL");
+}
+
+int binance::OrderTracker::onUserData(const Json::Value &json_value)
+{
+	if (!json_value.isObject())
+		return 0;
+
+	lock_guard<mutex> guard(lock);
+
+	if (reconciling)
+		pending.push_back(json_value);
+	else
+		apply(json_value);
+
+	return 0;
+}
+
+void binance::OrderTracker::apply(const Json::Value &json_value)
+{
+	const string event = json_value["e"].asString();
+
+	if (event == "executionReport")
+		onExecutionReport(json_value);
+	else if (event == "outboundAccountPosition")
+		onAccountPosition(json_value);
+	else if (event == "balanceUpdate")
+		onBalanceUpdate(json_value);
+}
+
+void binance::OrderTracker::endReconcile()
+{
+	for (size_t i = 0; i < pending.size(); i++)
+		apply(pending[i]);
+
+	pending.clear();
+	reconciling = false;
+}
+
+void binance::OrderTracker::eraseOrder(long orderId)
+{
+	unordered_map<long, Order>::iterator it = orders.find(orderId);
+	if (it == orders.end())
+		return;
+
+	clientOrderIds.erase(it->second.clientOrderId);
+	orders.erase(it);
+}
+
+// Execution report event
+//
+// Name	Description
+// s	Symbol
+// c	Client order ID
+// S	Side
+// o	Order type
+// f	Time in force
+// q	Order quantity
+// p	Order price
+// P	Stop price
+// C	Original client order ID; This is the ID of the order being canceled
+// X	Current order status
+// i	Order ID
+// z	Cumulative filled quantity
+// Z	Cumulative quote asset transacted quantity
+// T	Transaction time
+//
+void binance::OrderTracker::onExecutionReport(const Json::Value &json_value)
+{
+	const long orderId = json_value["i"].asInt64();
+	const long long updateTime = json_value["T"].asInt64();
+	const string status = json_value["X"].asString();
+
+	unordered_map<long, Order>::iterator it = orders.find(orderId);
+
+	// The events held back during reconcile() may be older than
+	// the REST snapshot, so never step an order back in time.
+	if ((it != orders.end()) && (it->second.updateTime > updateTime))
+		return;
+
+	if (!isOpen(status))
+	{
+		eraseOrder(orderId);
+		BINANCE_LOG_DEBUG(binanceLogAccount, "<OrderTracker> order %ld %s", orderId, status.c_str());
+		return;
+	}
+
+	Order& order = orders[orderId];
+	order.symbol = json_value["s"].asString();
+	order.orderId = orderId;
+
+	// For cancels "c" is the id of the cancel request itself.
+	string clientOrderId = json_value["C"].asString();
+	if (clientOrderId.empty())
+		clientOrderId = json_value["c"].asString();
+	if (order.clientOrderId != clientOrderId)
+	{
+		clientOrderIds.erase(order.clientOrderId);
+		order.clientOrderId = clientOrderId;
+		clientOrderIds[clientOrderId] = orderId;
+	}
+
+	order.side = json_value["S"].asString();
+	order.type = json_value["o"].asString();
+	order.timeInForce = json_value["f"].asString();
+	order.status = status;
+	order.price = toDouble(json_value["p"]);
+	order.origQty = toDouble(json_value["q"]);
+	order.stopPrice = toDouble(json_value["P"]);
+	order.executedQty = toDouble(json_value["z"]);
+	order.cummulativeQuoteQty = toDouble(json_value["Z"]);
+	order.updateTime = updateTime;
+}
+
+// Account update event
+//
+// Name	Description
+// u	Time of last account update
+// B	Balances array of {"a": asset, "f": free, "l": locked}
+//
+void binance::OrderTracker::onAccountPosition(const Json::Value &json_value)
+{
+	// Already in the snapshot taken by reconcile().
+	if (json_value["u"].asInt64() < balancesTime)
+		return;
+
+	const Json::Value &json_balances = json_value["B"];
+	for (Json::Value::ArrayIndex i = 0; i < json_balances.size(); i++)
+	{
+		Balance& balance = balances[json_balances[i]["a"].asString()];
+		balance.free = toDouble(json_balances[i]["f"]);
+		balance.locked = toDouble(json_balances[i]["l"]);
+	}
+}
+
+// Balance update event (deposits, withdrawals, transfers)
+//
+// Name	Description
+// a	Asset
+// d	Balance delta
+// T	Clear time
+//
+void binance::OrderTracker::onBalanceUpdate(const Json::Value &json_value)
+{
+	if (json_value["T"].asInt64() <= balancesTime)
+		return;
+
+	balances[json_value["a"].asString()].free += toDouble(json_value["d"]);
+}
+
+binanceError_t binance::OrderTracker::reconcile(Account &account, long recvWindow)
+{
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<OrderTracker::reconcile>");
+
+	{
+		lock_guard<mutex> guard(lock);
+		reconciling = true;
+	}
+
+	Json::Value json_orders;
+	binanceError_t status = account.getOpenOrders(json_orders, recvWindow);
+
+	Json::Value json_account;
+	if (status == binanceSuccess)
+		status = account.getInfo(json_account, recvWindow);
+
+	lock_guard<mutex> guard(lock);
+
+	if (status != binanceSuccess)
+	{
+		endReconcile();
+		return status;
+	}
+
+	orders.clear();
+	clientOrderIds.clear();
+	for (Json::Value::ArrayIndex i = 0; i < json_orders.size(); i++)
+	{
+		const Json::Value &json_order = json_orders[i];
+
+		Order order;
+		order.symbol = json_order["symbol"].asString();
+		order.orderId = json_order["orderId"].asInt64();
+		order.clientOrderId = json_order["clientOrderId"].asString();
+		order.side = json_order["side"].asString();
+		order.type = json_order["type"].asString();
+		order.timeInForce = json_order["timeInForce"].asString();
+		order.status = json_order["status"].asString();
+		order.price = toDouble(json_order["price"]);
+		order.origQty = toDouble(json_order["origQty"]);
+		order.stopPrice = toDouble(json_order["stopPrice"]);
+		order.executedQty = toDouble(json_order["executedQty"]);
+		order.cummulativeQuoteQty = toDouble(json_order["cummulativeQuoteQty"]);
+		order.updateTime = json_order["updateTime"].asInt64();
+
+		if (!isOpen(order.status))
+			continue;
+
+		clientOrderIds[order.clientOrderId] = order.orderId;
+		orders[order.orderId] = order;
+	}
+
+	balances.clear();
+	balancesTime = json_account["updateTime"].asInt64();
+	const Json::Value &json_balances = json_account["balances"];
+	for (Json::Value::ArrayIndex i = 0; i < json_balances.size(); i++)
+	{
+		Balance& balance = balances[json_balances[i]["asset"].asString()];
+		balance.free = toDouble(json_balances[i]["free"]);
+		balance.locked = toDouble(json_balances[i]["locked"]);
+	}
+
+	endReconcile();
+
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<OrderTracker::reconcile> Done, %zu open orders.", orders.size());
+
+	return binanceSuccess;
+}
+
+bool binance::OrderTracker::getOrder(long orderId, Order &order) const
+{
+	lock_guard<mutex> guard(lock);
+
+	unordered_map<long, Order>::const_iterator it = orders.find(orderId);
+	if (it == orders.end())
+		return false;
+
+	order = it->second;
+	return true;
+}
+
+bool binance::OrderTracker::getOrder(const string &clientOrderId, Order &order) const
+{
+	lock_guard<mutex> guard(lock);
+
+	unordered_map<string, long>::const_iterator id = clientOrderIds.find(clientOrderId);
+	if (id == clientOrderIds.end())
+		return false;
+
+	unordered_map<long, Order>::const_iterator it = orders.find(id->second);
+	if (it == orders.end())
+		return false;
+
+	order = it->second;
+	return true;
+}
+
+void binance::OrderTracker::getOpenOrders(vector<Order> &result, const char *symbol) const
+{
+	lock_guard<mutex> guard(lock);
+
+	result.clear();
+	for (unordered_map<long, Order>::const_iterator it = orders.begin(); it != orders.end(); it++)
+		if (!symbol || (it->second.symbol == symbol))
+			result.push_back(it->second);
+}
+
+bool binance::OrderTracker::getBalance(const string &asset, Balance &balance) const
+{
+	lock_guard<mutex> guard(lock);
+
+	map<string, Balance>::const_iterator it = balances.find(asset);
+	if (it == balances.end())
+		return false;
+
+	balance = it->second;
+	return true;
+}
+
+void binance::OrderTracker::getBalances(map<string, Balance> &result) const
+{
+	lock_guard<mutex> guard(lock);
+
+	result = balances;
+}
+
+void binance::OrderTracker::clear()
+{
+	lock_guard<mutex> guard(lock);
+
+	orders.clear();
+	clientOrderIds.clear();
+	balances.clear();
+	balancesTime = 0;
+}
+
@@ -0,0 +1,507 @@
+/*
+	C++ library for Binance API.
+*/
+
+#include "binance_ratelimit.h"
+#include "binance_logger.h"
+#include "binance_metrics.h"
+#include "binance_utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <strings.h>
+
+using namespace binance;
+using namespace std;
+
+// Endpoint weights, see "Limits" of the REST API documentation.
+// Endpoints with a weight depending on parameters are handled in getWeight().
+struct EndpointWeight
+{
+	const char* path;
+	const char* action;
+	int weight;
+};
+
+static const EndpointWeight endpointWeights[] =
+{
+	{ "/api/v3/ping", "GET", 1 },
+	{ "/api/v3/time", "GET", 1 },
+	{ "/api/v3/exchangeInfo", "GET", 20 },
+	{ "/api/v3/trades", "GET", 25 },
+	{ "/api/v3/historicalTrades", "GET", 25 },
+	{ "/api/v3/aggTrades", "GET", 2 },
+	{ "/api/v3/klines", "GET", 2 },
+	{ "/api/v3/order", "POST", 1 },
+	{ "/api/v3/order/test", "POST", 1 },
+	{ "/api/v3/order", "GET", 4 },
+	{ "/api/v3/order", "DELETE", 1 },
+	{ "/api/v3/allOrders", "GET", 20 },
+	{ "/api/v3/account", "GET", 20 },
+	{ "/api/v3/myTrades", "GET", 20 },
+	{ "/api/v3/userDataStream", "POST", 2 },
+	{ "/api/v3/userDataStream", "PUT", 2 },
+	{ "/api/v3/userDataStream", "DELETE", 2 },
+};
+
+static string getPath(const string& url)
+{
+	size_t begin = url.find("://");
+	begin = (begin == string::npos) ? 0 : begin + 3;
+	begin = url.find('/', begin);
+	if (begin == string::npos)
+		return "/";
+
+	return url.substr(begin, url.find('?', begin) - begin);
+}
+
+static string getHost(const string& url)
+{
+	size_t begin = url.find("://");
+	begin = (begin == string::npos) ? 0 : begin + 3;
+
+	return url.substr(begin, url.find('/', begin) - begin);
+}
+
+static bool hasParam(const string& url, const char* name, long* value = NULL)
+{
+	size_t query = url.find('?');
+	if (query == string::npos)
+		return false;
+
+	const string key = string(name) + "=";
+	for (size_t pos = query + 1; pos < url.size(); )
+	{
+		if (url.compare(pos, key.size(), key) == 0)
+		{
+			if (value)
+				*value = atol(url.c_str() + pos + key.size());
+			return true;
+		}
+
+		pos = url.find('&', pos);
+		if (pos == string::npos)
+			break;
+		pos++;
+	}
+
+	return false;
+}
+
+int binance::RateLimiter::getWeight(const string& url, const string& action)
+{
+	const string path = getPath(url);
+
+	if (path == "/api/v3/depth")
+	{
+		long limit = 100;
+		hasParam(url, "limit", &limit);
+		if (limit <= 100) return 5;
+		if (limit <= 500) return 25;
+		if (limit <= 1000) return 50;
+		return 250;
+	}
+
+	if (path == "/api/v3/ticker/24hr")
+		return hasParam(url, "symbol") ? 2 : 80;
+	if ((path == "/api/v3/ticker/price") || (path == "/api/v3/ticker/bookTicker"))
+		return hasParam(url, "symbol") ? 2 : 4;
+	if (path == "/api/v3/openOrders")
+		return hasParam(url, "symbol") ? 6 : 80;
+
+	for (size_t i = 0; i < sizeof(endpointWeights) / sizeof(endpointWeights[0]); i++)
+		if ((path == endpointWeights[i].path) && (action == endpointWeights[i].action))
+			return endpointWeights[i].weight;
+
+	return 1;
+}
+
+bool binance::RateLimiter::isOrder(const string& url, const string& action)
+{
+	return (action == "POST") && (getPath(url) == "/api/v3/order");
+}
+
+binanceRequestClass_t binance::RateLimiter::getClass(const string& url, const string& action)
+{
+	const string path = getPath(url);
+
+	// Order entry and cancels, including cancel-all, OCO and the other order lists.
+	if ((action != "GET") &&
+		((path.compare(0, 13, "/api/v3/order") == 0) || (path == "/api/v3/openOrders")))
+		return binanceRequestOrder;
+
+	if ((path == "/api/v3/historicalTrades") ||
+		(((path == "/api/v3/klines") || (path == "/api/v3/aggTrades")) &&
+		(hasParam(url, "startTime") || hasParam(url, "fromId"))))
+		return binanceRequestHistory;
+
+	// Everything signed or keyed is about the account.
+	if ((path == "/api/v3/account") || (path == "/api/v3/order") || (path == "/api/v3/openOrders") ||
+		(path == "/api/v3/allOrders") || (path == "/api/v3/myTrades") ||
+		(path == "/api/v3/userDataStream") || hasParam(url, "signature") ||
+		(path.compare(0, 6, "/wapi/") == 0) || (path.compare(0, 6, "/sapi/") == 0))
+		return binanceRequestAccount;
+
+	return binanceRequestMarketData;
+}
+
+static long getIntervalMs(long num, char letter)
+{
+	switch (toupper(letter))
+	{
+	case 'S' : return num * 1000;
+	case 'M' : return num * 60 * 1000;
+	case 'H' : return num * 60 * 60 * 1000;
+	case 'D' : return num * 24 * 60 * 60 * 1000;
+	}
+
+	return 0;
+}
+
+// X-MBX-USED-WEIGHT-(intervalNum)(intervalLetter): used
+// X-MBX-ORDER-COUNT-(intervalNum)(intervalLetter): count
+bool binance::RateLimiter::parseUsage(const char* header, size_t size, Usage& usage)
+{
+	static const char weight[] = "x-mbx-used-weight-";
+	static const char orders[] = "x-mbx-order-count-";
+
+	size_t pos;
+	if ((size > sizeof(weight) - 1) && !strncasecmp(header, weight, sizeof(weight) - 1))
+	{
+		usage.type = RequestWeight;
+		pos = sizeof(weight) - 1;
+	}
+	else if ((size > sizeof(orders) - 1) && !strncasecmp(header, orders, sizeof(orders) - 1))
+	{
+		usage.type = Orders;
+		pos = sizeof(orders) - 1;
+	}
+	else
+		return false;
+
+	const string line(header + pos, size - pos);
+	char* end = NULL;
+	const long num = strtol(line.c_str(), &end, 10);
+	if ((end == line.c_str()) || !*end)
+		return false;
+
+	usage.intervalMs = getIntervalMs(num, *end);
+	if (!usage.intervalMs || (*(end + 1) != ':'))
+		return false;
+
+	usage.used = atof(end + 2);
+	return true;
+}
+
+bool binance::RateLimiter::parseRetryAfter(const char* header, size_t size, int& retryAfter)
+{
+	static const char name[] = "retry-after:";
+
+	if ((size <= sizeof(name) - 1) || strncasecmp(header, name, sizeof(name) - 1))
+		return false;
+
+	retryAfter = atoi(string(header + sizeof(name) - 1, size - sizeof(name) + 1).c_str());
+	return true;
+}
+
+binance::RateLimiter::RateLimiter() : mode(Queue), bannedUntilMs(0), orderReserve(0.1)
+{
+	for (int i = 0; i < binanceRequestClassCount; i++)
+	{
+		waiting[i] = 0;
+		waitingShared[i] = 0;
+	}
+
+	// Defaults until setLimits() is called with the actual exchangeInfo.
+	const double now = get_monotonic_ms();
+	const Limit defaults[] =
+	{
+		{ RequestWeight, 60 * 1000, 1200, 1200, now },
+		{ Orders, 10 * 1000, 50, 50, now },
+		{ Orders, 24 * 60 * 60 * 1000, 160000, 160000, now },
+		{ RawRequests, 5 * 60 * 1000, 6100, 6100, now },
+	};
+
+	limits.assign(defaults, defaults + sizeof(defaults) / sizeof(defaults[0]));
+}
+
+RateLimiter& binance::RateLimiter::get(const string& url)
+{
+	static mutex instances_lock;
+	static map<string, unique_ptr<RateLimiter> > instances;
+
+	lock_guard<mutex> guard(instances_lock);
+
+	const string host = getHost(url);
+	unique_ptr<RateLimiter>& instance = instances[host];
+	if (!instance)
+	{
+		instance.reset(new RateLimiter());
+
+		RateLimiter* limiter = instance.get();
+		Metrics::addCollector([limiter, host]()
+		{
+			static const char* types[] = { "REQUEST_WEIGHT", "ORDERS", "RAW_REQUESTS" };
+
+			vector<Limit> limits;
+			limiter->getLimits(limits);
+			for (size_t i = 0; i < limits.size(); i++)
+			{
+				Metrics::Labels labels;
+				labels.push_back(make_pair(string("host"), host));
+				labels.push_back(make_pair(string("type"), string(types[limits[i].type])));
+				labels.push_back(make_pair(string("interval_ms"), to_string(limits[i].intervalMs)));
+				Metrics::getGauge("binance_rate_limit_used", "Budget of the rate limit in use", labels).set(
+					limits[i].limit - limits[i].tokens);
+				Metrics::getGauge("binance_rate_limit", "Rate limit of the exchange", labels).set(limits[i].limit);
+			}
+
+			lock_guard<mutex> guard(limiter->lock);
+			for (int i = 0; i < binanceRequestClassCount; i++)
+			{
+				Metrics::Labels labels;
+				labels.push_back(make_pair(string("host"), host));
+				labels.push_back(make_pair(string("class"), string(binanceGetRequestClassString((binanceRequestClass_t)i))));
+				Metrics::getGauge("binance_rate_limit_waiting", "Requests waiting for the rate limit budget",
+					labels).set(limiter->waiting[i]);
+			}
+		});
+	}
+
+	return *instance;
+}
+
+void binance::RateLimiter::refill(double nowMs)
+{
+	for (size_t i = 0; i < limits.size(); i++)
+	{
+		Limit& limit = limits[i];
+		limit.tokens = min(limit.limit, limit.tokens + (nowMs - limit.updatedMs) * limit.limit / limit.intervalMs);
+		limit.updatedMs = nowMs;
+	}
+}
+
+static double getCost(const RateLimiter::Limit& limit, int weight, bool order)
+{
+	double cost = 0;
+	switch (limit.type)
+	{
+	case RateLimiter::RequestWeight : cost = weight; break;
+	case RateLimiter::Orders : cost = order ? 1 : 0; break;
+	case RateLimiter::RawRequests : cost = 1; break;
+	}
+
+	// A request heavier than the whole limit is let through on a full bucket.
+	return min(cost, limit.limit);
+}
+
+double binance::RateLimiter::waitMs(int weight, bool order, binanceRequestClass_t requestClass, double nowMs, bool* shared) const
+{
+	double wait = bannedUntilMs - nowMs;
+	if (shared)
+		*shared = (wait > 0);
+	for (size_t i = 0; i < limits.size(); i++)
+	{
+		const Limit& limit = limits[i];
+		double reserve = 0;
+		if ((requestClass != binanceRequestOrder) && (limit.type != Orders))
+			reserve = limit.limit * orderReserve;
+		const double missing = min(getCost(limit, weight, order) + reserve, limit.limit) - limit.tokens;
+		if (missing > 0)
+		{
+			wait = max(wait, missing * limit.intervalMs / limit.limit);
+			if (shared && (limit.type != Orders))
+				*shared = true;
+		}
+	}
+
+	return wait;
+}
+
+bool binance::RateLimiter::hasPriorityWaiters(binanceRequestClass_t requestClass) const
+{
+	for (int i = 0; i < requestClass; i++)
+		if (waitingShared[i])
+			return true;
+
+	return false;
+}
+
+binanceError_t binance::RateLimiter::acquire(int weight, bool order, binanceRequestClass_t requestClass)
+{
+	unique_lock<mutex> guard(lock);
+
+	bool queued = false;
+	bool queuedShared = false;
+	while (1)
+	{
+		const double now = get_monotonic_ms();
+		refill(now);
+
+		bool shared = false;
+		double wait = waitMs(weight, order, requestClass, now, &shared);
+
+		// Only hold back the classes below for a budget they take from as well.
+		if (shared != queuedShared)
+		{
+			waitingShared[requestClass] += shared ? 1 : -1;
+			queuedShared = shared;
+		}
+
+		// Let the requests of higher priority go first.
+		if ((wait <= 0) && hasPriorityWaiters(requestClass))
+			wait = 1;
+
+		if (wait <= 0)
+			break;
+
+		if (mode == Shed)
+		{
+			BINANCE_LOG_INFO(binanceLogHttp, "<rate_limit> shedding request of weight %d", weight);
+			if (queued)
+				waiting[requestClass]--;
+			if (queuedShared)
+				waitingShared[requestClass]--;
+			return binanceErrorRateLimited;
+		}
+
+		if (!queued)
+		{
+			waiting[requestClass]++;
+			queued = true;
+		}
+
+		BINANCE_LOG_TRACE(binanceLogHttp, "<rate_limit> delaying request of weight %d by %.0f ms", weight, wait);
+		refilled.wait_for(guard, chrono::duration<double, milli>(wait));
+	}
+
+	if (queuedShared)
+		waitingShared[requestClass]--;
+
+	if (queued)
+	{
+		waiting[requestClass]--;
+		refilled.notify_all();
+	}
+
+	for (size_t i = 0; i < limits.size(); i++)
+		limits[i].tokens -= getCost(limits[i], weight, order);
+
+	return binanceSuccess;
+}
+
+bool binance::RateLimiter::tryAcquire(int weight, binanceRequestClass_t requestClass)
+{
+	lock_guard<mutex> guard(lock);
+
+	const double now = get_monotonic_ms();
+	refill(now);
+
+	if ((waitMs(weight, false, requestClass, now) > 0) || waiting[requestClass] || hasPriorityWaiters(requestClass))
+		return false;
+
+	for (size_t i = 0; i < limits.size(); i++)
+		limits[i].tokens -= getCost(limits[i], weight, false);
+
+	return true;
+}
+
+void binance::RateLimiter::update(const vector<Usage>& usage, long httpStatus, int retryAfter)
+{
+	lock_guard<mutex> guard(lock);
+
+	const double now = get_monotonic_ms();
+	refill(now);
+
+	// The exchange is the authority on the usage; only trust it
+	// when it is higher than ours, as it does not know about
+	// the requests still in flight.
+	for (size_t i = 0; i < usage.size(); i++)
+		for (size_t j = 0; j < limits.size(); j++)
+			if ((limits[j].type == usage[i].type) && (limits[j].intervalMs == usage[i].intervalMs))
+				limits[j].tokens = min(limits[j].tokens, limits[j].limit - usage[i].used);
+
+	// 429 means the limit is hit, 418 that the IP is banned for repeating it.
+	if ((httpStatus == 429) || (httpStatus == 418))
+	{
+		if (retryAfter <= 0)
+			retryAfter = (httpStatus == 418) ? 120 : 1;
+
+		bannedUntilMs = max(bannedUntilMs, now + retryAfter * 1000.0);
+		BINANCE_LOG_INFO(binanceLogHttp, "<rate_limit> HTTP %ld, backing off for %d s", httpStatus, retryAfter);
+	}
+}
+
+// "rateLimits":[{"rateLimitType":"REQUEST_WEIGHT","interval":"MINUTE","intervalNum":1,"limit":6000}, ...]
+void binance::RateLimiter::setLimits(const Json::Value& rateLimits)
+{
+	if (!rateLimits.isArray() || !rateLimits.size())
+		return;
+
+	lock_guard<mutex> guard(lock);
+
+	const double now = get_monotonic_ms();
+	refill(now);
+
+	vector<Limit> updated;
+	for (Json::Value::ArrayIndex i = 0; i < rateLimits.size(); i++)
+	{
+		const Json::Value& rateLimit = rateLimits[i];
+
+		Limit limit;
+		const string type = rateLimit["rateLimitType"].asString();
+		if (type == "REQUEST_WEIGHT")
+			limit.type = RequestWeight;
+		else if (type == "ORDERS")
+			limit.type = Orders;
+		else if (type == "RAW_REQUESTS")
+			limit.type = RawRequests;
+		else
+			continue;
+
+		limit.intervalMs = getIntervalMs(rateLimit["intervalNum"].asInt(), rateLimit["interval"].asString()[0]);
+		limit.limit = rateLimit["limit"].asDouble();
+		if ((limit.intervalMs <= 0) || (limit.limit <= 0))
+			continue;
+
+		// Keep the usage accounted so far.
+		limit.tokens = limit.limit;
+		for (size_t j = 0; j < limits.size(); j++)
+			if ((limits[j].type == limit.type) && (limits[j].intervalMs == limit.intervalMs))
+				limit.tokens = min(limit.limit, limit.limit - (limits[j].limit - limits[j].tokens));
+		limit.updatedMs = now;
+
+		updated.push_back(limit);
+	}
+
+	if (updated.empty())
+		return;
+
+	limits.swap(updated);
+	refilled.notify_all();
+}
+
+void binance::RateLimiter::setMode(Mode mode_)
+{
+	lock_guard<mutex> guard(lock);
+	mode = mode_;
+	refilled.notify_all();
+}
+
+void binance::RateLimiter::setOrderReserve(double fraction)
+{
+	lock_guard<mutex> guard(lock);
+	orderReserve = min(max(fraction, 0.0), 1.0);
+	refilled.notify_all();
+}
+
+void binance::RateLimiter::getLimits(vector<Limit>& result)
+{
+	lock_guard<mutex> guard(lock);
+	refill(get_monotonic_ms());
+	result = limits;
+}
+
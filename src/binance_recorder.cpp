@@ -0,0 +1,394 @@
+/*
+	C++ library for Binance API.
+*/
+
+#include "binance_recorder.h"
+#include "binance_logger.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <time.h>
+#include <unordered_map>
+#include <vector>
+#ifdef BINANCE_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace binance;
+using namespace std;
+
+const char binance::Recorder::magic[8] = { 'B', 'N', 'C', 'R', 'E', 'C', '1', '\n' };
+
+// Destination file, plain or gzip-compressed.
+class RecorderOutput
+{
+	FILE* fp;
+#ifdef BINANCE_WITH_ZLIB
+	gzFile gz;
+#endif
+
+public :
+
+	RecorderOutput() : fp(NULL)
+#ifdef BINANCE_WITH_ZLIB
+		, gz(NULL)
+#endif
+	{ }
+
+	bool open(const string& filename)
+	{
+		const bool compressed = (filename.size() > 3) && (filename.compare(filename.size() - 3, 3, ".gz") == 0);
+		if (compressed)
+		{
+#ifdef BINANCE_WITH_ZLIB
+			// Fastest level: the writer must keep up with the full market.
+			gz = gzopen(filename.c_str(), "wb1");
+			if (!gz)
+				return false;
+			gzbuffer(gz, 1 << 20);
+			return write(Recorder::magic, sizeof(Recorder::magic));
+#else
+			BINANCE_LOG_ERROR(binanceLogWs, "<Recorder::start> Error ! built without zlib, cannot write %s", filename.c_str());
+			return false;
+#endif
+		}
+
+		fp = fopen(filename.c_str(), "wb");
+		if (!fp)
+			return false;
+		setvbuf(fp, NULL, _IOFBF, 1 << 20);
+		return write(Recorder::magic, sizeof(Recorder::magic));
+	}
+
+	bool write(const char* data, size_t size)
+	{
+#ifdef BINANCE_WITH_ZLIB
+		if (gz)
+			return gzwrite(gz, data, size) == (int)size;
+#endif
+		return fwrite(data, 1, size, fp) == size;
+	}
+
+	void close()
+	{
+#ifdef BINANCE_WITH_ZLIB
+		if (gz)
+			gzclose(gz);
+		gz = NULL;
+#endif
+		if (fp)
+			fclose(fp);
+		fp = NULL;
+	}
+};
+
+// Single producer, single consumer ring of bytes. The producer is
+// the websocket service thread, the consumer is the writer thread,
+// which drains the bytes as they are, regardless of record boundaries.
+class RecorderState
+{
+public :
+
+	mutex control; // serializes start() and stop()
+	atomic<bool> active;
+	atomic<bool> userData;
+	atomic<int> producers;
+	atomic<unsigned> generation;
+	atomic<bool> stopping;
+	atomic<unsigned long long> dropped;
+
+	vector<char> ring;
+	uint64_t mask;
+	atomic<uint64_t> head; // written by the producer
+	atomic<uint64_t> tail; // written by the consumer
+
+	// Accessed by the producer only, or while there is none.
+	unordered_map<string, uint16_t> ids;
+
+	RecorderOutput output;
+	thread writer;
+
+	RecorderState() : active(false), userData(false), producers(0), generation(0), stopping(false), dropped(0), mask(0), head(0), tail(0) { }
+
+	void copy(uint64_t pos, const char* data, size_t size)
+	{
+		const size_t offset = pos & mask;
+		const size_t n = min(size, ring.size() - offset);
+		memcpy(&ring[offset], data, n);
+		memcpy(&ring[0], data + n, size - n);
+	}
+
+	bool push(Recorder::RecordType type, uint16_t id, int64_t timeNs, const char* data, size_t size)
+	{
+		const size_t length = Recorder::headerSize + size;
+		const uint64_t h = head.load(memory_order_relaxed);
+		if (ring.size() - (h - tail.load(memory_order_acquire)) < length)
+		{
+			dropped++;
+			return false;
+		}
+
+		char header[Recorder::headerSize];
+		const uint32_t size32 = size;
+		const uint16_t type16 = type;
+		memcpy(header, &size32, 4);
+		memcpy(header + 4, &type16, 2);
+		memcpy(header + 6, &id, 2);
+		memcpy(header + 8, &timeNs, 8);
+
+		copy(h, header, sizeof(header));
+		copy(h + sizeof(header), data, size);
+		head.store(h + length, memory_order_release);
+		return true;
+	}
+
+	void drain()
+	{
+		bool failed = false;
+		while (1)
+		{
+			const uint64_t t = tail.load(memory_order_relaxed);
+			const uint64_t h = head.load(memory_order_acquire);
+			if (h == t)
+			{
+				if (stopping)
+					break;
+				this_thread::sleep_for(chrono::milliseconds(1));
+				continue;
+			}
+
+			const size_t offset = t & mask;
+			const size_t n = min<uint64_t>(h - t, ring.size() - offset);
+			if (!output.write(&ring[offset], n) && !failed)
+			{
+				BINANCE_LOG_ERROR(binanceLogWs, "<Recorder> Error ! cannot write the log, frames are lost");
+				failed = true;
+			}
+			tail.store(t + n, memory_order_release);
+		}
+	}
+};
+
+static RecorderState& getRecorderState()
+{
+	// Leaked, as the websocket thread may still use it at exit.
+	static RecorderState* state = new RecorderState();
+	return *state;
+}
+
+static void stopRecorder(RecorderState& state)
+{
+	if (!state.writer.joinable())
+		return;
+
+	state.active = false;
+	while (state.producers.load())
+		this_thread::yield();
+
+	state.stopping = true;
+	state.writer.join();
+	state.output.close();
+
+	BINANCE_LOG_INFO(binanceLogWs, "<Recorder::stop> Done, %llu frames dropped.", state.dropped.load());
+}
+
+bool binance::Recorder::start(const string& filename, size_t ringSize, bool userData)
+{
+	RecorderState& state = getRecorderState();
+	lock_guard<mutex> guard(state.control);
+
+	stopRecorder(state);
+
+	if (!state.output.open(filename))
+	{
+		BINANCE_LOG_ERROR(binanceLogWs, "<Recorder::start> Error ! cannot open %s", filename.c_str());
+		state.output.close();
+		return false;
+	}
+
+	size_t size = 64 * 1024;
+	while (size < ringSize)
+		size <<= 1;
+	state.ring.assign(size, 0);
+	state.mask = size - 1;
+	state.head = 0;
+	state.tail = 0;
+	state.ids.clear();
+	state.dropped = 0;
+	state.stopping = false;
+	state.generation++;
+	state.writer = thread(&RecorderState::drain, &state);
+	state.userData = userData;
+	state.active = true;
+
+	BINANCE_LOG_INFO(binanceLogWs, "<Recorder::start> Recording to %s", filename.c_str());
+
+	return true;
+}
+
+void binance::Recorder::stop()
+{
+	RecorderState& state = getRecorderState();
+	lock_guard<mutex> guard(state.control);
+
+	stopRecorder(state);
+}
+
+bool binance::Recorder::isRecording()
+{
+	return getRecorderState().active.load();
+}
+
+bool binance::Recorder::isRecordingUserData()
+{
+	return getRecorderState().userData.load();
+}
+
+unsigned long long binance::Recorder::getDropped()
+{
+	return getRecorderState().dropped.load();
+}
+
+int64_t binance::Recorder::now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void binance::Recorder::record(Stream& stream, const string& path, const char* data, size_t size, int64_t timeNs)
+{
+	RecorderState& state = getRecorderState();
+	if (!state.active.load(memory_order_relaxed))
+		return;
+
+	// Announce the producer, then make sure stop() has not started meanwhile.
+	state.producers++;
+	if (!state.active.load())
+	{
+		state.producers--;
+		return;
+	}
+
+	// Declare the stream once per log.
+	const unsigned generation = state.generation.load();
+	if (stream.generation != generation)
+	{
+		auto it = state.ids.find(path);
+		const uint16_t id = (it != state.ids.end()) ? it->second : state.ids.size();
+		if (!state.push(StreamName, id, timeNs, path.c_str(), path.size()))
+		{
+			state.producers--;
+			return;
+		}
+		state.ids[path] = id;
+		stream.id = id;
+		stream.generation = generation;
+	}
+
+	state.push(Frame, stream.id, timeNs, data, size);
+	state.producers--;
+}
+
+binance::RecordReader::RecordReader() : file(NULL), compressed(false) { }
+
+binance::RecordReader::~RecordReader()
+{
+	close();
+}
+
+bool binance::RecordReader::open(const string& filename)
+{
+	close();
+
+#ifdef BINANCE_WITH_ZLIB
+	// Reads plain files as well.
+	gzFile gz = gzopen(filename.c_str(), "rb");
+	if (!gz)
+		return false;
+	gzbuffer(gz, 1 << 20);
+	file = gz;
+	compressed = true;
+#else
+	FILE* fp = fopen(filename.c_str(), "rb");
+	if (!fp)
+		return false;
+	file = fp;
+	compressed = false;
+#endif
+
+	char magic[sizeof(Recorder::magic)];
+	if (!read(magic, sizeof(magic)) || memcmp(magic, Recorder::magic, sizeof(magic)))
+	{
+		BINANCE_LOG_ERROR(binanceLogWs, "<RecordReader::open> Error ! %s is not a recorder log", filename.c_str());
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void binance::RecordReader::close()
+{
+	if (!file)
+		return;
+
+#ifdef BINANCE_WITH_ZLIB
+	if (compressed)
+		gzclose((gzFile)file);
+	else
+#endif
+		fclose((FILE*)file);
+	file = NULL;
+}
+
+bool binance::RecordReader::read(void* data, size_t size)
+{
+	if (!file)
+		return false;
+
+#ifdef BINANCE_WITH_ZLIB
+	if (compressed)
+		return gzread((gzFile)file, data, size) == (int)size;
+#endif
+	return fread(data, 1, size, (FILE*)file) == size;
+}
+
+bool binance::RecordReader::next(Record& record)
+{
+	char header[Recorder::headerSize];
+	if (!read(header, sizeof(header)))
+		return false;
+
+	uint32_t size;
+	uint16_t type;
+	memcpy(&size, header, 4);
+	memcpy(&type, header + 4, 2);
+	memcpy(&record.stream, header + 6, 2);
+	memcpy(&record.timeNs, header + 8, 8);
+	record.type = (Recorder::RecordType)type;
+
+	// A record cut by a crash of the recorder ends the log.
+	record.payload.resize(size);
+	return !size || read(&record.payload[0], size);
+}
+
+// Flush the log at exit.
+class RecorderFinalize
+{
+public :
+
+	~RecorderFinalize()
+	{
+		Recorder::stop();
+	}
+};
+
+static RecorderFinalize recorderFinalize;
+
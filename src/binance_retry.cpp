@@ -0,0 +1,92 @@
+/*
+	C++ library for Binance API.
+*/
+
+#include "binance_retry.h"
+
+#include <algorithm>
+#include <mutex>
+#include <random>
+
+using namespace binance;
+using namespace std;
+
+static mutex rules_lock;
+
+static RetryPolicy::Rule rules[RetryPolicy::KindCount] =
+{
+	{ 3, 100, 2000 }, // Safe
+	{ 3, 50, 1000 },  // Order
+};
+
+// Random numbers of the calling thread, for the jitter and the ids.
+static mt19937_64& getRandom()
+{
+	static thread_local mt19937_64 random(random_device{}());
+	return random;
+}
+
+RetryPolicy::Rule binance::RetryPolicy::getRule(Kind kind)
+{
+	lock_guard<mutex> guard(rules_lock);
+	return rules[kind];
+}
+
+void binance::RetryPolicy::setRule(Kind kind, const Rule& rule)
+{
+	lock_guard<mutex> guard(rules_lock);
+	rules[kind] = rule;
+	rules[kind].attempts = max(rule.attempts, 1);
+}
+
+bool binance::RetryPolicy::isTransient(const binanceErrorInfo_t& error)
+{
+	switch (error.status)
+	{
+	case binanceErrorCurlFailed :
+	case binanceErrorEmptyServerResponse :
+		return true;
+	default :
+		break;
+	}
+
+	return (error.httpStatus >= 500) || (error.httpStatus == 429) || (error.httpStatus == 418);
+}
+
+bool binance::RetryPolicy::shouldRetry(Kind kind, int attempt, const binanceErrorInfo_t& error, unsigned int& delayMs)
+{
+	const Rule rule = getRule(kind);
+	if ((attempt + 1 >= rule.attempts) || !isTransient(error))
+		return false;
+
+	// Full jitter: uniform in [0, min(max, base * 2^attempt)].
+	unsigned long long bound = rule.baseDelayMs;
+	bound <<= min(attempt, 20);
+	bound = min(bound, (unsigned long long)rule.maxDelayMs);
+	delayMs = bound ? getRandom()() % (bound + 1) : 0;
+
+	if ((error.httpStatus == 429) || (error.httpStatus == 418))
+	{
+		const unsigned long long retryAfterMs = error.retryAfter * 1000ULL;
+		if (retryAfterMs > rule.maxDelayMs)
+			return false;
+
+		delayMs = max(delayMs, (unsigned int)retryAfterMs);
+	}
+
+	return true;
+}
+
+string binance::RetryPolicy::makeClientOrderId()
+{
+	static const char digits[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+
+	// Binance allows up to 36 characters of [.A-Z:/a-z0-9_-].
+	string id(22, '0');
+	mt19937_64& random = getRandom();
+	for (int i = 0; i < (int)id.size(); i++)
+		id[i] = digits[random() % 62];
+
+	return id;
+}
+
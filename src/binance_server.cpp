@@ -6,14 +6,38 @@
 */
 
 #include "binance.h"
+#include "binance_hosts.h"
+#include "binance_latency.h"
 #include "binance_logger.h"
+#include "binance_metrics.h"
+#include "binance_ratelimit.h"
+#include "binance_retry.h"
 #include "binance_utils.h"
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <thread>
+
 using namespace binance;
 using namespace std;
 
 binance::Server::Server(const char* hostname_,const char* prefix, bool simulation_) : hostname(hostname_),prefix(prefix) ,simulation(simulation_) { }
 
+binance::Server::Server(const vector<string>& hostnames, const char* prefix_, bool simulation_) :
+	hostname(hostnames.empty() ? string("https://api.binance.com") : hostnames[0]), prefix(prefix_), simulation(simulation_)
+{
+	if (hostnames.size() > 1)
+	{
+		HostPool::add(hostnames, prefix + "/ping");
+		HostPool::startProbing();
+	}
+}
+
 const std::string& binance::Server::getHostname() const 
 { 
 	return hostname; 
@@ -21,12 +45,17 @@ const std::string& binance::Server::getHostname() const
 
 bool binance::Server::isSimulator() const { return simulation; }
 
+RateLimiter& binance::Server::getRateLimiter() const
+{
+	return RateLimiter::get(hostname);
+}
+
 // GET /api/v3/time
 binanceError_t binance::Server::getTime(Json::Value &json_result)
 {
 	binanceError_t status = binanceSuccess;
 
-	Logger::write_log("<get_serverTime>");
+	BINANCE_LOG_DEBUG(binanceLogHttp, "<get_serverTime>");
 
 	string url(hostname);
 	url += prefix +"/time";
@@ -44,30 +73,220 @@ binanceError_t binance::Server::getTime(Json::Value &json_result)
 			JSONCPP_STRING err;
 			Json::CharReaderBuilder builder;
 			const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+			LatencyScope parse_scope(Latency::Parse);
 			if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
 							   &err)) {
-				Logger::write_log("<get_serverTime> Error ! %s", err.c_str());
+				BINANCE_LOG_ERROR(binanceLogHttp, "<get_serverTime> Error ! %s", err.c_str());
 				status = binanceErrorParsingServerResponse;
+				Metrics::countError(status);
 				return status;
 			}
 			CHECK_SERVER_ERR(json_result);
 		}
 		catch (exception &e)
 		{
-		 	Logger::write_log("<get_serverTime> Error ! %s", e.what());
+		 	BINANCE_LOG_ERROR(binanceLogHttp, "<get_serverTime> Error ! %s", e.what());
 			status = binanceErrorParsingServerResponse;
+			Metrics::countError(status);
 		}
 	}
 
-	Logger::write_log("<get_serverTime> Done.");
+	BINANCE_LOG_DEBUG(binanceLogHttp, "<get_serverTime> Done.");
 
 	return status;
 }
 
+// Exchange clock estimator: a short history of the best (lowest RTT)
+// offsets between the exchange clock and the local monotonic clock,
+// fitted with a line to get the current offset and the drift.
+struct TimeSample
+{
+	double mono_ms;
+	double offset_ms;
+	double rtt_ms;
+};
+
+static const size_t time_history_max = 16;
+
+// Do not estimate drift from samples taken too close in time.
+static const double time_drift_min_span_ms = 60 * 1000;
+
+static mutex time_lock;
+static deque<TimeSample> time_history;
+
+static void addTimeSample(const TimeSample& sample)
+{
+	lock_guard<mutex> guard(time_lock);
+
+	time_history.push_back(sample);
+	if (time_history.size() > time_history_max)
+		time_history.pop_front();
+
+	const TimeSample& last = time_history.back();
+	const double span = last.mono_ms - time_history.front().mono_ms;
+
+	double offset = 0, drift = 0;
+	if ((time_history.size() < 3) || (span < time_drift_min_span_ms))
+	{
+		// Not enough history for a drift: trust the best recent sample.
+		double rtt = last.rtt_ms;
+		offset = last.offset_ms;
+		for (size_t i = 0; i < time_history.size(); i++)
+			if (time_history[i].rtt_ms < rtt)
+			{
+				rtt = time_history[i].rtt_ms;
+				offset = time_history[i].offset_ms;
+			}
+	}
+	else
+	{
+		// Least squares fit of offset = offset0 + drift * (mono - last.mono)
+		const double n = time_history.size();
+		double sx = 0, sy = 0, sxx = 0, sxy = 0;
+		for (size_t i = 0; i < time_history.size(); i++)
+		{
+			const double x = time_history[i].mono_ms - last.mono_ms;
+			const double y = time_history[i].offset_ms;
+			sx += x; sy += y; sxx += x * x; sxy += x * y;
+		}
+		const double det = n * sxx - sx * sx;
+		drift = (det != 0) ? (n * sxy - sx * sy) / det : 0;
+		offset = (sy - drift * sx) / n;
+	}
+
+	set_server_clock(last.mono_ms, last.mono_ms + offset, drift);
+
+	double wall_offset = 0;
+	get_server_clock(wall_offset, drift);
+	BINANCE_LOG_INFO(binanceLogHttp, "<sync_time> offset to local clock = %.3f ms, drift = %.3f ppm, rtt = %.3f ms",
+		wall_offset, drift * 1e6, last.rtt_ms);
+}
+
+static binanceError_t syncTime(const string& url, int samples)
+{
+	TimeSample best;
+	best.rtt_ms = -1;
+
+	for (int i = 0; i < samples; i++)
+	{
+		string str_result;
+		const double t0 = get_monotonic_ms();
+		binanceError_t status = Server::getCurl(str_result, url);
+		const double t1 = get_monotonic_ms();
+		if (status != binanceSuccess)
+			continue;
+
+		Json::Value json_result;
+		JSONCPP_STRING err;
+		Json::CharReaderBuilder builder;
+		const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+		LatencyScope parse_scope(Latency::Parse);
+		if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result, &err) ||
+			!json_result.isObject() || !json_result["serverTime"].isNumeric())
+		{
+			BINANCE_LOG_ERROR(binanceLogHttp, "<sync_time> Error ! unexpected response |%s|", str_result.c_str());
+			continue;
+		}
+
+		// The exchange stamped its time somewhere within the round trip:
+		// assume the middle, so the error is bounded by RTT / 2.
+		if ((best.rtt_ms < 0) || (t1 - t0 < best.rtt_ms))
+		{
+			best.rtt_ms = t1 - t0;
+			best.mono_ms = (t0 + t1) / 2;
+			best.offset_ms = json_result["serverTime"].asDouble() - best.mono_ms;
+		}
+	}
+
+	if (best.rtt_ms < 0)
+		return binanceErrorInvalidServerResponse;
+
+	addTimeSample(best);
+
+	return binanceSuccess;
+}
+
+binanceError_t binance::Server::setTime(const time_t time, unsigned int scale)
+{
+	if (scale == 0)
+		return binanceErrorUnknown;
+
+	{
+		lock_guard<mutex> guard(time_lock);
+		time_history.clear();
+	}
+
+	set_server_clock(get_monotonic_ms(), (double)time * 1000 / scale);
+
+	return binanceSuccess;
+}
+
+binanceError_t binance::Server::syncTime(int samples)
+{
+	BINANCE_LOG_DEBUG(binanceLogHttp, "<sync_time>");
+
+	binanceError_t status = ::syncTime(hostname + prefix + "/time", samples);
+
+	BINANCE_LOG_DEBUG(binanceLogHttp, "<sync_time> Done.");
+
+	return status;
+}
+
+static mutex time_sync_lock;
+static condition_variable time_sync_cond;
+static thread time_sync_thread;
+static bool time_sync_stop = false;
+
+void binance::Server::startTimeSync(unsigned int period_sec, int samples)
+{
+	stopTimeSync();
+
+	lock_guard<mutex> guard(time_sync_lock);
+	time_sync_stop = false;
+	time_sync_thread = thread([](string url, unsigned int period_sec, int samples)
+	{
+		unique_lock<mutex> lock(time_sync_lock);
+		while (!time_sync_stop)
+		{
+			lock.unlock();
+			::syncTime(url, samples);
+			lock.lock();
+
+			time_sync_cond.wait_for(lock, chrono::seconds(period_sec), [] { return time_sync_stop; });
+		}
+	},
+	hostname + prefix + "/time", period_sec, samples);
+}
+
+void binance::Server::stopTimeSync()
+{
+	{
+		lock_guard<mutex> guard(time_sync_lock);
+		time_sync_stop = true;
+	}
+	time_sync_cond.notify_all();
+
+	if (time_sync_thread.joinable())
+		time_sync_thread.join();
+}
+
+// Do not leave a joinable thread behind at exit.
+class TimeSyncFinalize
+{
+public :
+
+	~TimeSyncFinalize()
+	{
+		Server::stopTimeSync();
+	}
+};
+
+static TimeSyncFinalize timeSyncFinalize;
+
 // Curl's callback
 static size_t getCurlCb(void *content, size_t size, size_t nmemb, std::string *buffer)
 {
-	Logger::write_log("<curl_cb> ");
+	BINANCE_LOG_TRACE(binanceLogHttp, "<curl_cb> ");
 
 	size_t newLength = size * nmemb;
 	size_t oldLength = buffer->size();
@@ -76,11 +295,34 @@ static size_t getCurlCb(void *content, size_t size, size_t nmemb, std::string *b
 
 	std::copy((char*)content, (char*)content + newLength, buffer->begin() + oldLength);
 
-	Logger::write_log("<curl_cb> Done.");
+	BINANCE_LOG_TRACE(binanceLogHttp, "<curl_cb> Done.");
 
 	return newLength;
 }
 
+// Rate limits related headers of a response.
+struct CurlHeaders
+{
+	vector<RateLimiter::Usage> usage;
+	int retryAfter;
+
+	CurlHeaders() : retryAfter(0) { }
+};
+
+// Curl's header callback, called once per header line
+static size_t getCurlHeaderCb(char *content, size_t size, size_t nmemb, CurlHeaders *headers)
+{
+	size_t length = size * nmemb;
+
+	RateLimiter::Usage usage;
+	if (RateLimiter::parseUsage(content, length, usage))
+		headers->usage.push_back(usage);
+	else
+		RateLimiter::parseRetryAfter(content, length, headers->retryAfter);
+
+	return length;
+}
+
 binanceError_t binance::Server::getCurl(string& result_json, const string& url)
 {
 	vector<string> v;
@@ -89,51 +331,442 @@ binanceError_t binance::Server::getCurl(string& result_json, const string& url)
 	return getCurlWithHeader(result_json, url, v, post_data, action);
 }
 
+// Connection lanes: every request class keeps its own curl handles
+// between requests, so that their connections stay alive, and so that
+// the classes never wait for each other's connections.
+class CurlLanes
+{
+	struct Lane
+	{
+		mutex lock;
+		condition_variable released;
+		vector<CURL*> idle;
+		int size;
+		int busy;
+		int waiting;
+	};
+
+	Lane lanes[binanceRequestClassCount];
+
+	static CURL* take(Lane& lane)
+	{
+		CURL* curl;
+		if (lane.idle.empty())
+			curl = curl_easy_init();
+		else
+		{
+			curl = lane.idle.back();
+			lane.idle.pop_back();
+		}
+
+		if (curl)
+			lane.busy++;
+
+		return curl;
+	}
+
+public :
+
+	CurlLanes()
+	{
+		static const int sizes[binanceRequestClassCount] = { 4, 2, 4, 2 };
+		for (int i = 0; i < binanceRequestClassCount; i++)
+		{
+			lanes[i].size = sizes[i];
+			lanes[i].busy = 0;
+			lanes[i].waiting = 0;
+		}
+
+		Metrics::addCollector([this]()
+		{
+			for (int i = 0; i < binanceRequestClassCount; i++)
+			{
+				const Metrics::Labels labels(1, make_pair(string("class"),
+					string(binanceGetRequestClassString((binanceRequestClass_t)i))));
+				lock_guard<mutex> guard(lanes[i].lock);
+				Metrics::getGauge("binance_rest_connections_busy", "Connections of the lane in use", labels).set(lanes[i].busy);
+				Metrics::getGauge("binance_rest_connections_waiting", "Requests waiting for a connection of the lane", labels).set(lanes[i].waiting);
+			}
+		});
+	}
+
+	CURL* acquire(binanceRequestClass_t requestClass)
+	{
+		Lane& lane = lanes[requestClass];
+		unique_lock<mutex> guard(lane.lock);
+		lane.waiting++;
+		lane.released.wait(guard, [&lane] { return lane.busy < lane.size; });
+		lane.waiting--;
+
+		return take(lane);
+	}
+
+	// Same as acquire(), but NULL rather than waiting when the lane is busy.
+	CURL* tryAcquire(binanceRequestClass_t requestClass)
+	{
+		Lane& lane = lanes[requestClass];
+		lock_guard<mutex> guard(lane.lock);
+		if ((lane.busy >= lane.size) || lane.waiting)
+			return NULL;
+
+		return take(lane);
+	}
+
+	void release(binanceRequestClass_t requestClass, CURL* curl)
+	{
+		// Drop the options of the last request, but keep the connection.
+		curl_easy_reset(curl);
+
+		Lane& lane = lanes[requestClass];
+		lock_guard<mutex> guard(lane.lock);
+		lane.busy--;
+		if ((int)lane.idle.size() + lane.busy < lane.size)
+			lane.idle.push_back(curl);
+		else
+			curl_easy_cleanup(curl);
+		lane.released.notify_one();
+	}
+
+	void setSize(binanceRequestClass_t requestClass, int size)
+	{
+		Lane& lane = lanes[requestClass];
+		lock_guard<mutex> guard(lane.lock);
+		lane.size = max(size, 1);
+		while ((int)lane.idle.size() + lane.busy > lane.size && !lane.idle.empty())
+		{
+			curl_easy_cleanup(lane.idle.back());
+			lane.idle.pop_back();
+		}
+		lane.released.notify_all();
+	}
+};
+
+// Never destroyed, as other threads may still use the handles at exit.
+static CurlLanes& getCurlLanes()
+{
+	static CurlLanes* lanes = new CurlLanes();
+	return *lanes;
+}
+
+void binance::Server::setLaneSize(binanceRequestClass_t requestClass, int connections)
+{
+	getCurlLanes().setSize(requestClass, connections);
+}
+
 class SmartCURL
 {
 	CURL* curl;
+	binanceRequestClass_t requestClass;
 
 public :
 
 	CURL* get() { return curl; }
 
-	SmartCURL()
+	SmartCURL(binanceRequestClass_t requestClass_) : requestClass(requestClass_)
 	{
-		curl = curl_easy_init();
+		curl = getCurlLanes().acquire(requestClass);
 	}
 
 	~SmartCURL()
 	{
-		curl_easy_cleanup(curl);
+		if (curl)
+			getCurlLanes().release(requestClass, curl);
 	}
 };
 
-// Do the curl
-binanceError_t binance::Server::getCurlWithHeader(string& str_result, 
+binanceError_t binance::Server::getCurlWithHeader(string& str_result,
 	const string& url, const vector<string>& extra_http_header, const string& post_data, const string& action)
+{
+	return getCurlWithHeader(str_result, url, extra_http_header, post_data, action,
+		RateLimiter::getClass(url, action));
+}
+
+// Outcome of the last request of each thread.
+static thread_local binanceErrorInfo_t last_error;
+
+const binanceErrorInfo_t& binance::binanceGetLastError()
+{
+	return last_error;
+}
+
+void binance::binanceSetLastError(const binanceErrorInfo_t& error)
+{
+	last_error = error;
+}
+
+binanceError_t binance::binanceCheckServerError(const Json::Value& result)
+{
+	if (!result.isObject() || !result.isMember("code") || !result.isMember("msg"))
+		return binanceSuccess;
+
+	last_error.status = binanceErrorServer;
+	last_error.code = result["code"].asInt();
+	last_error.msg = result["msg"].asString();
+
+	BINANCE_LOG_ERROR(binanceLogHttp, "<server> Error ! %d %s", last_error.code, last_error.msg.c_str());
+	Metrics::countError(binanceErrorServer);
+
+	return binanceErrorServer;
+}
+
+// Curl state shared by all handles of the process: the DNS cache and the
+// TLS sessions, so that a new connection neither resolves the host again,
+// nor makes a full TLS handshake once any other connection to the host did.
+// The connections themselves are not shared, as libcurl does not support
+// sharing them between concurrent threads: they are passed between threads
+// with their handles by the lanes instead.
+class CurlShare
+{
+	CURLSH* share;
+
+	// libcurl asks for CURL_LOCK_ACCESS_SINGLE on the DNS cache and
+	// the TLS sessions alike, so there is nothing to gain from a shared lock.
+	mutex locks[CURL_LOCK_DATA_LAST];
+
+	static void lock(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr)
+	{
+		static_cast<CurlShare*>(userptr)->locks[data].lock();
+	}
+
+	static void unlock(CURL* handle, curl_lock_data data, void* userptr)
+	{
+		static_cast<CurlShare*>(userptr)->locks[data].unlock();
+	}
+
+public :
+
+	CurlShare()
+	{
+		share = curl_share_init();
+		if (!share)
+		{
+			BINANCE_LOG_ERROR(binanceLogHttp, "<curl_share> Error ! curl_share_init() failed, nothing is shared");
+			return;
+		}
+
+		curl_share_setopt(share, CURLSHOPT_LOCKFUNC, lock);
+		curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, unlock);
+		curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+		curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+		curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+	}
+
+	CURLSH* get() const { return share; }
+};
+
+// Never destroyed, as other threads may still use the handles at exit.
+CURLSH* binance::Server::getCurlShare()
+{
+	static CurlShare* share = new CurlShare();
+	return share->get();
+}
+
+// Trusted CAs, read once and never freed, as the handles refer to them.
+struct CaBundle
+{
+	string path;
+	string pem;
+};
+
+static mutex ca_bundle_lock;
+static const CaBundle* ca_bundle = NULL;
+
+// Bundles of the common distributions, tried after $SSL_CERT_FILE.
+static const char* const ca_bundle_paths[] =
+{
+	"/etc/ssl/certs/ca-certificates.crt", // Debian, Ubuntu, Arch
+	"/etc/pki/tls/certs/ca-bundle.crt",   // Fedora, RHEL
+	"/etc/ssl/ca-bundle.pem",             // openSUSE
+	"/etc/ssl/cert.pem",                  // Alpine, macOS
+};
+
+static const CaBundle* readCaBundle(const string& path)
+{
+	ifstream file(path.c_str(), ios::binary);
+	if (!file)
+		return NULL;
+
+	CaBundle* bundle = new CaBundle();
+	bundle->path = path;
+	bundle->pem.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+	if (bundle->pem.empty())
+	{
+		delete bundle;
+		return NULL;
+	}
+
+	return bundle;
+}
+
+static const CaBundle& getCaBundleLocked()
+{
+	if (!ca_bundle)
+	{
+		const char* path = getenv("SSL_CERT_FILE");
+		if (path)
+			ca_bundle = readCaBundle(path);
+
+		for (size_t i = 0; !ca_bundle && (i < sizeof(ca_bundle_paths) / sizeof(ca_bundle_paths[0])); i++)
+			ca_bundle = readCaBundle(ca_bundle_paths[i]);
+
+		if (ca_bundle)
+			BINANCE_LOG_INFO(binanceLogHttp, "<ca_bundle> Trusting the CAs of %s", ca_bundle->path.c_str());
+		else
+		{
+			BINANCE_LOG_INFO(binanceLogHttp, "<ca_bundle> No CA bundle found, using the defaults of the TLS library");
+			ca_bundle = new CaBundle();
+		}
+	}
+
+	return *ca_bundle;
+}
+
+bool binance::Server::setCaBundle(const string& path)
+{
+	const CaBundle* bundle = readCaBundle(path);
+	if (!bundle)
+	{
+		BINANCE_LOG_ERROR(binanceLogHttp, "<ca_bundle> Error ! cannot read %s", path.c_str());
+		return false;
+	}
+
+	// The previous bundle is kept, as the handles may still refer to it.
+	lock_guard<mutex> guard(ca_bundle_lock);
+	ca_bundle = bundle;
+	return true;
+}
+
+const string& binance::Server::getCaBundle()
+{
+	lock_guard<mutex> guard(ca_bundle_lock);
+	return getCaBundleLocked().pem;
+}
+
+bool binance::Server::setupTls(CURL* curl)
+{
+	if (curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L) != CURLE_OK)
+	{
+		BINANCE_LOG_ERROR(binanceLogHttp, "<curl_api> curl_easy_setopt(CURLOPT_SSL_VERIFYPEER) is not supported");
+		return false;
+	}
+	curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
+
+	const CaBundle* bundle;
+	{
+		lock_guard<mutex> guard(ca_bundle_lock);
+		bundle = &getCaBundleLocked();
+	}
+
+	if (!bundle->pem.empty())
+	{
+		bool inMemory = false;
+#if LIBCURL_VERSION_NUM >= 0x074d00 // 7.77.0
+		// Verified against the bundle in memory rather than read from disk per connection,
+		// where the TLS backend supports it: mbedTLS only does from curl 7.81.0.
+		struct curl_blob blob;
+		blob.data = const_cast<char*>(bundle->pem.data());
+		blob.len = bundle->pem.size();
+		blob.flags = CURL_BLOB_NOCOPY;
+		inMemory = (curl_easy_setopt(curl, CURLOPT_CAINFO_BLOB, &blob) == CURLE_OK);
+#endif
+		if (!inMemory && (curl_easy_setopt(curl, CURLOPT_CAINFO, bundle->path.c_str()) != CURLE_OK))
+		{
+			BINANCE_LOG_ERROR(binanceLogHttp, "<curl_api> Error ! cannot set the CA bundle %s", bundle->path.c_str());
+			return false;
+		}
+	}
+
+#if LIBCURL_VERSION_NUM >= 0x075700 // 7.87.0
+	// Keep the parsed CA store between the connections, where the TLS backend supports it.
+	curl_easy_setopt(curl, CURLOPT_CA_CACHE_TIMEOUT, 24 * 60 * 60L);
+#endif
+
+	return true;
+}
+
+// Options common to all transfers: the url and where the response goes.
+static bool setupTransfer(CURL* curl, const string& url, string& str_result, CurlHeaders& headers)
+{
+	curl_easy_setopt(curl, CURLOPT_SHARE, Server::getCurlShare());
+	curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, getCurlCb);
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, &str_result);
+	curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, getCurlHeaderCb);
+	curl_easy_setopt(curl, CURLOPT_HEADERDATA, &headers);
+
+	return Server::setupTls(curl);
+}
+
+// Phases of a completed transfer, as timed by curl. The connection setup
+// phases are only recorded for the transfers which made a new connection.
+static void recordLatency(CURL* curl)
+{
+	if (!Latency::isEnabled())
+		return;
+
+	curl_off_t namelookup = 0, connect = 0, appconnect = 0, pretransfer = 0, starttransfer = 0, total = 0;
+	curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &namelookup);
+	curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect);
+	curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &appconnect);
+	curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME_T, &pretransfer);
+	curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &starttransfer);
+	curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+
+	long connects = 0;
+	curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+	if (connects > 0)
+	{
+		Latency::recordNs(Latency::DnsLookup, namelookup * 1e3);
+		Latency::recordNs(Latency::Connect, (connect - namelookup) * 1e3);
+		if (appconnect > 0)
+			Latency::recordNs(Latency::TlsHandshake, (appconnect - connect) * 1e3);
+	}
+
+	Latency::recordNs(Latency::FirstByte, (starttransfer - pretransfer) * 1e3);
+	Latency::recordNs(Latency::Transfer, (total - starttransfer) * 1e3);
+}
+
+// Do the curl, once
+static binanceError_t performRequest(string& str_result,
+	const string& url, const vector<string>& extra_http_header, const string& post_data, const string& action,
+	binanceRequestClass_t requestClass)
 {
 	binanceError_t status = binanceSuccess;
 	
-	Logger::write_log("<curl_api>");
+	BINANCE_LOG_TRACE(binanceLogHttp, "<curl_api>");
 
-	SmartCURL curl;
+	last_error = binanceErrorInfo_t();
+
+	// Stay within the exchange rate limits rather than being banned.
+	RateLimiter& limiter = RateLimiter::get(url);
+	status = limiter.acquire(RateLimiter::getWeight(url, action), RateLimiter::isOrder(url, action), requestClass);
+	if (status != binanceSuccess)
+	{
+		BINANCE_LOG_INFO(binanceLogHttp, "<curl_api> Rate limited.");
+		last_error.status = status;
+		Metrics::countError(status);
+		return status;
+	}
+
+	// Send to the fastest healthy host, if the url is served by a pool.
+	HostPool* pool = HostPool::find(url);
+	string host;
+	const string routed = pool ? pool->route(url, host) : url;
+
+	SmartCURL curl(requestClass);
+	CurlHeaders headers;
+	struct curl_slist *chunk = NULL;
 
 	while (curl.get())
 	{
-		curl_easy_setopt(curl.get(), CURLOPT_URL, url.c_str());
-		curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, getCurlCb);
-		curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, &str_result);
-		curl_easy_setopt(curl.get(), CURLOPT_SSL_VERIFYPEER, false);
-		if (curl_easy_setopt(curl.get(), CURLOPT_SSL_VERIFYHOST, true) != CURLE_OK)
+		if (!setupTransfer(curl.get(), routed, str_result, headers))
 		{
-			Logger::write_log("<curl_api> curl_easy_setopt(CURLOPT_SSL_VERIFYPEER) is not supported");
 			status = binanceErrorCurlFailed;
 			break;
 		}
 
 		if (extra_http_header.size() > 0)
 		{
-			struct curl_slist *chunk = NULL;
 			for (int i = 0; i < extra_http_header.size(); i++)
 				chunk = curl_slist_append(chunk, extra_http_header[i].c_str());
 
@@ -163,16 +796,503 @@ binanceError_t binance::Server::getCurlWithHeader(string& str_result,
 			// Check for errors.
 			if (res != CURLE_OK)
 			{
-				Logger::write_log("<curl_api> curl_easy_perform() failed: %s", curl_easy_strerror(res));
+				BINANCE_LOG_ERROR(binanceLogHttp, "<curl_api> curl_easy_perform() failed: %s", curl_easy_strerror(res));
 				status = binanceErrorCurlFailed;
+				if (pool)
+					pool->report(host, false);
+			}
+			else
+			{
+				long httpStatus = 0;
+				curl_easy_getinfo(curl.get(), CURLINFO_RESPONSE_CODE, &httpStatus);
+				limiter.update(headers.usage, httpStatus, headers.retryAfter);
+				last_error.httpStatus = httpStatus;
+				last_error.retryAfter = headers.retryAfter;
+
+				recordLatency(curl.get());
+
+				if (pool)
+					pool->report(host, httpStatus < 500);
+
+				if (httpStatus >= 400)
+					Metrics::getCounter("binance_rest_http_errors_total", "REST responses with an HTTP error status",
+						Metrics::Labels(1, make_pair(string("code"), to_string(httpStatus)))).add();
 			}
 		}
 
 		break;
 	}
 
-	Logger::write_log("<curl_api> Done.");
+	curl_slist_free_all(chunk);
+
+	last_error.status = status;
+	if (status != binanceSuccess)
+		Metrics::countError(status);
+	else if (str_result.empty())
+	{
+		last_error.status = binanceErrorEmptyServerResponse;
+		Metrics::countError(binanceErrorEmptyServerResponse);
+	}
+
+	BINANCE_LOG_TRACE(binanceLogHttp, "<curl_api> Done.");
+
+	return status;
+}
+
+// Do the curl, repeating the GET requests which failed for transient
+// reasons, see RetryPolicy. Other requests may have taken effect on the
+// exchange before failing, so only their callers know if they are safe
+// to repeat.
+binanceError_t binance::Server::getCurlWithHeader(string& str_result,
+	const string& url, const vector<string>& extra_http_header, const string& post_data, const string& action,
+	binanceRequestClass_t requestClass)
+{
+	for (int attempt = 0; ; attempt++)
+	{
+		str_result.clear();
+		binanceError_t status = performRequest(str_result, url, extra_http_header, post_data, action, requestClass);
+
+		unsigned int delayMs = 0;
+		if ((action != "GET") || !RetryPolicy::shouldRetry(RetryPolicy::Safe, attempt, last_error, delayMs))
+			return status;
+
+		BINANCE_LOG_INFO(binanceLogHttp, "<curl_api> %s, retrying in %u ms",
+			last_error.httpStatus ? to_string(last_error.httpStatus).c_str() : binanceGetErrorString(last_error.status),
+			delayMs);
+		Metrics::getCounter("binance_rest_retries_total", "REST requests repeated after a transient failure",
+			Metrics::Labels(1, make_pair(string("class"), string(binanceGetRequestClassString(requestClass))))).add();
+
+		this_thread::sleep_for(chrono::milliseconds(delayMs));
+	}
+}
+
+
+// Hedging of the latency critical requests, see Server::setHedging().
+class Hedging
+{
+	mutex lock;
+	bool enabled;
+	double percentile;
+	vector<string> alternates;
+	size_t next;
+
+	// Latencies of the recent hedged requests in ms, oldest first.
+	deque<double> latencies;
+
+	// Multi handles between the requests, one per concurrent request at
+	// most: the connections of the transfers stay in their caches.
+	vector<CURLM*> multis;
+
+	static const size_t latencies_max = 256;
+
+	// Fewer latencies are not enough to tell a slow response.
+	static const size_t latencies_min = 16;
+
+public :
+
+	Hedging() : enabled(false), percentile(0.95), next(0) { }
+
+	void set(bool enabled_, double percentile_, const vector<string>& alternates_)
+	{
+		lock_guard<mutex> guard(lock);
+		enabled = enabled_;
+		percentile = min(max(percentile_, 0.0), 1.0);
+		alternates = alternates_;
+		if (alternates.empty())
+		{
+			alternates.push_back("https://api1.binance.com");
+			alternates.push_back("https://api2.binance.com");
+			alternates.push_back("https://api3.binance.com");
+		}
+	}
+
+	bool isEnabled()
+	{
+		lock_guard<mutex> guard(lock);
+		return enabled;
+	}
+
+	// How long to wait for the response before hedging it.
+	// Returns false while there is not enough history to tell.
+	bool getHedgeAfter(double& afterMs)
+	{
+		lock_guard<mutex> guard(lock);
+		if (latencies.size() < latencies_min)
+			return false;
+
+		vector<double> sorted(latencies.begin(), latencies.end());
+		const size_t rank = min((size_t)(percentile * sorted.size()), sorted.size() - 1);
+		nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+		afterMs = sorted[rank];
+		return true;
+	}
+
+	// The url of the hedge, for the urls not served by a host pool:
+	// the same request to the next alternate host. Empty if none.
+	string getAlternate(const string& url)
+	{
+		const size_t scheme = url.find("://");
+		const size_t path = url.find('/', (scheme == string::npos) ? 0 : scheme + 3);
+		const string host = url.substr(0, path);
+
+		lock_guard<mutex> guard(lock);
+		for (size_t i = 0; i < alternates.size(); i++)
+		{
+			const string& alternate = alternates[next++ % alternates.size()];
+			if (alternate != host)
+				return alternate + ((path == string::npos) ? string() : url.substr(path));
+		}
+
+		return string();
+	}
+
+	void addLatency(double ms)
+	{
+		lock_guard<mutex> guard(lock);
+		latencies.push_back(ms);
+		if (latencies.size() > latencies_max)
+			latencies.pop_front();
+	}
+
+	CURLM* acquireMulti()
+	{
+		{
+			lock_guard<mutex> guard(lock);
+			if (!multis.empty())
+			{
+				CURLM* multi = multis.back();
+				multis.pop_back();
+				return multi;
+			}
+		}
+
+		CURLM* multi = curl_multi_init();
+		if (multi)
+			curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, 8L);
+		return multi;
+	}
+
+	void releaseMulti(CURLM* multi)
+	{
+		lock_guard<mutex> guard(lock);
+		multis.push_back(multi);
+	}
+};
+
+// Never destroyed, as other threads may still use it at exit.
+static Hedging& getHedging()
+{
+	static Hedging* hedging = new Hedging();
+	return *hedging;
+}
+
+void binance::Server::setHedging(bool enabled, double percentile, const vector<string>& alternates)
+{
+	getHedging().set(enabled, percentile, alternates);
+}
+
+// One of the transfers of a hedged request.
+struct HedgedTransfer
+{
+	CURL* curl;
+	string host; // of the pool, if any
+	string result;
+	CurlHeaders headers;
+
+	HedgedTransfer() : curl(NULL) { }
+};
+
+// Do the hedged curl, once
+static binanceError_t performHedged(string& str_result, const string& url)
+{
+	Hedging& hedging = getHedging();
+
+	BINANCE_LOG_TRACE(binanceLogHttp, "<curl_hedged>");
+
+	last_error = binanceErrorInfo_t();
+
+	// The hedges are accounted against the limits of the original host,
+	// as the exchange limits are per IP rather than per host.
+	RateLimiter& limiter = RateLimiter::get(url);
+	const int weight = RateLimiter::getWeight(url, "GET");
+	binanceError_t status = limiter.acquire(weight, false, binanceRequestMarketData);
+	if (status != binanceSuccess)
+	{
+		BINANCE_LOG_INFO(binanceLogHttp, "<curl_hedged> Rate limited.");
+		last_error.status = status;
+		Metrics::countError(status);
+		return status;
+	}
+
+	// The request goes to the fastest healthy host of the pool, if any,
+	// and its hedge to another host.
+	HostPool* pool = HostPool::find(url);
+	HedgedTransfer transfers[2];
+	const string routed = pool ? pool->route(url, transfers[0].host) : url;
+
+	double hedgeAfterMs = 0;
+	bool hedge = hedging.getHedgeAfter(hedgeAfterMs);
+
+	int started = 0, failed = 0;
+	HedgedTransfer* winner = NULL;
+
+	CURLM* multi = hedging.acquireMulti();
+	transfers[0].curl = getCurlLanes().acquire(binanceRequestMarketData);
+	if (multi && transfers[0].curl && setupTransfer(transfers[0].curl, routed, transfers[0].result, transfers[0].headers))
+	{
+		curl_multi_add_handle(multi, transfers[0].curl);
+		started++;
+	}
+
+	const double begin = get_monotonic_ms();
+	while (started && !winner && (failed < started))
+	{
+		int running = 0;
+		curl_multi_perform(multi, &running);
+
+		// Take the first response, wait for the other transfer if one fails.
+		int queued = 0;
+		CURLMsg* msg;
+		while (!winner && (msg = curl_multi_info_read(multi, &queued)))
+		{
+			if (msg->msg != CURLMSG_DONE)
+				continue;
+
+			HedgedTransfer& transfer = (msg->easy_handle == transfers[0].curl) ? transfers[0] : transfers[1];
+
+			// As in performRequest(): every completed transfer updates the
+			// limits, and a 5xx counts against the host.
+			long httpStatus = 0;
+			if (msg->data.result == CURLE_OK)
+			{
+				curl_easy_getinfo(transfer.curl, CURLINFO_RESPONSE_CODE, &httpStatus);
+				limiter.update(transfer.headers.usage, httpStatus, transfer.headers.retryAfter);
+			}
+			if (pool)
+				pool->report(transfer.host, (msg->data.result == CURLE_OK) && (httpStatus < 500));
+
+			if (msg->data.result == CURLE_OK)
+				winner = &transfer;
+			else
+			{
+				BINANCE_LOG_ERROR(binanceLogHttp, "<curl_hedged> curl_multi_perform() failed: %s",
+					curl_easy_strerror(msg->data.result));
+				failed++;
+			}
+		}
+
+		if (winner)
+			break;
+
+		double elapsed = get_monotonic_ms() - begin;
+		if (hedge && (elapsed >= hedgeAfterMs))
+		{
+			// A hedge is only worth it right away: never wait for its budget or connection.
+			hedge = false;
+
+			if (limiter.tryAcquire(weight, binanceRequestMarketData))
+			{
+				// Another host of the pool, as routed, so that the breaker
+				// keeps the hedges away from the hosts out of service.
+				string hedgeUrl;
+				if (pool)
+					pool->routeOther(url, transfers[0].host, hedgeUrl, transfers[1].host);
+				else
+					hedgeUrl = hedging.getAlternate(routed);
+
+				if (!hedgeUrl.empty())
+					transfers[1].curl = getCurlLanes().tryAcquire(binanceRequestMarketData);
+				if (transfers[1].curl && setupTransfer(transfers[1].curl, hedgeUrl, transfers[1].result, transfers[1].headers))
+				{
+					BINANCE_LOG_TRACE(binanceLogHttp, "<curl_hedged> no response in %.1f ms, hedging to %s",
+						elapsed, hedgeUrl.c_str());
+					curl_multi_add_handle(multi, transfers[1].curl);
+					started++;
+					Metrics::getCounter("binance_rest_hedges_total", "REST requests hedged to an alternate host").add();
+					continue;
+				}
+			}
+		}
+
+		const int timeout = hedge ? max((int)(hedgeAfterMs - elapsed), 1) : 100;
+		curl_multi_wait(multi, NULL, 0, timeout, NULL);
+	}
+
+	if (winner)
+	{
+		hedging.addLatency(get_monotonic_ms() - begin);
+		str_result.swap(winner->result);
+
+		long httpStatus = 0;
+		curl_easy_getinfo(winner->curl, CURLINFO_RESPONSE_CODE, &httpStatus);
+		last_error.httpStatus = httpStatus;
+		last_error.retryAfter = winner->headers.retryAfter;
+
+		recordLatency(winner->curl);
+
+		if (httpStatus >= 400)
+			Metrics::getCounter("binance_rest_http_errors_total", "REST responses with an HTTP error status",
+				Metrics::Labels(1, make_pair(string("code"), to_string(httpStatus)))).add();
+
+		if (winner == &transfers[1])
+			Metrics::getCounter("binance_rest_hedge_wins_total", "Hedged REST requests answered by the hedge first").add();
+	}
+	else
+		status = binanceErrorCurlFailed;
+
+	// The transfer still running is aborted, so its connection is not
+	// reused; the others stay in the cache of the multi handle.
+	for (int i = 0; i < 2; i++)
+	{
+		if (!transfers[i].curl)
+			continue;
+
+		if (multi)
+			curl_multi_remove_handle(multi, transfers[i].curl);
+		getCurlLanes().release(binanceRequestMarketData, transfers[i].curl);
+	}
+
+	if (multi)
+		hedging.releaseMulti(multi);
+
+	last_error.status = status;
+	if (status != binanceSuccess)
+		Metrics::countError(status);
+	else if (str_result.empty())
+	{
+		last_error.status = binanceErrorEmptyServerResponse;
+		Metrics::countError(binanceErrorEmptyServerResponse);
+	}
+
+	BINANCE_LOG_TRACE(binanceLogHttp, "<curl_hedged> Done.");
 
 	return status;
 }
 
+// Repeated as the other GET requests, see getCurlWithHeader().
+binanceError_t binance::Server::getCurlHedged(string& str_result, const string& url)
+{
+	if (!getHedging().isEnabled())
+		return getCurl(str_result, url);
+
+	for (int attempt = 0; ; attempt++)
+	{
+		str_result.clear();
+		binanceError_t status = performHedged(str_result, url);
+
+		unsigned int delayMs = 0;
+		if (!RetryPolicy::shouldRetry(RetryPolicy::Safe, attempt, last_error, delayMs))
+			return status;
+
+		BINANCE_LOG_INFO(binanceLogHttp, "<curl_hedged> %s, retrying in %u ms",
+			last_error.httpStatus ? to_string(last_error.httpStatus).c_str() : binanceGetErrorString(last_error.status),
+			delayMs);
+		Metrics::getCounter("binance_rest_retries_total", "REST requests repeated after a transient failure",
+			Metrics::Labels(1, make_pair(string("class"), string(binanceGetRequestClassString(binanceRequestMarketData))))).add();
+
+		this_thread::sleep_for(chrono::milliseconds(delayMs));
+	}
+}
+
+// One of the connections opened by warmUp().
+struct WarmUpTransfer
+{
+	binanceRequestClass_t requestClass;
+	CURL* curl;
+	bool started;
+	CURLcode res;
+	string host;
+	string result;
+	CurlHeaders headers;
+};
+
+binanceError_t binance::Server::warmUp() const
+{
+	BINANCE_LOG_DEBUG(binanceLogHttp, "<warm_up>");
+
+	const string url = hostname + prefix + "/ping";
+	RateLimiter& limiter = RateLimiter::get(url);
+	const int weight = RateLimiter::getWeight(url, "GET");
+	HostPool* pool = HostPool::find(url);
+
+	// Fill every lane with connections at once, one ping on each handle,
+	// so that the first request of each class finds a connection ready.
+	// Each handle performs on its own thread: a multi handle would keep
+	// the connections in its own cache, and close them with itself.
+	deque<WarmUpTransfer> transfers;
+	for (int i = 0; i < binanceRequestClassCount; i++)
+	{
+		const binanceRequestClass_t requestClass = (binanceRequestClass_t)i;
+		while (1)
+		{
+			CURL* curl = getCurlLanes().tryAcquire(requestClass);
+			if (!curl)
+				break;
+
+			transfers.push_back(WarmUpTransfer());
+			WarmUpTransfer& transfer = transfers.back();
+			transfer.requestClass = requestClass;
+			transfer.curl = curl;
+			transfer.started = false;
+			transfer.res = CURLE_OK;
+
+			const string routed = pool ? pool->route(url, transfer.host) : url;
+			if ((limiter.acquire(weight, false, binanceRequestHistory) != binanceSuccess) ||
+				!setupTransfer(curl, routed, transfer.result, transfer.headers))
+				break;
+
+			transfer.started = true;
+		}
+	}
+
+	vector<thread> threads;
+	for (size_t i = 0; i < transfers.size(); i++)
+	{
+		if (!transfers[i].started)
+			continue;
+
+		WarmUpTransfer* transfer = &transfers[i];
+		threads.push_back(thread([transfer]()
+		{
+			transfer->res = curl_easy_perform(transfer->curl);
+		}));
+	}
+	for (size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
+
+	binanceError_t status = binanceSuccess;
+	int opened = 0;
+	for (size_t i = 0; i < transfers.size(); i++)
+	{
+		WarmUpTransfer& transfer = transfers[i];
+		if (!transfer.started)
+			continue;
+
+		long httpStatus = 0;
+		if (transfer.res == CURLE_OK)
+		{
+			curl_easy_getinfo(transfer.curl, CURLINFO_RESPONSE_CODE, &httpStatus);
+			limiter.update(transfer.headers.usage, httpStatus, transfer.headers.retryAfter);
+			opened++;
+		}
+		else
+		{
+			BINANCE_LOG_ERROR(binanceLogHttp, "<warm_up> Error ! %s", curl_easy_strerror(transfer.res));
+			status = binanceErrorCurlFailed;
+		}
+
+		if (pool)
+			pool->report(transfer.host, (transfer.res == CURLE_OK) && (httpStatus < 500));
+	}
+
+	// The handles keep their connections in the lanes.
+	for (size_t i = 0; i < transfers.size(); i++)
+		getCurlLanes().release(transfers[i].requestClass, transfers[i].curl);
+
+	if (status != binanceSuccess)
+		Metrics::countError(status);
+
+	BINANCE_LOG_INFO(binanceLogHttp, "<warm_up> Done, %d of %zu connections open.", opened, transfers.size());
+
+	return status;
+}
@@ -0,0 +1,810 @@
+/*
+	C++ library for Binance API.
+*/
+
+#include "binance_logger.h"
+#include "binance_order_tracker.h"
+#include "binance_simulator.h"
+#include "binance_utils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+using namespace binance;
+using namespace std;
+
+// Quantities below are considered zero.
+static const double epsilon = 1e-12;
+
+static mutex simulatorsLock;
+static atomic<bool> anySimulator(false);
+
+static map<string, Simulator*>& getSimulators()
+{
+	// Leaked, as the websocket thread may still use them at exit.
+	static map<string, Simulator*>* simulators = new map<string, Simulator*>();
+	return *simulators;
+}
+
+binance::Simulator::Simulator() : nextOrderId(1), nextTradeId(1), latencyMs(0),
+	makerRate(0.001), takerRate(0.001), user_cb(nullptr), tracker(nullptr), delivering(false) { }
+
+Simulator& binance::Simulator::get(const Server& server)
+{
+	lock_guard<mutex> guard(simulatorsLock);
+	Simulator*& simulator = getSimulators()[server.getHostname()];
+	if (!simulator)
+	{
+		simulator = new Simulator();
+		anySimulator = true;
+	}
+
+	return *simulator;
+}
+
+void binance::Simulator::setLatency(double roundTripMs)
+{
+	lock_guard<mutex> guard(lock);
+	latencyMs = max(roundTripMs, 0.0);
+}
+
+void binance::Simulator::setFees(double makerRate_, double takerRate_)
+{
+	lock_guard<mutex> guard(lock);
+	makerRate = makerRate_;
+	takerRate = takerRate_;
+}
+
+void binance::Simulator::setBalance(const string& asset, double free)
+{
+	lock_guard<mutex> guard(lock);
+	balances[asset] = free;
+}
+
+void binance::Simulator::setUserDataStream(CB user_cb_, OrderTracker *tracker_)
+{
+	lock_guard<mutex> guard(lock);
+	user_cb = user_cb_;
+	tracker = tracker_;
+}
+
+void binance::Simulator::setBook(const string& symbol, const vector<pair<double, double> >& bids,
+	const vector<pair<double, double> >& asks)
+{
+	vector<Json::Value> events;
+	{
+		lock_guard<mutex> guard(lock);
+		Book& book = books[symbol];
+		book.bids.clear();
+		book.asks.clear();
+		book.stale = false;
+		for (size_t i = 0; i < bids.size(); i++)
+			book.bids[bids[i].first] = bids[i].second;
+		for (size_t i = 0; i < asks.size(); i++)
+			book.asks[asks[i].first] = asks[i].second;
+		matchResting(symbol, 0, 0, events);
+		post(events);
+	}
+	deliver();
+}
+
+void binance::Simulator::wait(double ms) const
+{
+	if (ms > 0)
+		this_thread::sleep_for(chrono::microseconds((long long)(ms * 1000)));
+}
+
+static const char* quoteAssets[] = { "USDT", "BUSD", "USDC", "TUSD", "FDUSD", "BTC", "ETH", "BNB", "EUR", "TRY" };
+
+string binance::Simulator::getQuoteAsset(const string& symbol)
+{
+	for (size_t i = 0; i < sizeof(quoteAssets) / sizeof(quoteAssets[0]); i++)
+	{
+		const string quote = quoteAssets[i];
+		if ((symbol.size() > quote.size()) && (symbol.compare(symbol.size() - quote.size(), quote.size(), quote) == 0))
+			return quote;
+	}
+
+	return symbol.substr(symbol.size() > 3 ? symbol.size() - 3 : 0);
+}
+
+string binance::Simulator::getBaseAsset(const string& symbol)
+{
+	return symbol.substr(0, symbol.size() - getQuoteAsset(symbol).size());
+}
+
+Json::Value binance::Simulator::getError(int code, const char* msg)
+{
+	Json::Value error;
+	error["code"] = code;
+	error["msg"] = msg;
+	return error;
+}
+
+// Rejected as by the exchange: HTTP 400 with the error object in json_result.
+static binanceError_t reject(const Json::Value& json_result)
+{
+	binanceErrorInfo_t error;
+	error.status = binanceErrorServer;
+	error.code = json_result["code"].asInt();
+	error.msg = json_result["msg"].asString();
+	error.httpStatus = 400;
+	binanceSetLastError(error);
+
+	return binanceErrorServer;
+}
+
+Json::Value binance::Simulator::toJson(const Order& order)
+{
+	Json::Value json;
+	json["symbol"] = order.symbol;
+	json["orderId"] = (Json::Int64)order.orderId;
+	json["orderListId"] = -1;
+	json["clientOrderId"] = order.clientOrderId;
+	json["price"] = toString(order.price);
+	json["origQty"] = toString(order.origQty);
+	json["executedQty"] = toString(order.executedQty);
+	json["cummulativeQuoteQty"] = toString(order.cummulativeQuoteQty);
+	json["status"] = order.status;
+	json["timeInForce"] = order.timeInForce;
+	json["type"] = order.type;
+	json["side"] = order.side;
+	json["stopPrice"] = toString(order.stopPrice);
+	json["icebergQty"] = toString(0.0);
+	json["time"] = (Json::Int64)order.time;
+	json["updateTime"] = (Json::Int64)order.updateTime;
+	json["isWorking"] = (order.status == "NEW") || (order.status == "PARTIALLY_FILLED");
+	json["origQuoteOrderQty"] = toString(0.0);
+	return json;
+}
+
+// Part of the balance held by the open orders.
+double binance::Simulator::getLocked(const string& asset) const
+{
+	double locked = 0;
+	for (map<long, Order>::const_iterator it = orders.begin(); it != orders.end(); it++)
+	{
+		const Order& order = it->second;
+		if ((order.status != "NEW") && (order.status != "PARTIALLY_FILLED"))
+			continue;
+		if ((order.side == "BUY") && (getQuoteAsset(order.symbol) == asset))
+			locked += (order.origQty - order.executedQty) * order.price;
+		else if ((order.side == "SELL") && (getBaseAsset(order.symbol) == asset))
+			locked += order.origQty - order.executedQty;
+	}
+
+	return locked;
+}
+
+// Execution report event, see OrderTracker::onExecutionReport.
+void binance::Simulator::report(const Order& order, const char* executionType, const Fill* fill, bool maker,
+	vector<Json::Value>& events)
+{
+	Json::Value event;
+	event["e"] = "executionReport";
+	event["E"] = (Json::Int64)get_current_ms_epoch();
+	event["s"] = order.symbol;
+	event["c"] = order.clientOrderId;
+	event["S"] = order.side;
+	event["o"] = order.type;
+	event["f"] = order.timeInForce;
+	event["q"] = toString(order.origQty);
+	event["p"] = toString(order.price);
+	event["P"] = toString(order.stopPrice);
+	event["F"] = toString(0.0);
+	event["g"] = -1;
+	event["C"] = order.origClientOrderId;
+	event["x"] = executionType;
+	event["X"] = order.status;
+	event["r"] = "NONE";
+	event["i"] = (Json::Int64)order.orderId;
+	event["l"] = toString(fill ? fill->qty : 0.0);
+	event["z"] = toString(order.executedQty);
+	event["L"] = toString(fill ? fill->price : 0.0);
+	event["n"] = toString(fill ? fill->commission : 0.0);
+	event["N"] = fill ? Json::Value(fill->commissionAsset) : Json::Value(Json::nullValue);
+	event["T"] = (Json::Int64)order.updateTime;
+	event["t"] = fill ? (Json::Int64)fill->tradeId : (Json::Int64)-1;
+	event["I"] = 0;
+	event["w"] = (order.status == "NEW") || (order.status == "PARTIALLY_FILLED");
+	event["m"] = maker;
+	event["M"] = false;
+	event["O"] = (Json::Int64)order.time;
+	event["Z"] = toString(order.cummulativeQuoteQty);
+	event["Y"] = toString(fill ? fill->price * fill->qty : 0.0);
+	event["Q"] = toString(0.0);
+	events.push_back(event);
+
+	if (!fill)
+		return;
+
+	// The balances of both assets of the symbol have changed.
+	Json::Value position;
+	position["e"] = "outboundAccountPosition";
+	position["E"] = event["E"];
+	position["u"] = event["T"];
+	const string assets[] = { getBaseAsset(order.symbol), getQuoteAsset(order.symbol) };
+	for (int i = 0; i < 2; i++)
+	{
+		const double locked = getLocked(assets[i]);
+
+		Json::Value balance;
+		balance["a"] = assets[i];
+		balance["f"] = toString(balances[assets[i]] - locked);
+		balance["l"] = toString(locked);
+		position["B"].append(balance);
+	}
+	events.push_back(position);
+}
+
+void binance::Simulator::fill(Order& order, double price, double qty, bool maker, vector<Fill>& fills,
+	vector<Json::Value>& events)
+{
+	const string base = getBaseAsset(order.symbol);
+	const string quote = getQuoteAsset(order.symbol);
+	const double rate = maker ? makerRate : takerRate;
+
+	Fill fill;
+	fill.price = price;
+	fill.qty = qty;
+	fill.tradeId = nextTradeId++;
+	if (order.side == "BUY")
+	{
+		fill.commission = qty * rate;
+		fill.commissionAsset = base;
+		balances[base] += qty - fill.commission;
+		balances[quote] -= qty * price;
+	}
+	else
+	{
+		fill.commission = qty * price * rate;
+		fill.commissionAsset = quote;
+		balances[base] -= qty;
+		balances[quote] += qty * price - fill.commission;
+	}
+
+	order.executedQty += qty;
+	order.cummulativeQuoteQty += qty * price;
+	order.status = (order.origQty - order.executedQty > epsilon) ? "PARTIALLY_FILLED" : "FILLED";
+	order.updateTime = get_current_ms_epoch();
+
+	fills.push_back(fill);
+	report(order, "TRADE", &fill, maker, events);
+}
+
+// Take the liquidity of the book up to the limit price, if any.
+void binance::Simulator::take(Order& order, vector<Fill>& fills, vector<Json::Value>& events)
+{
+	Book& book = books[order.symbol];
+	const bool market = (order.type == "MARKET");
+	if (order.side == "BUY")
+	{
+		while (order.origQty - order.executedQty > epsilon)
+		{
+			map<double, double>::iterator level = book.asks.begin();
+			if ((level == book.asks.end()) || (!market && (level->first > order.price)))
+				break;
+			const double qty = min(level->second, order.origQty - order.executedQty);
+			fill(order, level->first, qty, false, fills, events);
+			if ((level->second -= qty) <= epsilon)
+				book.asks.erase(level);
+		}
+	}
+	else
+	{
+		while (order.origQty - order.executedQty > epsilon)
+		{
+			map<double, double, greater<double> >::iterator level = book.bids.begin();
+			if ((level == book.bids.end()) || (!market && (level->first < order.price)))
+				break;
+			const double qty = min(level->second, order.origQty - order.executedQty);
+			fill(order, level->first, qty, false, fills, events);
+			if ((level->second -= qty) <= epsilon)
+				book.bids.erase(level);
+		}
+	}
+}
+
+// Fill the resting orders the market has gone through, as a maker at their price:
+// the book now crossing them, or a trade strictly beyond their price.
+void binance::Simulator::matchResting(const string& symbol, double tradePrice, double tradeQty,
+	vector<Json::Value>& events)
+{
+	Book& book = books[symbol];
+	for (map<long, Order>::iterator it = orders.begin(); it != orders.end(); it++)
+	{
+		Order& order = it->second;
+		if ((order.symbol != symbol) || ((order.status != "NEW") && (order.status != "PARTIALLY_FILLED")))
+			continue;
+
+		const bool buy = (order.side == "BUY");
+		vector<Fill> fills;
+		if (tradeQty > epsilon && (buy ? (tradePrice < order.price) : (tradePrice > order.price)))
+		{
+			const double qty = min(tradeQty, order.origQty - order.executedQty);
+			fill(order, order.price, qty, true, fills, events);
+			tradeQty -= qty;
+		}
+
+		if (buy)
+		{
+			for (map<double, double>::iterator level = book.asks.begin();
+				(level != book.asks.end()) && (level->first <= order.price) &&
+				(order.origQty - order.executedQty > epsilon); )
+			{
+				const double qty = min(level->second, order.origQty - order.executedQty);
+				fill(order, order.price, qty, true, fills, events);
+				if ((level->second -= qty) <= epsilon)
+					level = book.asks.erase(level);
+			}
+		}
+		else
+		{
+			for (map<double, double, greater<double> >::iterator level = book.bids.begin();
+				(level != book.bids.end()) && (level->first >= order.price) &&
+				(order.origQty - order.executedQty > epsilon); )
+			{
+				const double qty = min(level->second, order.origQty - order.executedQty);
+				fill(order, order.price, qty, true, fills, events);
+				if ((level->second -= qty) <= epsilon)
+					level = book.bids.erase(level);
+			}
+		}
+
+	}
+}
+
+static void setLevels(const Json::Value& levels, map<double, double, greater<double> >* bids, map<double, double>* asks)
+{
+	for (Json::Value::ArrayIndex i = 0; i < levels.size(); i++)
+	{
+		const double price = atof(levels[i][0].asString().c_str());
+		const double qty = atof(levels[i][1].asString().c_str());
+		if (bids)
+		{
+			if (qty > epsilon)
+				(*bids)[price] = qty;
+			else
+				bids->erase(price);
+		}
+		else
+		{
+			if (qty > epsilon)
+				(*asks)[price] = qty;
+			else
+				asks->erase(price);
+		}
+	}
+}
+
+void binance::Simulator::update(const string& symbol, const Json::Value& json_value, vector<Json::Value>& events)
+{
+	const string event = json_value["e"].asString();
+	if (json_value.isMember("bids") && json_value.isMember("asks"))
+	{
+		// Partial book depth, or the REST snapshot.
+		Book& book = books[symbol];
+		book.bids.clear();
+		book.asks.clear();
+		setLevels(json_value["bids"], &book.bids, NULL);
+		setLevels(json_value["asks"], NULL, &book.asks);
+		book.stale = false;
+	}
+	else if (event == "depthUpdate")
+	{
+		Book& book = books[symbol];
+		if (book.stale)
+			return;
+		setLevels(json_value["b"], &book.bids, NULL);
+		setLevels(json_value["a"], NULL, &book.asks);
+	}
+	else if ((event.empty() || (event == "bookTicker")) && json_value["b"].isString() && json_value["a"].isString())
+	{
+		// The best levels replace all the ones in front of them.
+		Book& book = books[symbol];
+		const double bid = atof(json_value["b"].asString().c_str());
+		const double ask = atof(json_value["a"].asString().c_str());
+		book.bids.erase(book.bids.begin(), book.bids.lower_bound(bid));
+		book.asks.erase(book.asks.begin(), book.asks.lower_bound(ask));
+		book.bids[bid] = atof(json_value["B"].asString().c_str());
+		book.asks[ask] = atof(json_value["A"].asString().c_str());
+	}
+	else if ((event == "trade") || (event == "aggTrade"))
+	{
+		matchResting(symbol, atof(json_value["p"].asString().c_str()), atof(json_value["q"].asString().c_str()), events);
+		return;
+	}
+	else
+		return;
+
+	matchResting(symbol, 0, 0, events);
+}
+
+void binance::Simulator::onMarketData(const string& path, const Json::Value& json_value)
+{
+	if (!anySimulator.load(memory_order_relaxed) || !json_value.isObject())
+		return;
+
+	// Combined streams wrap the event along with the stream name.
+	if (json_value["stream"].isString() && json_value["data"].isObject())
+	{
+		onMarketData(json_value["stream"].asString(), json_value["data"]);
+		return;
+	}
+
+	string symbol;
+	if (json_value["s"].isString())
+		symbol = json_value["s"].asString();
+	else
+	{
+		const size_t begin = path.rfind('/') + 1;
+		symbol = path.substr(begin, path.find('@', begin) - begin);
+		string_toupper(symbol);
+	}
+	if (symbol.empty())
+		return;
+
+	vector<Simulator*> simulators;
+	{
+		lock_guard<mutex> guard(simulatorsLock);
+		for (map<string, Simulator*>::iterator it = getSimulators().begin(); it != getSimulators().end(); it++)
+			simulators.push_back(it->second);
+	}
+
+	for (size_t i = 0; i < simulators.size(); i++)
+	{
+		vector<Json::Value> events;
+		{
+			lock_guard<mutex> guard(simulators[i]->lock);
+			simulators[i]->update(symbol, json_value, events);
+			simulators[i]->post(events);
+		}
+		simulators[i]->deliver();
+	}
+}
+
+void binance::Simulator::resetBook(const string& symbol)
+{
+	if (!anySimulator.load(memory_order_relaxed))
+		return;
+
+	vector<Simulator*> simulators;
+	{
+		lock_guard<mutex> guard(simulatorsLock);
+		for (map<string, Simulator*>::iterator it = getSimulators().begin(); it != getSimulators().end(); it++)
+			simulators.push_back(it->second);
+	}
+
+	for (size_t i = 0; i < simulators.size(); i++)
+	{
+		lock_guard<mutex> guard(simulators[i]->lock);
+		Book& book = simulators[i]->books[symbol];
+		book.bids.clear();
+		book.asks.clear();
+		book.stale = true;
+	}
+}
+
+// Queue the events, under the lock they were created with.
+void binance::Simulator::post(const vector<Json::Value>& events)
+{
+	outbox.insert(outbox.end(), events.begin(), events.end());
+}
+
+// Deliver the queued events in order, from one thread at a time: the
+// order entry calls and the websocket service thread both create events.
+// Whoever finds the delivery idle delivers all of them, including those
+// queued meanwhile by other threads or by the callbacks themselves.
+void binance::Simulator::deliver()
+{
+	{
+		lock_guard<mutex> guard(lock);
+		if (delivering)
+			return;
+		delivering = true;
+	}
+
+	while (1)
+	{
+		Json::Value event;
+		CB cb;
+		OrderTracker *orderTracker;
+		{
+			lock_guard<mutex> guard(lock);
+			if (outbox.empty())
+			{
+				delivering = false;
+				return;
+			}
+			event.swap(outbox.front());
+			outbox.pop_front();
+			cb = user_cb;
+			orderTracker = tracker;
+		}
+
+		if (orderTracker)
+			orderTracker->onUserData(event);
+		if (cb)
+			cb(event);
+	}
+}
+
+Simulator::Order* binance::Simulator::findOrder(const char *symbol, long orderId, const char *origClientOrderId)
+{
+	if (orderId > 0)
+	{
+		map<long, Order>::iterator it = orders.find(orderId);
+		if ((it != orders.end()) && (it->second.symbol == symbol))
+			return &it->second;
+		return NULL;
+	}
+
+	if (!origClientOrderId || !origClientOrderId[0])
+		return NULL;
+
+	// The latest order of the client id.
+	for (map<long, Order>::reverse_iterator it = orders.rbegin(); it != orders.rend(); it++)
+		if ((it->second.symbol == symbol) && (it->second.clientOrderId == origClientOrderId))
+			return &it->second;
+
+	return NULL;
+}
+
+binanceError_t binance::Simulator::sendOrder(Json::Value &json_result, const char *symbol, const char *side,
+	const char *type, const char *timeInForce, double quantity, double price, const char *newClientOrderId,
+	double stopPrice)
+{
+	binanceSetLastError(binanceErrorInfo_t());
+
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<Simulator::sendOrder> %s %s %s %f @ %f", symbol, side, type, quantity, price);
+
+	json_result = Json::Value();
+
+	double latency;
+	{
+		lock_guard<mutex> guard(lock);
+		latency = latencyMs;
+	}
+	wait(latency / 2);
+
+	vector<Json::Value> events;
+	{
+		lock_guard<mutex> guard(lock);
+
+		const string type_(type ? type : "");
+		const string side_(side ? side : "");
+		if (!symbol || !symbol[0] || ((side_ != "BUY") && (side_ != "SELL")))
+			json_result = getError(-1102, "Mandatory parameter was not sent, was empty/null, or malformed.");
+		else if ((type_ != "LIMIT") && (type_ != "MARKET") && (type_ != "LIMIT_MAKER"))
+			json_result = getError(-1116, "Invalid orderType.");
+		else if (quantity <= 0)
+			json_result = getError(-1013, "Invalid quantity.");
+		else if ((type_ != "MARKET") && (price <= 0))
+			json_result = getError(-1013, "Invalid price.");
+		else
+		{
+			const Order* duplicate = findOrder(symbol, 0, newClientOrderId);
+			if (duplicate && ((duplicate->status == "NEW") || (duplicate->status == "PARTIALLY_FILLED")))
+				json_result = getError(-2010, "Duplicate order sent.");
+		}
+		if (!json_result.isNull())
+		{
+			BINANCE_LOG_ERROR(binanceLogAccount, "<Simulator::sendOrder> Error ! %s", json_result["msg"].asString().c_str());
+			return reject(json_result);
+		}
+
+		Order order;
+		order.symbol = symbol;
+		order.orderId = nextOrderId++;
+		order.clientOrderId = (newClientOrderId && newClientOrderId[0]) ?
+			newClientOrderId : "sim-" + to_string(order.orderId);
+		order.side = side_;
+		order.type = type_;
+		order.timeInForce = (type_ == "LIMIT") ? ((timeInForce && timeInForce[0]) ? timeInForce : "GTC") : "GTC";
+		order.price = (type_ == "MARKET") ? 0 : price;
+		order.stopPrice = stopPrice;
+		order.origQty = quantity;
+		order.executedQty = 0;
+		order.cummulativeQuoteQty = 0;
+		order.status = "NEW";
+		order.time = order.updateTime = get_current_ms_epoch();
+
+		const Book& book = books[order.symbol];
+		const bool crosses = (order.side == "BUY") ?
+			(!book.asks.empty() && ((type_ == "MARKET") || (book.asks.begin()->first <= order.price))) :
+			(!book.bids.empty() && ((type_ == "MARKET") || (book.bids.begin()->first >= order.price)));
+		if ((type_ == "LIMIT_MAKER") && crosses)
+		{
+			json_result = getError(-2010, "Order would immediately match and take.");
+			return reject(json_result);
+		}
+
+		// Fill or kill needs all of the quantity available up to the price.
+		bool kill = false;
+		if (order.timeInForce == "FOK")
+		{
+			double available = 0;
+			if (order.side == "BUY")
+			{
+				for (map<double, double>::const_iterator it = book.asks.begin();
+					(it != book.asks.end()) && (it->first <= order.price); it++)
+					available += it->second;
+			}
+			else
+			{
+				for (map<double, double, greater<double> >::const_iterator it = book.bids.begin();
+					(it != book.bids.end()) && (it->first >= order.price); it++)
+					available += it->second;
+			}
+			kill = (available + epsilon < order.origQty);
+		}
+
+		Order& stored = orders[order.orderId];
+		stored = order;
+		report(stored, "NEW", NULL, false, events);
+
+		vector<Fill> fills;
+		if (!kill)
+			take(stored, fills, events);
+
+		// Market orders and IOC/FOK do not rest in the book.
+		if ((stored.origQty - stored.executedQty > epsilon) &&
+			((type_ == "MARKET") || (stored.timeInForce == "IOC") || (stored.timeInForce == "FOK")))
+		{
+			stored.status = "EXPIRED";
+			stored.updateTime = get_current_ms_epoch();
+			report(stored, "EXPIRED", NULL, false, events);
+		}
+		post(events);
+
+		json_result = toJson(stored);
+		json_result["transactTime"] = (Json::Int64)stored.time;
+		json_result["fills"] = Json::Value(Json::arrayValue);
+		for (size_t i = 0; i < fills.size(); i++)
+		{
+			Json::Value fill;
+			fill["price"] = toString(fills[i].price);
+			fill["qty"] = toString(fills[i].qty);
+			fill["commission"] = toString(fills[i].commission);
+			fill["commissionAsset"] = fills[i].commissionAsset;
+			fill["tradeId"] = (Json::Int64)fills[i].tradeId;
+			json_result["fills"].append(fill);
+		}
+	}
+
+	deliver();
+	wait(latency / 2);
+
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<Simulator::sendOrder> Done.");
+
+	return binanceSuccess;
+}
+
+binanceError_t binance::Simulator::cancelOrder(Json::Value &json_result, const char *symbol,
+	long orderId, const char *origClientOrderId, const char *newClientOrderId)
+{
+	binanceSetLastError(binanceErrorInfo_t());
+
+	BINANCE_LOG_DEBUG(binanceLogAccount, "<Simulator::cancelOrder> %s %ld", symbol, orderId);
+
+	json_result = Json::Value();
+
+	double latency;
+	{
+		lock_guard<mutex> guard(lock);
+		latency = latencyMs;
+	}
+	wait(latency / 2);
+
+	vector<Json::Value> events;
+	{
+		lock_guard<mutex> guard(lock);
+		Order* order = findOrder(symbol, orderId, origClientOrderId);
+		if (!order || ((order->status != "NEW") && (order->status != "PARTIALLY_FILLED")))
+		{
+			json_result = getError(-2011, "Unknown order sent.");
+			BINANCE_LOG_ERROR(binanceLogAccount, "<Simulator::cancelOrder> Error ! %s", json_result["msg"].asString().c_str());
+			return reject(json_result);
+		}
+
+		order->origClientOrderId = order->clientOrderId;
+		order->clientOrderId = (newClientOrderId && newClientOrderId[0]) ?
+			newClientOrderId : "sim-cancel-" + to_string(order->orderId);
+		order->status = "CANCELED";
+		order->updateTime = get_current_ms_epoch();
+		report(*order, "CANCELED", NULL, false, events);
+		post(events);
+
+		json_result = toJson(*order);
+		json_result["origClientOrderId"] = order->origClientOrderId;
+		json_result["transactTime"] = (Json::Int64)order->updateTime;
+	}
+
+	deliver();
+	wait(latency / 2);
+
+	return binanceSuccess;
+}
+
+binanceError_t binance::Simulator::getOrder(Json::Value &json_result, const char *symbol,
+	long orderId, const char *origClientOrderId)
+{
+	binanceSetLastError(binanceErrorInfo_t());
+
+	lock_guard<mutex> guard(lock);
+	const Order* order = findOrder(symbol, orderId, origClientOrderId);
+	if (!order)
+	{
+		json_result = getError(-2013, "Order does not exist.");
+		return reject(json_result);
+	}
+
+	json_result = toJson(*order);
+	return binanceSuccess;
+}
+
+binanceError_t binance::Simulator::getOpenOrders(Json::Value &json_result, const char *symbol)
+{
+	binanceSetLastError(binanceErrorInfo_t());
+
+	lock_guard<mutex> guard(lock);
+	json_result = Json::Value(Json::arrayValue);
+	for (map<long, Order>::const_iterator it = orders.begin(); it != orders.end(); it++)
+	{
+		const Order& order = it->second;
+		if (((order.status == "NEW") || (order.status == "PARTIALLY_FILLED")) &&
+			(!symbol || (order.symbol == symbol)))
+			json_result.append(toJson(order));
+	}
+
+	return binanceSuccess;
+}
+
+binanceError_t binance::Simulator::getAllOrders(Json::Value &json_result, const char *symbol, long orderId, int limit)
+{
+	binanceSetLastError(binanceErrorInfo_t());
+
+	if (limit <= 0)
+		limit = 500;
+
+	lock_guard<mutex> guard(lock);
+	json_result = Json::Value(Json::arrayValue);
+	for (map<long, Order>::const_iterator it = orders.lower_bound(orderId);
+		(it != orders.end()) && ((int)json_result.size() < limit); it++)
+		if (it->second.symbol == symbol)
+			json_result.append(toJson(it->second));
+
+	return binanceSuccess;
+}
+
+binanceError_t binance::Simulator::getInfo(Json::Value &json_result)
+{
+	binanceSetLastError(binanceErrorInfo_t());
+
+	lock_guard<mutex> guard(lock);
+	json_result = Json::Value(Json::objectValue);
+	json_result["makerCommission"] = (int)(makerRate * 10000);
+	json_result["takerCommission"] = (int)(takerRate * 10000);
+	json_result["canTrade"] = true;
+	json_result["canWithdraw"] = false;
+	json_result["canDeposit"] = false;
+	json_result["updateTime"] = (Json::Int64)get_current_ms_epoch();
+	json_result["accountType"] = "SPOT";
+	json_result["balances"] = Json::Value(Json::arrayValue);
+	for (map<string, double>::const_iterator it = balances.begin(); it != balances.end(); it++)
+	{
+		const double locked = getLocked(it->first);
+
+		Json::Value balance;
+		balance["asset"] = it->first;
+		balance["free"] = toString(it->second - locked);
+		balance["locked"] = toString(locked);
+		json_result["balances"].append(balance);
+	}
+
+	return binanceSuccess;
+}
+
@@ -6,8 +6,13 @@
 */
 
 #include "binance_utils.h"
+#include "binance_latency.h"
 
+#include <cerrno>
+#include <chrono>
 #include <cstring>
+#include <mutex>
+#include <sys/stat.h>
 #include <sys/time.h>
 #include <mbedtls/sha256.h>
 #include <mbedtls/md.h>
@@ -82,7 +87,7 @@ time_t binance::get_current_epoch( )
 	return tv.tv_sec ;
 }
 
-unsigned long binance::get_current_ms_epoch( )
+unsigned long binance::get_local_ms_epoch( )
 {
 	struct timeval tv;
 	gettimeofday(&tv, NULL); 
@@ -90,8 +95,81 @@ unsigned long binance::get_current_ms_epoch( )
 	return tv.tv_sec * 1000 + tv.tv_usec / 1000;
 }
 
+double binance::get_monotonic_ms( )
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Exchange clock model: server_ms(t) = base_server_ms + (t - base_mono_ms) * (1 + drift)
+struct ServerClock
+{
+	mutex lock;
+	bool valid;
+	double base_mono_ms;
+	double base_server_ms;
+	double drift;
+
+	ServerClock() : valid(false), base_mono_ms(0), base_server_ms(0), drift(0) { }
+};
+
+static ServerClock server_clock;
+
+void binance::set_server_clock(double mono_ms, double server_ms, double drift)
+{
+	lock_guard<mutex> guard(server_clock.lock);
+	server_clock.base_mono_ms = mono_ms;
+	server_clock.base_server_ms = server_ms;
+	server_clock.drift = drift;
+	server_clock.valid = true;
+}
+
+bool binance::get_server_clock(double &offset_ms, double &drift)
+{
+	const double mono_ms = get_monotonic_ms();
+	const double local_ms = get_local_ms_epoch();
+
+	lock_guard<mutex> guard(server_clock.lock);
+	if (!server_clock.valid)
+		return false;
+
+	offset_ms = server_clock.base_server_ms + (mono_ms - server_clock.base_mono_ms) * (1 + server_clock.drift) - local_ms;
+	drift = server_clock.drift;
+	return true;
+}
+
+bool binance::make_directories( const string& path )
+{
+	for (size_t pos = path.find('/', 1); ; pos = path.find('/', pos + 1))
+	{
+		const string dir = path.substr(0, pos);
+		if ((mkdir(dir.c_str(), 0755) != 0) && (errno != EEXIST))
+			return false;
+
+		if (pos == string::npos)
+			break;
+	}
+
+	return true;
+}
+
+unsigned long binance::get_current_ms_epoch( )
+{
+	{
+		lock_guard<mutex> guard(server_clock.lock);
+		if (server_clock.valid)
+		{
+			const double mono_ms = get_monotonic_ms();
+			return (unsigned long)(server_clock.base_server_ms +
+				(mono_ms - server_clock.base_mono_ms) * (1 + server_clock.drift));
+		}
+	}
+
+	return get_local_ms_epoch();
+}
+
 string binance::hmac_sha256( const char *key, const char *data)
 {
+	LatencyScope scope( Latency::Sign );
 	unsigned char digest[32];
 	mbedtls_md_hmac( mbedtls_md_info_from_type( MBEDTLS_MD_SHA256 ),
 		reinterpret_cast<const unsigned char*>(key), strlen(key),
@@ -5,11 +5,24 @@
 	C++ library for Binance API.
 */
 
+#include "binance.h"
 #include "binance_websocket.h"
+#include "binance_latency.h"
 #include "binance_logger.h"
+#include "binance_metrics.h"
+#include "binance_order_tracker.h"
+#include "binance_recorder.h"
+#include "binance_simulator.h"
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <libwebsockets.h>
+#include <mutex>
+#include <netdb.h>
+#include <random>
+#include <sys/socket.h>
+#include <thread>
 #include <unordered_map>
 #include <csignal>
 
@@ -17,9 +30,60 @@ using namespace binance;
 using namespace std;
 
 static struct lws_context *context;
+static std::string ws_host = BINANCE_WS_HOST;
+static int ws_port = BINANCE_WS_PORT;
+static bool ws_ssl = true;
+/* address of ws_host resolved by warm_up(), connected to without a DNS lookup */
+static std::mutex ws_address_lock;
+static std::string ws_address;
 static atomic<int> protocol_init(0);
 static atomic<int> lws_service_cancelled(0);
 static int force_create_ccinfo(const std::string &path);
+
+/*
+ * User data stream session: the listenKey is kept alive by a
+ * timer on the event loop, while the blocking REST calls are
+ * made by short-lived worker threads, so that the service
+ * thread is never blocked by them.
+ */
+struct user_data_stream;
+
+struct user_stream_timer {
+  lws_sorted_usec_list_t sul;
+  user_data_stream *stream;
+};
+
+struct user_data_stream {
+  user_stream_timer keepalive;
+  Account *account;
+  OrderTracker *tracker;
+  CB json_cb;
+  std::mutex lock;         /* guards listen_key and ws_path */
+  std::string listen_key;
+  std::string ws_path;
+  atomic<bool> active;
+  atomic<bool> busy;        /* keepalive or re-create in progress */
+  atomic<bool> reconciling;
+
+  user_data_stream() : account(nullptr), tracker(nullptr), json_cb(nullptr),
+    active(false), busy(false), reconciling(false) {
+    memset(&keepalive, 0, sizeof(keepalive));
+    keepalive.stream = this;
+  }
+};
+
+/* listenKey is valid for 60 minutes, Binance recommends a keepalive every 30 */
+static const lws_usec_t user_stream_keepalive_us = (lws_usec_t)30 * 60 * LWS_US_PER_SEC;
+
+static std::unordered_map<Account *, user_data_stream> user_streams;
+
+struct endpoint_connection;
+
+struct endpoint_timer {
+  lws_sorted_usec_list_t sul;
+  endpoint_connection *conn;
+};
+
 /*
  * This "contains" the endpoint connection property and has
  * the connection bound to it
@@ -31,13 +95,42 @@ struct endpoint_connection {
   std::string ws_path;
   atomic<bool> close_conn;
   atomic<bool> creating_conn;
+  user_data_stream *user_stream; /* set for user data stream endpoints */
+  Recorder::Stream recorder_stream;
+  bool established; /* counted in binance_ws_connected */
+  endpoint_timer reconnect;
+  bool reconnect_pending; /* the timer is armed, for a reconnection or the removal */
+  std::unordered_map<std::string, uint64_t> last_update_id; /* u of the last depthUpdate, by symbol */
+  Metrics::Counter messages, bytes, reconnects, parse_errors, gaps;
+
+  endpoint_connection() : wsi(nullptr), retry_count(0), json_cb(nullptr), close_conn(false),
+    creating_conn(false), user_stream(nullptr), established(false), reconnect_pending(false) {
+    memset(&reconnect, 0, sizeof(reconnect));
+    reconnect.conn = this;
+  }
 };
 
 static std::unordered_map<std::string, endpoint_connection> endpoints_prop;
 static pthread_mutex_t lock_concurrent; /* serialize access */
 
+/* connected websockets, over all endpoints */
+static Metrics::Gauge ws_connected() {
+  static const Metrics::Gauge gauge = Metrics::getGauge("binance_ws_connected", "Connected websocket endpoints");
+  return gauge;
+}
+
+static void set_stream_metrics(endpoint_connection &conn, const std::string &path) {
+  const Metrics::Labels labels(1, std::make_pair(std::string("stream"), path));
+  conn.messages = Metrics::getCounter("binance_ws_messages_total", "Websocket frames received", labels);
+  conn.bytes = Metrics::getCounter("binance_ws_bytes_total", "Websocket payload bytes received", labels);
+  conn.reconnects = Metrics::getCounter("binance_ws_reconnects_total", "Websocket reconnections", labels);
+  conn.parse_errors = Metrics::getCounter("binance_ws_parse_errors_total", "Websocket frames failing to parse", labels);
+  conn.gaps = Metrics::getCounter("binance_ws_sequence_gaps_total", "Depth updates found missing", labels);
+}
+
 /*
- * The retry and backoff policy we want to use for our client connections
+ * The retry and backoff policy lws uses for its own retries; the
+ * endpoints are reconnected by reconnect_cb() instead, see below
  */
 static const uint32_t backoff_ms[] = {1000 * 4, 1000 * 5, 1000 * 6, 1000 * 7, 1000 * 8, 1000 * 9};
 
@@ -60,6 +153,259 @@ static const lws_retry_bo_t retry = {
      */
 };
 
+/*
+ * Reconnection of the endpoints, each on its own timer: an endpoint
+ * that keeps failing is retried less and less often, and finally
+ * dropped, while the others keep streaming.
+ */
+static atomic<unsigned int> reconnect_base_ms(500);
+static atomic<unsigned int> reconnect_max_ms(30000);
+static atomic<unsigned int> reconnect_max_retries(0); /* 0 retries forever */
+
+/* endpoints that failed to connect from another thread, picked up by the service thread */
+static std::vector<std::string> pending_reconnects;
+
+static atomic<RESYNC_CB> resync_cb(nullptr);
+
+static lws_usec_t reconnect_delay_us(uint16_t retry_count) {
+  /* used by the service thread only */
+  static std::minstd_rand random(std::random_device{}());
+
+  unsigned long long bound = reconnect_base_ms.load();
+  bound <<= std::min(std::max((int)retry_count - 1, 0), 20);
+  bound = std::min(bound, (unsigned long long)reconnect_max_ms.load());
+
+  /* so that the endpoints dropped together do not come back in lockstep */
+  const unsigned long long jitter = bound * 3 / 10;
+  const unsigned long long delay_ms = bound - (jitter ? random() % (jitter + 1) : 0);
+  return (lws_usec_t)delay_ms * LWS_US_PER_MS;
+}
+
+static void reconnect_cb(lws_sorted_usec_list_t *sul);
+
+/* called on the service thread, under lock_concurrent */
+static void schedule_reconnect(endpoint_connection &conn) {
+  if (conn.reconnect_pending)
+    return;
+
+  if (conn.retry_count < UINT16_MAX)
+    conn.retry_count++;
+  const unsigned int max_retries = reconnect_max_retries.load();
+  if (max_retries && conn.retry_count > max_retries) {
+    /* removed by the timer, once lws is done with the connection */
+    BINANCE_LOG_ERROR(binanceLogWs, "<binance::Websocket::schedule_reconnect> giving up on %s after %d retries",
+        conn.ws_path.c_str(), conn.retry_count - 1);
+    atomic_store(&conn.close_conn, true);
+  } else {
+    conn.reconnects.add();
+  }
+
+  const lws_usec_t delay_us = reconnect_delay_us(conn.retry_count);
+  BINANCE_LOG_INFO(binanceLogWs, "<binance::Websocket::schedule_reconnect> %s in %lld ms, retry_count[%d]",
+      conn.ws_path.c_str(), (long long)(delay_us / LWS_US_PER_MS), conn.retry_count);
+  conn.reconnect_pending = true;
+  lws_sul_schedule(context, 0, &conn.reconnect.sul, reconnect_cb, delay_us);
+}
+
+/* Reconnect timer callback, called on the service thread */
+static void reconnect_cb(lws_sorted_usec_list_t *sul) {
+  endpoint_connection *conn = lws_container_of(sul, endpoint_timer, sul)->conn;
+  if (lws_service_cancelled)
+    return;
+
+  const std::string ws_path = conn->ws_path;
+  pthread_mutex_lock(&lock_concurrent);
+  conn->reconnect_pending = false;
+  if (conn->close_conn.load()) {
+    /* disconnected or given up on meanwhile */
+    endpoints_prop.erase(ws_path);
+    BINANCE_LOG_INFO(binanceLogWs, "<binance::Websocket::reconnect_cb> deleted: %s",
+        ws_path.c_str());
+    pthread_mutex_unlock(&lock_concurrent);
+    return;
+  }
+  pthread_mutex_unlock(&lock_concurrent);
+
+  if (force_create_ccinfo(ws_path)) {
+    pthread_mutex_lock(&lock_concurrent);
+    schedule_reconnect(*conn);
+    pthread_mutex_unlock(&lock_concurrent);
+  }
+}
+
+static void connect_endpoint_impl(CB cb, const std::string &path, user_data_stream *user_stream);
+
+enum user_stream_task {
+  USER_STREAM_KEEPALIVE,
+  USER_STREAM_RECREATE,
+};
+
+/* Runs on a worker thread: may block on REST calls */
+static void user_stream_worker(user_data_stream *stream, user_stream_task task) {
+
+  if (task == USER_STREAM_KEEPALIVE) {
+    std::string listen_key;
+    {
+      std::lock_guard<std::mutex> guard(stream->lock);
+      listen_key = stream->listen_key;
+    }
+    if (stream->account->keepUserDataStream(listen_key.c_str()) == binanceSuccess) {
+      atomic_store(&stream->busy, false);
+      return;
+    }
+    BINANCE_LOG_ERROR(binanceLogWs, "<binance::Websocket::user_stream_worker> keepalive failed, re-creating listenKey");
+  }
+
+  Json::Value json_result;
+  if (stream->account->startUserDataStream(json_result) != binanceSuccess ||
+      !json_result["listenKey"].isString()) {
+    /* the next timer tick will try again */
+    BINANCE_LOG_ERROR(binanceLogWs, "<binance::Websocket::user_stream_worker> failed to re-create listenKey");
+    atomic_store(&stream->busy, false);
+    return;
+  }
+
+  std::string old_path;
+  std::string new_path;
+  {
+    std::lock_guard<std::mutex> guard(stream->lock);
+    stream->listen_key = json_result["listenKey"].asString();
+    old_path = stream->ws_path;
+    stream->ws_path = std::string("/ws/") + stream->listen_key;
+    new_path = stream->ws_path;
+  }
+
+  /* the same key is returned for as long as it is still valid */
+  if (new_path != old_path && stream->active.load() && !lws_service_cancelled) {
+    Websocket::disconnect_endpoint(old_path);
+    connect_endpoint_impl(stream->json_cb, new_path, stream);
+  }
+  atomic_store(&stream->busy, false);
+}
+
+/* Runs on a worker thread: may block on REST calls */
+static void user_stream_reconcile(user_data_stream *stream) {
+  if (stream->tracker->reconcile(*stream->account) != binanceSuccess)
+    BINANCE_LOG_ERROR(binanceLogWs, "<binance::Websocket::user_stream_reconcile> failed to reconcile orders");
+  atomic_store(&stream->reconciling, false);
+}
+
+static void user_stream_start(user_data_stream *stream, user_stream_task task) {
+  bool expected = false;
+  if (!stream->busy.compare_exchange_strong(expected, true))
+    return;
+  std::thread(user_stream_worker, stream, task).detach();
+}
+
+/* Keepalive timer callback, called on the service thread */
+static void user_stream_keepalive_cb(lws_sorted_usec_list_t *sul) {
+  user_data_stream *stream = lws_container_of(sul, user_stream_timer, sul)->stream;
+  if (!stream->active.load() || lws_service_cancelled)
+    return;
+
+  lws_sul_schedule(context, 0, &stream->keepalive.sul, user_stream_keepalive_cb, user_stream_keepalive_us);
+  user_stream_start(stream, USER_STREAM_KEEPALIVE);
+}
+
+/* Called on the service thread each time a user data stream gets connected */
+static void user_stream_established(user_data_stream *stream) {
+  if (!stream->active.load())
+    return;
+
+  lws_sul_schedule(context, 0, &stream->keepalive.sul, user_stream_keepalive_cb, user_stream_keepalive_us);
+
+  /* events might have been missed while the stream was down */
+  bool expected = false;
+  if (stream->tracker && stream->reconciling.compare_exchange_strong(expected, true))
+    std::thread(user_stream_reconcile, stream).detach();
+}
+
+/*
+ * The events of a diff depth stream carry the range U..u of the book
+ * updates they contain: the next event starts at u + 1, or on futures
+ * gives the previous u as pu. Anything else means updates went missing.
+ */
+static void check_sequence(endpoint_connection &conn, const Json::Value &json_result) {
+  if (!json_result.isObject())
+    return;
+  /* combined streams wrap the event */
+  const Json::Value &event = json_result.isMember("data") ? json_result["data"] : json_result;
+  if (!event.isObject() || event["e"].asString() != "depthUpdate")
+    return;
+
+  const std::string symbol = event["s"].asString();
+  const uint64_t last = event["u"].asUInt64();
+  uint64_t &previous = conn.last_update_id[symbol];
+  const uint64_t expected = previous;
+  bool gap = false;
+  if (expected) {
+    if (event.isMember("pu"))
+      gap = event["pu"].asUInt64() != expected;
+    else
+      gap = event["U"].asUInt64() > expected + 1;
+  }
+  previous = std::max(expected, last);
+
+  if (gap) {
+    BINANCE_LOG_INFO(binanceLogWs, "<binance::Websocket::check_sequence> %s %s skipped updates after %llu",
+        conn.ws_path.c_str(), symbol.c_str(), (unsigned long long)expected);
+    conn.gaps.add();
+    /* paper trading must not fill against the stale book either */
+    Simulator::resetBook(symbol);
+    const RESYNC_CB cb = resync_cb.load();
+    if (cb)
+      cb(conn.ws_path, symbol);
+  }
+}
+
+/*
+ * Decode a received frame and hand it over to the endpoint, shared by
+ * the live connections and the replay of recorded logs
+ */
+static bool dispatch_frame(endpoint_connection &conn, Json::CharReader &reader, const char *data, size_t len,
+                           Latency::Ticks received) {
+  Json::Value json_result;
+  JSONCPP_STRING err;
+  conn.messages.add();
+  conn.bytes.add(len);
+  const Latency::Ticks parse_begin = Latency::now();
+  if (!reader.parse(data, data + len, &json_result, &err)) {
+    BINANCE_LOG_ERROR(binanceLogWs, "<binance::Websocket::dispatch_frame> LWS_CALLBACK_CLIENT_RECEIVE Error Json:%s",
+        err.c_str());
+    conn.parse_errors.add();
+    return false;
+  }
+  Latency::record(Latency::Parse, parse_begin);
+  user_data_stream *user_stream = conn.user_stream;
+  if (user_stream) {
+    if (user_stream->tracker)
+      user_stream->tracker->onUserData(json_result);
+    if (json_result.isObject() && json_result["e"].asString() == "listenKeyExpired")
+      user_stream_start(user_stream, USER_STREAM_RECREATE);
+  }
+  /* paper trading fills against the market data as it comes */
+  Simulator::onMarketData(conn.ws_path, json_result);
+  check_sequence(conn, json_result);
+  Latency::record(Latency::WsDispatch, received);
+  {
+    LatencyScope scope(Latency::Callback);
+    conn.json_cb(json_result);
+  }
+  conn.retry_count = 0;
+  return true;
+}
+
+static Json::CharReader *new_frame_reader() {
+  Json::CharReaderBuilder builder;
+  return builder.newCharReader();
+}
+
+/* used by the service thread only, under lock_concurrent */
+static std::unique_ptr<Json::CharReader> frame_reader(new_frame_reader());
+
+/* endpoints fed by Websocket::replay(), keyed by the recorded path */
+static std::unordered_map<std::string, endpoint_connection> replay_endpoints;
+
 static int event_cb(lws *wsi, enum lws_callback_reasons reason, void *user, void *in, size_t len);
 
 struct lws_protocols protocols[] =
@@ -83,8 +429,8 @@ static int event_cb(lws *wsi, enum lws_callback_reasons reason, void *user, void
   case LWS_CALLBACK_PROTOCOL_INIT:
   case LWS_CALLBACK_OPENSSL_LOAD_EXTRA_CLIENT_VERIFY_CERTS:
     atomic_store(&protocol_init, 1);
-    lwsl_user("%s: PROTOCOL_INIT OKAY, reason:%d\n",
-              __func__, reason);
+    BINANCE_LOG_INFO(binanceLogWs, "<binance::Websocket::event_cb> PROTOCOL_INIT OKAY, reason:%d",
+        reason);
     break;
 
   case LWS_CALLBACK_WSI_CREATE:
@@ -94,8 +440,8 @@ static int event_cb(lws *wsi, enum lws_callback_reasons reason, void *user, void
         if(!endpoints_prop.at(ws_path).close_conn.load()){
           pthread_mutex_lock(&lock_concurrent);
           endpoints_prop.at(ws_path).wsi = wsi;
-          lwsl_user("%s: create wsi for current_data#:%s ws_path::%s\n",
-                    __func__, ws_path.c_str(), endpoints_prop.at(ws_path).ws_path.c_str());
+          BINANCE_LOG_INFO(binanceLogWs, "<binance::Websocket::event_cb> create wsi for current_data#:%s ws_path::%s",
+              ws_path.c_str(), endpoints_prop.at(ws_path).ws_path.c_str());
           pthread_mutex_unlock(&lock_concurrent);
         }
       }
@@ -109,9 +455,14 @@ static int event_cb(lws *wsi, enum lws_callback_reasons reason, void *user, void
         if(!endpoints_prop.at(ws_path).close_conn.load()){
           pthread_mutex_lock(&lock_concurrent);
           lws_callback_on_writable(wsi);
+          if (!endpoints_prop.at(ws_path).established)
+            ws_connected().add(1);
+          endpoints_prop.at(ws_path).established = true;
           endpoints_prop.at(ws_path).wsi = wsi;
-          lwsl_user("%s: connection established with success current_data#:%s ws_path::%s\n",
-                    __func__, ws_path.c_str(), endpoints_prop.at(ws_path).ws_path.c_str());
+          BINANCE_LOG_INFO(binanceLogWs, "<binance::Websocket::event_cb> connection established with success current_data#:%s ws_path::%s",
+              ws_path.c_str(), endpoints_prop.at(ws_path).ws_path.c_str());
+          if (endpoints_prop.at(ws_path).user_stream)
+            user_stream_established(endpoints_prop.at(ws_path).user_stream);
           pthread_mutex_unlock(&lock_concurrent);
         }
       }
@@ -124,23 +475,16 @@ static int event_cb(lws *wsi, enum lws_callback_reasons reason, void *user, void
       const std::string ws_path = current_data->ws_path;
       if (!ws_path.empty() && ws_path.find("/ws/") != std::string::npos && endpoints_prop.find(ws_path) != endpoints_prop.end()) {
         if(!endpoints_prop.at(ws_path).close_conn.load()){
+          const Latency::Ticks received = Latency::now();
+          const int64_t received_ns = (Recorder::isRecording() &&
+            (!endpoints_prop.at(ws_path).user_stream || Recorder::isRecordingUserData())) ? Recorder::now() : 0;
           pthread_mutex_lock(&lock_concurrent);
-          string str_result = string(reinterpret_cast<const char *>(in), len);
-          Json::Value json_result;
-          JSONCPP_STRING err;
-          Json::CharReaderBuilder builder;
-          const std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
-          if (!reader->parse(str_result.c_str(), str_result.c_str() + str_result.length(), &json_result,
-                             &err)) {
-            lwsl_err("%s: LWS_CALLBACK_CLIENT_RECEIVE Error Json:%s\n",
-                     __func__, err.c_str());
-            json_result.clear();
-            pthread_mutex_unlock(&lock_concurrent);
-            break;
-          }
-          endpoints_prop.at(ws_path).json_cb(json_result);
-          endpoints_prop.at(ws_path).retry_count = 0;
-          json_result.clear();
+          /* the recorder expects a single producer, which the lock ensures */
+          if (received_ns)
+            Recorder::record(endpoints_prop.at(ws_path).recorder_stream, ws_path,
+                             reinterpret_cast<const char *>(in), len, received_ns);
+          dispatch_frame(endpoints_prop.at(ws_path), *frame_reader, reinterpret_cast<const char *>(in), len,
+                         received);
           pthread_mutex_unlock(&lock_concurrent);
         }
         break;
@@ -152,7 +496,7 @@ static int event_cb(lws *wsi, enum lws_callback_reasons reason, void *user, void
   case LWS_CALLBACK_CLOSED :
   case LWS_CALLBACK_CLIENT_WRITEABLE:
     if (in != nullptr){
-      lwsl_err("case LWS_CALLBACK_reason:%d  ERROR: %s\n", reason,
+      BINANCE_LOG_ERROR(binanceLogWs, "<binance::Websocket::event_cb> case LWS_CALLBACK_reason:%d  ERROR: %s", reason,
                in ? (char *) in : "(null)");
     }
     break;
@@ -163,46 +507,67 @@ static int event_cb(lws *wsi, enum lws_callback_reasons reason, void *user, void
   case LWS_CALLBACK_CLOSED_CLIENT_HTTP:
   case LWS_CALLBACK_WSI_DESTROY:
     if (in != nullptr){
-      lwsl_err("case reason:%d  ERROR: %s\n", reason,
+      BINANCE_LOG_ERROR(binanceLogWs, "<binance::Websocket::event_cb> case reason:%d  ERROR: %s", reason,
                in ? (char *) in : "(null)");
     }
 
+    /* the address may be stale, look the host up again on reconnect */
+    if (reason == LWS_CALLBACK_CLIENT_CONNECTION_ERROR) {
+      std::lock_guard<std::mutex> guard(ws_address_lock);
+      ws_address.clear();
+    }
+
     if(!lws_service_cancelled){
       const std::string ws_path = current_data->ws_path;
       if (!ws_path.empty() && ws_path.find("/ws/") != std::string::npos && endpoints_prop.find(ws_path) != endpoints_prop.end()) {
-        if (endpoints_prop.at(ws_path).close_conn.load() && !endpoints_prop.at(ws_path).creating_conn.load()) {
+        if (endpoints_prop.at(ws_path).reconnect_pending) {
+          /* the timer removes or reconnects the endpoint */
+        } else if (endpoints_prop.at(ws_path).close_conn.load() && !endpoints_prop.at(ws_path).creating_conn.load()) {
           pthread_mutex_lock(&lock_concurrent);
+          if (endpoints_prop.at(ws_path).established)
+            ws_connected().add(-1);
+          endpoints_prop.at(ws_path).established = false;
           endpoints_prop.at(ws_path).wsi = nullptr;
           endpoints_prop.at(ws_path).ws_path.clear();
           lws_set_opaque_user_data(wsi, &endpoints_prop.at(ws_path));
           endpoints_prop.erase(ws_path);
-          lwsl_err("reason:%d  deleted: %s : %s\n", reason,
+          BINANCE_LOG_ERROR(binanceLogWs, "<binance::Websocket::event_cb> reason:%d  deleted: %s : %s", reason,
                    in ? (char *) in : "(null)", ws_path.c_str());
           pthread_mutex_unlock(&lock_concurrent);
         } else if(!endpoints_prop.at(ws_path).close_conn.load() && !endpoints_prop.at(ws_path).creating_conn.load()){
           pthread_mutex_lock(&lock_concurrent);
-          endpoints_prop.at(ws_path).retry_count++;
-          endpoints_prop.at(ws_path).wsi = nullptr;
-          pthread_mutex_unlock(&lock_concurrent);
-          if (endpoints_prop.at(ws_path).retry_count > (LWS_ARRAY_SIZE(backoff_ms)) || force_create_ccinfo(ws_path) ) {
-            pthread_mutex_lock(&lock_concurrent);
-            endpoints_prop.at(ws_path).wsi = nullptr;
-            endpoints_prop.at(ws_path).ws_path.clear();
-            lws_set_opaque_user_data(wsi, &endpoints_prop.at(ws_path));
-            endpoints_prop.erase(ws_path);
-            lws_cancel_service(lws_get_context(wsi));
-            atomic_store(&lws_service_cancelled, 1);
-            pthread_mutex_unlock(&lock_concurrent);
-            return -1;
+          endpoint_connection &conn = endpoints_prop.at(ws_path);
+          /* a connection replaced already, or a second event of the same one */
+          if ((!conn.wsi || conn.wsi == wsi) && !conn.reconnect_pending) {
+            if (conn.established)
+              ws_connected().add(-1);
+            conn.established = false;
+            conn.wsi = nullptr;
+            schedule_reconnect(conn);
           }
+          pthread_mutex_unlock(&lock_concurrent);
         }
       }else{
         /*unknown*/
-        lwsl_user("case reason:%d  ERROR unknown WSI: %s\n", reason,
+        BINANCE_LOG_INFO(binanceLogWs, "<binance::Websocket::event_cb> case reason:%d  ERROR unknown WSI: %s", reason,
                   in ? (char *) in : "(null)");
       }
     }
     break;
+  case LWS_CALLBACK_EVENT_WAIT_CANCELLED:
+    /* woken up by connect_endpoint_impl() to retry failed connections */
+    if(!lws_service_cancelled){
+      pthread_mutex_lock(&lock_concurrent);
+      for (const std::string &ws_path : pending_reconnects) {
+        auto it = endpoints_prop.find(ws_path);
+        if (it != endpoints_prop.end() && !it->second.close_conn.load() && !it->second.wsi)
+          schedule_reconnect(it->second);
+      }
+      pending_reconnects.clear();
+      pthread_mutex_unlock(&lock_concurrent);
+    }
+    break;
+
   case LWS_CALLBACK_GET_THREAD_ID: {
 #ifdef __APPLE__
     // On OS X pthread_threadid_np() is used, as pthread_self() returns a structure.
@@ -228,7 +593,7 @@ static int event_cb(lws *wsi, enum lws_callback_reasons reason, void *user, void
 
 
 static void sigint_handler(int sig) {
-  Logger::write_log("<binance::Websocket::sigint_handler> Interactive attention signal : %d\n", sig);
+  BINANCE_LOG_INFO(binanceLogWs, "<binance::Websocket::sigint_handler> Interactive attention signal : %d\n", sig);
   atomic_store(&lws_service_cancelled, 1);
 }
 
@@ -245,18 +610,24 @@ static int force_create_ccinfo(const std::string &path) {
   atomic_store(&endpoints_prop.at(path).creating_conn, true);
   atomic_store(&endpoints_prop.at(path).close_conn, false);
 
+  std::string address;
+  {
+    std::lock_guard<std::mutex> guard(ws_address_lock);
+    address = ws_address.empty() ? ws_host : ws_address;
+  }
+
   struct lws_client_connect_info ccinfo{};
   memset(&ccinfo, 0, sizeof(ccinfo));
   ccinfo.context = context;
-  ccinfo.port = BINANCE_WS_PORT;
-  ccinfo.address = BINANCE_WS_HOST;
+  ccinfo.port = ws_port;
+  ccinfo.address = address.c_str();
   ccinfo.path = endpoints_prop.at(path).ws_path.c_str();
-  ccinfo.host = ccinfo.address;
-  ccinfo.origin = ccinfo.address;
-  ccinfo.ssl_connection = LCCSCF_USE_SSL | LCCSCF_ALLOW_SELFSIGNED |
-      LCCSCF_SKIP_SERVER_CERT_HOSTNAME_CHECK |
-      LCCSCF_PIPELINE | LCCSCF_PRIORITIZE_READS |
+  ccinfo.host = ws_host.c_str();
+  ccinfo.origin = ws_host.c_str();
+  ccinfo.ssl_connection = LCCSCF_PIPELINE | LCCSCF_PRIORITIZE_READS |
       LCCSCF_WAKE_SUSPEND__VALIDITY;
+  if (ws_ssl)
+    ccinfo.ssl_connection |= LCCSCF_USE_SSL;
   ccinfo.protocol = protocols[0].name;
   ccinfo.local_protocol_name = protocols[0].name;
   ccinfo.retry_and_idle_policy = &retry;
@@ -264,18 +635,16 @@ static int force_create_ccinfo(const std::string &path) {
   ccinfo.pwsi = &endpoints_prop.at(path).wsi;
 
   if (!lws_client_connect_via_info(&ccinfo)) {
-    lwsl_err("%s: Failed :%s\n",
-             __func__, endpoints_prop.at(path).ws_path.c_str());
+    BINANCE_LOG_ERROR(binanceLogWs, "<binance::Websocket::force_create_ccinfo> Failed :%s",
+        endpoints_prop.at(path).ws_path.c_str());
+    /* retried by the caller, the other endpoints are not affected */
     atomic_store(&endpoints_prop.at(path).creating_conn, false);
-    atomic_store(&endpoints_prop.at(path).close_conn, true);
-    /*try cancel the service*/
-    atomic_store(&lws_service_cancelled, 1);
     return 1;
   }
   atomic_store(&endpoints_prop.at(path).creating_conn, false);
   atomic_store(&endpoints_prop.at(path).close_conn, false);
-  lwsl_user("%s: success, original_path#:%s retry_count[%d] ws_path::%s\n",
-            __func__, path.c_str(), endpoints_prop.at(path).retry_count, endpoints_prop.at(path).ws_path.c_str());
+  BINANCE_LOG_INFO(binanceLogWs, "<binance::Websocket::force_create_ccinfo> success, original_path#:%s retry_count[%d] ws_path::%s",
+      path.c_str(), endpoints_prop.at(path).retry_count, endpoints_prop.at(path).ws_path.c_str());
   return 0;
 }
 
@@ -283,8 +652,8 @@ static int force_create_ccinfo(const std::string &path) {
 static void force_delete_ccinfo(const std::string &path) {
 
   if ( endpoints_prop.find(path) != endpoints_prop.end() ) {
-    lwsl_info("%s: found connect_endpoints ws_path::%s\n",
-              __func__, endpoints_prop.at(path).ws_path.c_str());
+    BINANCE_LOG_DEBUG(binanceLogWs, "<binance::Websocket::force_delete_ccinfo> found connect_endpoints ws_path::%s",
+        endpoints_prop.at(path).ws_path.c_str());
     while (endpoints_prop.at(path).creating_conn.load()){
       if(!endpoints_prop.at(path).creating_conn.load())
         break;
@@ -298,10 +667,15 @@ static void force_delete_ccinfo(const std::string &path) {
       pthread_mutex_unlock(&lock_concurrent);
       /*use Async Kill*/
       lws_set_timeout(endpoints_prop.at(path).wsi, PENDING_TIMEOUT_CLOSE_SEND, LWS_TO_KILL_ASYNC);
+    } else if(!lws_service_cancelled && !endpoints_prop.at(path).wsi) {
+      /* waiting to reconnect: removed by the timer instead */
+      pthread_mutex_lock(&lock_concurrent);
+      atomic_store(&endpoints_prop.at(path).close_conn, true);
+      pthread_mutex_unlock(&lock_concurrent);
     }
   } else {
-    lwsl_err("%s: not found connect_endpoints error path::%s\n",
-             __func__, path.c_str());
+    BINANCE_LOG_ERROR(binanceLogWs, "<binance::Websocket::force_delete_ccinfo> not found connect_endpoints error path::%s",
+        path.c_str());
   }
   return;
 }
@@ -312,6 +686,64 @@ void binance::Websocket::kill_all() {
   pthread_mutex_unlock(&lock_concurrent);
 }
 
+void binance::Websocket::set_host(const std::string &host, int port, bool ssl) {
+  ws_host = host;
+  ws_port = port;
+  ws_ssl = ssl;
+
+  std::lock_guard<std::mutex> guard(ws_address_lock);
+  ws_address.clear();
+}
+
+void binance::Websocket::set_reconnect_backoff(unsigned int base_ms, unsigned int max_ms, unsigned int max_retries) {
+  reconnect_base_ms = std::max(base_ms, 1u);
+  reconnect_max_ms = std::max(max_ms, reconnect_base_ms.load());
+  reconnect_max_retries = max_retries;
+}
+
+void binance::Websocket::set_resync_callback(RESYNC_CB cb) {
+  resync_cb = cb;
+}
+
+bool binance::Websocket::warm_up() {
+  struct addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+
+  struct addrinfo *result = nullptr;
+  const std::string port = std::to_string(ws_port);
+  int err = getaddrinfo(ws_host.c_str(), port.c_str(), &hints, &result);
+  if (err || !result) {
+    BINANCE_LOG_ERROR(binanceLogWs, "<binance::Websocket::warm_up> cannot resolve %s: %s",
+        ws_host.c_str(), gai_strerror(err));
+    return false;
+  }
+
+  /* prefer IPv4, which every network routes */
+  struct addrinfo *chosen = result;
+  for (struct addrinfo *ai = result; ai; ai = ai->ai_next) {
+    if (ai->ai_family == AF_INET) {
+      chosen = ai;
+      break;
+    }
+  }
+
+  char address[NI_MAXHOST] = "";
+  err = getnameinfo(chosen->ai_addr, chosen->ai_addrlen, address, sizeof(address), nullptr, 0, NI_NUMERICHOST);
+  freeaddrinfo(result);
+  if (err) {
+    BINANCE_LOG_ERROR(binanceLogWs, "<binance::Websocket::warm_up> cannot resolve %s: %s",
+        ws_host.c_str(), gai_strerror(err));
+    return false;
+  }
+
+  std::lock_guard<std::mutex> guard(ws_address_lock);
+  ws_address = address;
+  BINANCE_LOG_INFO(binanceLogWs, "<binance::Websocket::warm_up> %s is at %s",
+      ws_host.c_str(), address);
+  return true;
+}
+
 void binance::Websocket::init() {
   pthread_mutex_init(&lock_concurrent, nullptr);
   endpoints_prop.clear();
@@ -329,9 +761,17 @@ void binance::Websocket::init() {
   info.fd_limit_per_thread = 1024;
   info.max_http_header_pool = 1024;
 
+  /* verify the servers against the CA bundle shared with the REST handles,
+     mbedtls wants the terminating NUL of a PEM bundle in its length */
+  const std::string &ca_bundle = Server::getCaBundle();
+  if (!ca_bundle.empty()) {
+    info.client_ssl_ca_mem = ca_bundle.c_str();
+    info.client_ssl_ca_mem_len = (unsigned int)(ca_bundle.size() + 1);
+  }
+
   context = lws_create_context(&info);
   if (!context) {
-    lwsl_err("lws init failed\n");
+    BINANCE_LOG_ERROR(binanceLogWs, "<binance::Websocket::init> lws init failed");
     atomic_store(&lws_service_cancelled, 1);
     pthread_mutex_destroy(&lock_concurrent);
     return;
@@ -342,7 +782,7 @@ void binance::Websocket::init() {
       if(protocol_init.load())
         break;
       if(lws_service_cancelled) {
-        lwsl_err("lws init failed\n");
+        BINANCE_LOG_ERROR(binanceLogWs, "<binance::Websocket::init> lws init failed");
         return;
       }
     }
@@ -351,20 +791,23 @@ void binance::Websocket::init() {
 
 // Register call backs
 void binance::Websocket::connect_endpoint(CB cb,const std::string &path) {
+  connect_endpoint_impl(cb, path, nullptr);
+}
+
+static void connect_endpoint_impl(CB cb, const std::string &path, user_data_stream *user_stream) {
 
   while (!protocol_init.load()){
     if(protocol_init.load() && context)
       break;
     sleep(1);
     if(!context || lws_service_cancelled) {
-      lwsl_err("lws init/connect_endpoint failed\n");
+      BINANCE_LOG_ERROR(binanceLogWs, "<binance::Websocket::connect_endpoint_impl> lws init/connect_endpoint failed");
       return;
     }
   }
 
   if (endpoints_prop.size() > 1024) {
-    lwsl_err("%s: maximum of 1024 connect_endpoints reached,\n",
-             __func__);
+    BINANCE_LOG_ERROR(binanceLogWs, "<binance::Websocket::connect_endpoint_impl> maximum of 1024 connect_endpoints reached");
     return;
   }
   if(!lws_service_cancelled && context && protocol_init.load()){
@@ -376,13 +819,23 @@ void binance::Websocket::connect_endpoint(CB cb,const std::string &path) {
     endpoints_prop[path].creating_conn = false;
     endpoints_prop[path].close_conn = true;
     endpoints_prop[path].ws_path = path;
+    endpoints_prop[path].user_stream = user_stream;
+    endpoints_prop[path].established = false;
+    endpoints_prop[path].last_update_id.clear();
+    set_stream_metrics(endpoints_prop[path], path);
     pthread_mutex_unlock(&lock_concurrent);
     int n = force_create_ccinfo(path);
-    lwsl_user("%s: connecting::%s connect result[%s],\n",
-              __func__, path.c_str(), n ? "NotOkay" : "Okay");
+    BINANCE_LOG_INFO(binanceLogWs, "<binance::Websocket::connect_endpoint_impl> connecting::%s connect result[%s]",
+        path.c_str(), n ? "NotOkay" : "Okay");
+    if (n) {
+      /* the timers belong to the service thread, have it retry */
+      pthread_mutex_lock(&lock_concurrent);
+      pending_reconnects.push_back(path);
+      pthread_mutex_unlock(&lock_concurrent);
+      lws_cancel_service(context);
+    }
   } else {
-    lwsl_err("%s: no service running,\n",
-             __func__);
+    BINANCE_LOG_ERROR(binanceLogWs, "<binance::Websocket::connect_endpoint_impl> no service running");
     return;
   }
 }
@@ -391,17 +844,156 @@ void binance::Websocket::connect_endpoint(CB cb,const std::string &path) {
 void binance::Websocket::disconnect_endpoint(const std::string &path) {
 
   if (endpoints_prop.empty()) {
-    lwsl_err("%s: error connect_endpoints is empty,\n",
-             __func__);
+    BINANCE_LOG_ERROR(binanceLogWs, "<binance::Websocket::disconnect_endpoint> error connect_endpoints is empty");
     return;
   }
   if(!lws_service_cancelled && context && protocol_init.load()) {
     force_delete_ccinfo(path);
   } else {
-    lwsl_err("%s: no service running,\n",
-             __func__);
+    BINANCE_LOG_ERROR(binanceLogWs, "<binance::Websocket::disconnect_endpoint> no service running");
+    return;
+  }
+}
+
+bool binance::Websocket::connect_user_data_stream(CB user_cb, Account &account, OrderTracker *tracker) {
+
+  /* the simulator reports its own events, there is nothing to connect to */
+  if (account.getServer().isSimulator()) {
+    Simulator::get(account.getServer()).setUserDataStream(user_cb, tracker);
+    return true;
+  }
+
+  Json::Value json_result;
+  if (account.startUserDataStream(json_result) != binanceSuccess ||
+      !json_result["listenKey"].isString()) {
+    BINANCE_LOG_ERROR(binanceLogWs, "<binance::Websocket::connect_user_data_stream> failed to start user data stream");
+    return false;
+  }
+
+  std::string path;
+  pthread_mutex_lock(&lock_concurrent);
+  user_data_stream &stream = user_streams[&account];
+  if (stream.active.load())
+    path = stream.ws_path;
+  stream.account = &account;
+  stream.tracker = tracker;
+  stream.json_cb = user_cb;
+  stream.active = true;
+  stream.busy = false;
+  stream.reconciling = false;
+  pthread_mutex_unlock(&lock_concurrent);
+
+  /* restarting the stream of the same account drops the previous connection */
+  if (!path.empty())
+    disconnect_endpoint(path);
+
+  {
+    std::lock_guard<std::mutex> guard(stream.lock);
+    stream.listen_key = json_result["listenKey"].asString();
+    stream.ws_path = std::string("/ws/") + stream.listen_key;
+    path = stream.ws_path;
+  }
+
+  connect_endpoint_impl(user_cb, path, &stream);
+  return true;
+}
+
+void binance::Websocket::disconnect_user_data_stream(Account &account) {
+
+  if (account.getServer().isSimulator()) {
+    Simulator::get(account.getServer()).setUserDataStream(nullptr, nullptr);
+    return;
+  }
+
+  pthread_mutex_lock(&lock_concurrent);
+  auto it = user_streams.find(&account);
+  if (it == user_streams.end() || !it->second.active.load()) {
+    pthread_mutex_unlock(&lock_concurrent);
+    BINANCE_LOG_ERROR(binanceLogWs, "<binance::Websocket::disconnect_user_data_stream> no user data stream for this account");
     return;
   }
+  /* the keepalive timer expires without being re-armed */
+  atomic_store(&it->second.active, false);
+  pthread_mutex_unlock(&lock_concurrent);
+
+  std::string listen_key;
+  std::string path;
+  {
+    std::lock_guard<std::mutex> guard(it->second.lock);
+    listen_key = it->second.listen_key;
+    path = it->second.ws_path;
+  }
+
+  disconnect_endpoint(path);
+  account.closeUserDataStream(listen_key.c_str());
+}
+
+void binance::Websocket::connect_replay_endpoint(CB user_cb, const std::string &path) {
+  endpoint_connection &conn = replay_endpoints[path];
+  conn.wsi = nullptr;
+  conn.retry_count = 0;
+  conn.json_cb = user_cb;
+  conn.ws_path = path;
+  conn.close_conn = false;
+  conn.creating_conn = false;
+  conn.user_stream = nullptr;
+  conn.established = false;
+  conn.last_update_id.clear();
+  set_stream_metrics(conn, path);
+}
+
+void binance::Websocket::disconnect_replay_endpoint(const std::string &path) {
+  replay_endpoints.erase(path);
+}
+
+bool binance::Websocket::replay(const std::string &filename, double speed) {
+
+  RecordReader reader;
+  if (!reader.open(filename)) {
+    BINANCE_LOG_ERROR(binanceLogWs, "<binance::Websocket::replay> cannot open %s",
+        filename.c_str());
+    return false;
+  }
+
+  /* recorded stream id -> endpoint, nullptr for the streams not replayed */
+  std::vector<endpoint_connection *> streams;
+  std::unique_ptr<Json::CharReader> json_reader(new_frame_reader());
+
+  const auto start = std::chrono::steady_clock::now();
+  int64_t first_ns = -1;
+  unsigned long long frames = 0;
+  RecordReader::Record record;
+  while (reader.next(record)) {
+    if (record.type == Recorder::StreamName) {
+      if (streams.size() <= record.stream)
+        streams.resize(record.stream + 1, nullptr);
+      auto it = replay_endpoints.find(std::string(record.payload.begin(), record.payload.end()));
+      streams[record.stream] = (it != replay_endpoints.end()) ? &it->second : nullptr;
+      continue;
+    }
+
+    if (record.type != Recorder::Frame || record.stream >= streams.size() || !streams[record.stream])
+      continue;
+
+    if (speed > 0) {
+      if (first_ns < 0)
+        first_ns = record.timeNs;
+      const auto due = start + std::chrono::nanoseconds((int64_t)((record.timeNs - first_ns) / speed));
+      if (due > std::chrono::steady_clock::now())
+        std::this_thread::sleep_until(due);
+    }
+
+    if (record.payload.empty())
+      continue;
+    dispatch_frame(*streams[record.stream], *json_reader, &record.payload[0], record.payload.size(),
+                   Latency::now());
+    frames++;
+  }
+
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  BINANCE_LOG_INFO(binanceLogWs, "<binance::Websocket::replay> %llu frames replayed in %.3f s (%.0f frames/s)",
+      frames, seconds, seconds > 0 ? frames / seconds : 0.0);
+  return true;
 }
 
 // Entering event loop
@@ -409,13 +1001,12 @@ void binance::Websocket::enter_event_loop(const std::chrono::hours &hours) {
   auto start = std::chrono::steady_clock::now();
   auto end = start + hours;
   auto n = 0;
-  lwsl_user("%s: INIT\n", __func__);
+  BINANCE_LOG_INFO(binanceLogWs, "<binance::Websocket::enter_event_loop> INIT");
   do {
     try {
       n = lws_service(context, 500);
     } catch (exception &e) {
-      lwsl_err("%s:::%s\n",
-               __func__, e.what());
+      BINANCE_LOG_ERROR(binanceLogWs, "<binance::Websocket::enter_event_loop> %s", e.what());
       break;
     }
   } while (n >= 0 && !lws_service_cancelled && std::chrono::steady_clock::now() < end);
@@ -426,6 +1017,10 @@ void binance::Websocket::enter_event_loop(const std::chrono::hours &hours) {
   atomic_store(&protocol_init, 0);
   pthread_mutex_unlock(&lock_concurrent);
 
+  /* timers die with the context, workers check active */
+  for (auto &stream : user_streams)
+    atomic_store(&stream.second.active, false);
+
   lws_context_destroy(context);
   context= nullptr;
   /* extra check if not null */